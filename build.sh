@@ -5,7 +5,7 @@ set -e
 set -o pipefail
 
 CC="clang -std=c99 -Wall -Wextra"
-CXX="clang++ -std=c++11 -Wall -Wextra"
+CXX="clang++ -std=c++11 -Wall -Wextra -pthread"
 FLAGS="-DNDEBUG"
 #FLAGS=""
 LLC="llc"
@@ -21,18 +21,68 @@ rm -rf *.ll
 # Could be made header only. Presently, msgpack.h defines a C++ interface and
 # msgpack.cpp implements said interface
 $CXX $FLAGS -O2 msgpack.cpp -emit-llvm -c -o msgpack.bc
+$CXX $FLAGS -O2 msgpack_encode.cpp -c -o msgpack_encode.o
+$CXX $FLAGS -O2 msgpack_utf8.cpp -c -o msgpack_utf8.o
+$CXX $FLAGS -O2 msgpack_file.cpp -c -o msgpack_file.o
+$CXX $FLAGS -O2 msgpack_records.cpp -c -o msgpack_records.o
+$CXX $FLAGS -O2 msgpack_parallel.cpp -c -o msgpack_parallel.o
+$CXX $FLAGS -O2 msgpack_lookup.cpp -c -o msgpack_lookup.o
+$CXX $FLAGS -O2 msgpack_decode.cpp -c -o msgpack_decode.o
+$CXX $FLAGS -O2 msgpack_schema.cpp -c -o msgpack_schema.o
+$CXX $FLAGS -O2 msgpack_hash.cpp -c -o msgpack_hash.o
+$CXX $FLAGS -O2 msgpack_path.cpp -c -o msgpack_path.o
+$CXX $FLAGS -O2 msgpack_compare.cpp -c -o msgpack_compare.o
+$CXX $FLAGS -O2 msgpack_canonical.cpp -c -o msgpack_canonical.o
+$CXX $FLAGS -O2 msgpack_patch.cpp -c -o msgpack_patch.o
+$CXX $FLAGS -O2 msgpack_writer.cpp -c -o msgpack_writer.o
+$CXX $FLAGS -O2 msgpack_iovec.cpp -c -o msgpack_iovec.o
+$CXX $FLAGS -O2 msgpack_extract.cpp -c -o msgpack_extract.o
+$CXX $FLAGS -O2 msgpack_map_index.cpp -c -o msgpack_map_index.o
+$CXX $FLAGS -O2 msgpack_columns.cpp -c -o msgpack_columns.o
+$CXX $FLAGS -O2 msgpack_filter.cpp -c -o msgpack_filter.o
+$CXX $FLAGS -O2 msgpack_ring.cpp -c -o msgpack_ring.o
+
+# Regenerates manykernels_decoder.h from the sample. Written aside first so a
+# failed run leaves the committed header alone.
+$CXX $FLAGS -O2 msgpack_schemagen.cpp msgpack_schema.o msgpack_decode.o msgpack_file.o msgpack.bc -o msgpack_schemagen
+./msgpack_schemagen manykernels kernel_metadata 20 manykernels.msgpack > manykernels_decoder.h.tmp
+mv manykernels_decoder.h.tmp manykernels_decoder.h
 
 # Tests
 $CXX $FLAGS -O2 msgpack_test.cpp -c -o msgpack_test.o
 $CXX $FLAGS -O2 msgpack_fuzz.cpp -c -o msgpack_fuzz.o
 $CXX $FLAGS -O2 msgpack_scalar.cpp -c -o msgpack_scalar.o
+$CXX $FLAGS -O2 msgpack_encode_test.cpp -c -o msgpack_encode_test.o
+$CXX $FLAGS -O2 msgpack_utf8_test.cpp -c -o msgpack_utf8_test.o
+$CXX $FLAGS -O2 msgpack_file_test.cpp -c -o msgpack_file_test.o
+$CXX $FLAGS -O2 msgpack_records_test.cpp -c -o msgpack_records_test.o
+$CXX $FLAGS -O2 msgpack_parallel_test.cpp -c -o msgpack_parallel_test.o
+$CXX $FLAGS -O2 msgpack_lookup_test.cpp -c -o msgpack_lookup_test.o
+$CXX $FLAGS -O2 msgpack_schema_test.cpp -c -o msgpack_schema_test.o
+$CXX $FLAGS -O2 msgpack_fields_test.cpp -c -o msgpack_fields_test.o
+$CXX $FLAGS -O2 msgpack_traits_test.cpp -c -o msgpack_traits_test.o
+$CXX -std=c++17 $FLAGS -O2 msgpack_traits17_test.cpp -c -o msgpack_traits17_test.o
+$CXX $FLAGS -O2 msgpack_hash_test.cpp -c -o msgpack_hash_test.o
+$CXX $FLAGS -O2 msgpack_compare_test.cpp -c -o msgpack_compare_test.o
+$CXX $FLAGS -O2 msgpack_canonical_test.cpp -c -o msgpack_canonical_test.o
+$CXX $FLAGS -O2 msgpack_patch_test.cpp -c -o msgpack_patch_test.o
+$CXX $FLAGS -O2 msgpack_writer_test.cpp -c -o msgpack_writer_test.o
+$CXX $FLAGS -O2 msgpack_iovec_test.cpp -c -o msgpack_iovec_test.o
+$CXX $FLAGS -O2 msgpack_extract_test.cpp -c -o msgpack_extract_test.o
+$CXX $FLAGS -O2 msgpack_map_index_test.cpp -c -o msgpack_map_index_test.o
+$CXX $FLAGS -O2 msgpack_columns_test.cpp -c -o msgpack_columns_test.o
+$CXX $FLAGS -O2 msgpack_filter_test.cpp -c -o msgpack_filter_test.o
+$CXX $FLAGS -O2 msgpack_ring_test.cpp -c -o msgpack_ring_test.o
+$CXX $FLAGS -O2 msgpack_bench.cpp -c -o msgpack_bench.o
 $CXX $FLAGS -O2 msgpack_codegen.cpp -emit-llvm -c -o msgpack_codegen.bc
 
 # Data
 $CC $FLAGS helloworld_msgpack.c -c -o helloworld_msgpack.o
 $CC $FLAGS manykernels_msgpack.c -c -o manykernels_msgpack.o
+xxd -i manykernels_decoder.h > manykernels_decoder_h.c
+$CC $FLAGS manykernels_decoder_h.c -c -o manykernels_decoder_h.o
 
-$CXX msgpack.bc msgpack_test.o msgpack_fuzz.o msgpack_scalar.o catch.o helloworld_msgpack.o manykernels_msgpack.o msgpack_codegen.bc -o msgpack.exe
+$CXX msgpack.bc msgpack_encode.o msgpack_utf8.o msgpack_file.o msgpack_records.o msgpack_parallel.o msgpack_lookup.o msgpack_decode.o msgpack_schema.o msgpack_hash.o msgpack_path.o msgpack_compare.o msgpack_canonical.o msgpack_patch.o msgpack_writer.o msgpack_iovec.o msgpack_extract.o msgpack_map_index.o msgpack_columns.o msgpack_filter.o msgpack_ring.o msgpack_test.o msgpack_fuzz.o msgpack_scalar.o msgpack_encode_test.o msgpack_utf8_test.o msgpack_file_test.o msgpack_records_test.o msgpack_parallel_test.o msgpack_lookup_test.o msgpack_schema_test.o msgpack_fields_test.o msgpack_traits_test.o msgpack_traits17_test.o msgpack_hash_test.o msgpack_compare_test.o msgpack_canonical_test.o msgpack_patch_test.o msgpack_writer_test.o msgpack_iovec_test.o msgpack_extract_test.o msgpack_map_index_test.o msgpack_columns_test.o msgpack_filter_test.o msgpack_ring_test.o msgpack_bench.o catch.o helloworld_msgpack.o manykernels_msgpack.o manykernels_decoder_h.o msgpack_codegen.bc -o msgpack.exe
 
 
 $CXX -DNDEBUG -O3 msgpack.cpp -emit-llvm -S -c -o msgpack.ll
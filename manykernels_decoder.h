@@ -0,0 +1,247 @@
+// Generated by msgpack_schemagen. Do not edit.
+#ifndef MANYKERNELS_DECODER_H
+#define MANYKERNELS_DECODER_H
+
+#include "msgpack.h"
+#include "msgpack_decode.h"
+#include "msgpack_lookup.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace manykernels {
+using msgpack::decode;
+
+struct kernel_metadata_amdhsa_kernels_args {
+  std::string address_space{};
+  std::string name{};
+  uint64_t offset{};
+  uint64_t size{};
+  std::string value_kind{};
+  std::string value_type{};
+};
+
+struct kernel_metadata_amdhsa_kernels {
+  std::vector<kernel_metadata_amdhsa_kernels_args> args{};
+  uint64_t group_segment_fixed_size{};
+  uint64_t kernarg_segment_align{};
+  uint64_t kernarg_segment_size{};
+  std::string language{};
+  std::vector<uint64_t> language_version{};
+  uint64_t max_flat_workgroup_size{};
+  std::string name{};
+  uint64_t private_segment_fixed_size{};
+  uint64_t sgpr_count{};
+  uint64_t sgpr_spill_count{};
+  std::string symbol{};
+  uint64_t vgpr_count{};
+  uint64_t vgpr_spill_count{};
+  uint64_t wavefront_size{};
+};
+
+struct kernel_metadata {
+  std::vector<kernel_metadata_amdhsa_kernels> amdhsa_kernels{};
+  std::vector<uint64_t> amdhsa_version{};
+};
+
+inline const unsigned char *decode(msgpack::byte_range bytes, kernel_metadata_amdhsa_kernels_args &out);
+inline const unsigned char *decode_generic(msgpack::byte_range bytes, kernel_metadata_amdhsa_kernels_args &out);
+inline const unsigned char *decode(msgpack::byte_range bytes, kernel_metadata_amdhsa_kernels &out);
+inline const unsigned char *decode_generic(msgpack::byte_range bytes, kernel_metadata_amdhsa_kernels &out);
+inline const unsigned char *decode(msgpack::byte_range bytes, kernel_metadata &out);
+inline const unsigned char *decode_generic(msgpack::byte_range bytes, kernel_metadata &out);
+
+inline const unsigned char *decode(msgpack::byte_range bytes, kernel_metadata_amdhsa_kernels_args &out) {
+  static const unsigned char header[] = {0x86};
+  static const unsigned char key_0[] = {0xae, 0x2e, 0x61, 0x64, 0x64, 0x72, 0x65, 0x73, 0x73, 0x5f, 0x73, 0x70, 0x61, 0x63, 0x65};
+  static const unsigned char key_1[] = {0xa5, 0x2e, 0x6e, 0x61, 0x6d, 0x65};
+  static const unsigned char key_2[] = {0xa7, 0x2e, 0x6f, 0x66, 0x66, 0x73, 0x65, 0x74};
+  static const unsigned char key_3[] = {0xa5, 0x2e, 0x73, 0x69, 0x7a, 0x65};
+  static const unsigned char key_4[] = {0xab, 0x2e, 0x76, 0x61, 0x6c, 0x75, 0x65, 0x5f, 0x6b, 0x69, 0x6e, 0x64};
+  static const unsigned char key_5[] = {0xab, 0x2e, 0x76, 0x61, 0x6c, 0x75, 0x65, 0x5f, 0x74, 0x79, 0x70, 0x65};
+  const unsigned char *end = bytes.end;
+  const unsigned char *p = msgpack::detail::expect_bytes(
+      bytes.start, end, header, sizeof(header));
+  p = p ? msgpack::detail::expect_bytes(p, end, key_0, sizeof(key_0)) : nullptr;
+  p = p ? decode(msgpack::byte_range{p, end}, out.address_space) : nullptr;
+  p = p ? msgpack::detail::expect_bytes(p, end, key_1, sizeof(key_1)) : nullptr;
+  p = p ? decode(msgpack::byte_range{p, end}, out.name) : nullptr;
+  p = p ? msgpack::detail::expect_bytes(p, end, key_2, sizeof(key_2)) : nullptr;
+  p = p ? decode(msgpack::byte_range{p, end}, out.offset) : nullptr;
+  p = p ? msgpack::detail::expect_bytes(p, end, key_3, sizeof(key_3)) : nullptr;
+  p = p ? decode(msgpack::byte_range{p, end}, out.size) : nullptr;
+  p = p ? msgpack::detail::expect_bytes(p, end, key_4, sizeof(key_4)) : nullptr;
+  p = p ? decode(msgpack::byte_range{p, end}, out.value_kind) : nullptr;
+  p = p ? msgpack::detail::expect_bytes(p, end, key_5, sizeof(key_5)) : nullptr;
+  p = p ? decode(msgpack::byte_range{p, end}, out.value_type) : nullptr;
+  if (p) {
+    return p;
+  }
+  out = kernel_metadata_amdhsa_kernels_args();
+  return decode_generic(bytes, out);
+}
+
+inline const unsigned char *decode_generic(msgpack::byte_range bytes, kernel_metadata_amdhsa_kernels_args &out) {
+  static const msgpack::key_set keys({".address_space", ".name", ".offset", ".size", ".value_kind", ".value_type"});
+  return msgpack::decode_map(
+      bytes,
+      [&](msgpack::byte_range key, msgpack::byte_range value) -> const unsigned char * {
+        switch (keys.classify(key)) {
+        case 0:
+          return decode(value, out.address_space);
+        case 1:
+          return decode(value, out.name);
+        case 2:
+          return decode(value, out.offset);
+        case 3:
+          return decode(value, out.size);
+        case 4:
+          return decode(value, out.value_kind);
+        case 5:
+          return decode(value, out.value_type);
+        default:
+          return msgpack::fallback::skip_next_message(
+              value.start, value.end);
+        }
+      });
+}
+
+inline const unsigned char *decode(msgpack::byte_range bytes, kernel_metadata_amdhsa_kernels &out) {
+  static const unsigned char header[] = {0x8f};
+  static const unsigned char key_0[] = {0xa5, 0x2e, 0x61, 0x72, 0x67, 0x73};
+  static const unsigned char key_1[] = {0xb9, 0x2e, 0x67, 0x72, 0x6f, 0x75, 0x70, 0x5f, 0x73, 0x65, 0x67, 0x6d, 0x65, 0x6e, 0x74, 0x5f, 0x66, 0x69, 0x78, 0x65, 0x64, 0x5f, 0x73, 0x69, 0x7a, 0x65};
+  static const unsigned char key_2[] = {0xb6, 0x2e, 0x6b, 0x65, 0x72, 0x6e, 0x61, 0x72, 0x67, 0x5f, 0x73, 0x65, 0x67, 0x6d, 0x65, 0x6e, 0x74, 0x5f, 0x61, 0x6c, 0x69, 0x67, 0x6e};
+  static const unsigned char key_3[] = {0xb5, 0x2e, 0x6b, 0x65, 0x72, 0x6e, 0x61, 0x72, 0x67, 0x5f, 0x73, 0x65, 0x67, 0x6d, 0x65, 0x6e, 0x74, 0x5f, 0x73, 0x69, 0x7a, 0x65};
+  static const unsigned char key_4[] = {0xa9, 0x2e, 0x6c, 0x61, 0x6e, 0x67, 0x75, 0x61, 0x67, 0x65};
+  static const unsigned char key_5[] = {0xb1, 0x2e, 0x6c, 0x61, 0x6e, 0x67, 0x75, 0x61, 0x67, 0x65, 0x5f, 0x76, 0x65, 0x72, 0x73, 0x69, 0x6f, 0x6e};
+  static const unsigned char key_6[] = {0xb8, 0x2e, 0x6d, 0x61, 0x78, 0x5f, 0x66, 0x6c, 0x61, 0x74, 0x5f, 0x77, 0x6f, 0x72, 0x6b, 0x67, 0x72, 0x6f, 0x75, 0x70, 0x5f, 0x73, 0x69, 0x7a, 0x65};
+  static const unsigned char key_7[] = {0xa5, 0x2e, 0x6e, 0x61, 0x6d, 0x65};
+  static const unsigned char key_8[] = {0xbb, 0x2e, 0x70, 0x72, 0x69, 0x76, 0x61, 0x74, 0x65, 0x5f, 0x73, 0x65, 0x67, 0x6d, 0x65, 0x6e, 0x74, 0x5f, 0x66, 0x69, 0x78, 0x65, 0x64, 0x5f, 0x73, 0x69, 0x7a, 0x65};
+  static const unsigned char key_9[] = {0xab, 0x2e, 0x73, 0x67, 0x70, 0x72, 0x5f, 0x63, 0x6f, 0x75, 0x6e, 0x74};
+  static const unsigned char key_10[] = {0xb1, 0x2e, 0x73, 0x67, 0x70, 0x72, 0x5f, 0x73, 0x70, 0x69, 0x6c, 0x6c, 0x5f, 0x63, 0x6f, 0x75, 0x6e, 0x74};
+  static const unsigned char key_11[] = {0xa7, 0x2e, 0x73, 0x79, 0x6d, 0x62, 0x6f, 0x6c};
+  static const unsigned char key_12[] = {0xab, 0x2e, 0x76, 0x67, 0x70, 0x72, 0x5f, 0x63, 0x6f, 0x75, 0x6e, 0x74};
+  static const unsigned char key_13[] = {0xb1, 0x2e, 0x76, 0x67, 0x70, 0x72, 0x5f, 0x73, 0x70, 0x69, 0x6c, 0x6c, 0x5f, 0x63, 0x6f, 0x75, 0x6e, 0x74};
+  static const unsigned char key_14[] = {0xaf, 0x2e, 0x77, 0x61, 0x76, 0x65, 0x66, 0x72, 0x6f, 0x6e, 0x74, 0x5f, 0x73, 0x69, 0x7a, 0x65};
+  const unsigned char *end = bytes.end;
+  const unsigned char *p = msgpack::detail::expect_bytes(
+      bytes.start, end, header, sizeof(header));
+  p = p ? msgpack::detail::expect_bytes(p, end, key_0, sizeof(key_0)) : nullptr;
+  p = p ? decode(msgpack::byte_range{p, end}, out.args) : nullptr;
+  p = p ? msgpack::detail::expect_bytes(p, end, key_1, sizeof(key_1)) : nullptr;
+  p = p ? decode(msgpack::byte_range{p, end}, out.group_segment_fixed_size) : nullptr;
+  p = p ? msgpack::detail::expect_bytes(p, end, key_2, sizeof(key_2)) : nullptr;
+  p = p ? decode(msgpack::byte_range{p, end}, out.kernarg_segment_align) : nullptr;
+  p = p ? msgpack::detail::expect_bytes(p, end, key_3, sizeof(key_3)) : nullptr;
+  p = p ? decode(msgpack::byte_range{p, end}, out.kernarg_segment_size) : nullptr;
+  p = p ? msgpack::detail::expect_bytes(p, end, key_4, sizeof(key_4)) : nullptr;
+  p = p ? decode(msgpack::byte_range{p, end}, out.language) : nullptr;
+  p = p ? msgpack::detail::expect_bytes(p, end, key_5, sizeof(key_5)) : nullptr;
+  p = p ? decode(msgpack::byte_range{p, end}, out.language_version) : nullptr;
+  p = p ? msgpack::detail::expect_bytes(p, end, key_6, sizeof(key_6)) : nullptr;
+  p = p ? decode(msgpack::byte_range{p, end}, out.max_flat_workgroup_size) : nullptr;
+  p = p ? msgpack::detail::expect_bytes(p, end, key_7, sizeof(key_7)) : nullptr;
+  p = p ? decode(msgpack::byte_range{p, end}, out.name) : nullptr;
+  p = p ? msgpack::detail::expect_bytes(p, end, key_8, sizeof(key_8)) : nullptr;
+  p = p ? decode(msgpack::byte_range{p, end}, out.private_segment_fixed_size) : nullptr;
+  p = p ? msgpack::detail::expect_bytes(p, end, key_9, sizeof(key_9)) : nullptr;
+  p = p ? decode(msgpack::byte_range{p, end}, out.sgpr_count) : nullptr;
+  p = p ? msgpack::detail::expect_bytes(p, end, key_10, sizeof(key_10)) : nullptr;
+  p = p ? decode(msgpack::byte_range{p, end}, out.sgpr_spill_count) : nullptr;
+  p = p ? msgpack::detail::expect_bytes(p, end, key_11, sizeof(key_11)) : nullptr;
+  p = p ? decode(msgpack::byte_range{p, end}, out.symbol) : nullptr;
+  p = p ? msgpack::detail::expect_bytes(p, end, key_12, sizeof(key_12)) : nullptr;
+  p = p ? decode(msgpack::byte_range{p, end}, out.vgpr_count) : nullptr;
+  p = p ? msgpack::detail::expect_bytes(p, end, key_13, sizeof(key_13)) : nullptr;
+  p = p ? decode(msgpack::byte_range{p, end}, out.vgpr_spill_count) : nullptr;
+  p = p ? msgpack::detail::expect_bytes(p, end, key_14, sizeof(key_14)) : nullptr;
+  p = p ? decode(msgpack::byte_range{p, end}, out.wavefront_size) : nullptr;
+  if (p) {
+    return p;
+  }
+  out = kernel_metadata_amdhsa_kernels();
+  return decode_generic(bytes, out);
+}
+
+inline const unsigned char *decode_generic(msgpack::byte_range bytes, kernel_metadata_amdhsa_kernels &out) {
+  static const msgpack::key_set keys({".args", ".group_segment_fixed_size", ".kernarg_segment_align", ".kernarg_segment_size", ".language", ".language_version", ".max_flat_workgroup_size", ".name", ".private_segment_fixed_size", ".sgpr_count", ".sgpr_spill_count", ".symbol", ".vgpr_count", ".vgpr_spill_count", ".wavefront_size"});
+  return msgpack::decode_map(
+      bytes,
+      [&](msgpack::byte_range key, msgpack::byte_range value) -> const unsigned char * {
+        switch (keys.classify(key)) {
+        case 0:
+          return decode(value, out.args);
+        case 1:
+          return decode(value, out.group_segment_fixed_size);
+        case 2:
+          return decode(value, out.kernarg_segment_align);
+        case 3:
+          return decode(value, out.kernarg_segment_size);
+        case 4:
+          return decode(value, out.language);
+        case 5:
+          return decode(value, out.language_version);
+        case 6:
+          return decode(value, out.max_flat_workgroup_size);
+        case 7:
+          return decode(value, out.name);
+        case 8:
+          return decode(value, out.private_segment_fixed_size);
+        case 9:
+          return decode(value, out.sgpr_count);
+        case 10:
+          return decode(value, out.sgpr_spill_count);
+        case 11:
+          return decode(value, out.symbol);
+        case 12:
+          return decode(value, out.vgpr_count);
+        case 13:
+          return decode(value, out.vgpr_spill_count);
+        case 14:
+          return decode(value, out.wavefront_size);
+        default:
+          return msgpack::fallback::skip_next_message(
+              value.start, value.end);
+        }
+      });
+}
+
+inline const unsigned char *decode(msgpack::byte_range bytes, kernel_metadata &out) {
+  static const unsigned char header[] = {0x82};
+  static const unsigned char key_0[] = {0xae, 0x61, 0x6d, 0x64, 0x68, 0x73, 0x61, 0x2e, 0x6b, 0x65, 0x72, 0x6e, 0x65, 0x6c, 0x73};
+  static const unsigned char key_1[] = {0xae, 0x61, 0x6d, 0x64, 0x68, 0x73, 0x61, 0x2e, 0x76, 0x65, 0x72, 0x73, 0x69, 0x6f, 0x6e};
+  const unsigned char *end = bytes.end;
+  const unsigned char *p = msgpack::detail::expect_bytes(
+      bytes.start, end, header, sizeof(header));
+  p = p ? msgpack::detail::expect_bytes(p, end, key_0, sizeof(key_0)) : nullptr;
+  p = p ? decode(msgpack::byte_range{p, end}, out.amdhsa_kernels) : nullptr;
+  p = p ? msgpack::detail::expect_bytes(p, end, key_1, sizeof(key_1)) : nullptr;
+  p = p ? decode(msgpack::byte_range{p, end}, out.amdhsa_version) : nullptr;
+  if (p) {
+    return p;
+  }
+  out = kernel_metadata();
+  return decode_generic(bytes, out);
+}
+
+inline const unsigned char *decode_generic(msgpack::byte_range bytes, kernel_metadata &out) {
+  static const msgpack::key_set keys({"amdhsa.kernels", "amdhsa.version"});
+  return msgpack::decode_map(
+      bytes,
+      [&](msgpack::byte_range key, msgpack::byte_range value) -> const unsigned char * {
+        switch (keys.classify(key)) {
+        case 0:
+          return decode(value, out.amdhsa_kernels);
+        case 1:
+          return decode(value, out.amdhsa_version);
+        default:
+          return msgpack::fallback::skip_next_message(
+              value.start, value.end);
+        }
+      });
+}
+
+} // namespace manykernels
+
+#endif
@@ -4,6 +4,10 @@
 #include <cstring>
 #include <cstdlib>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace msgpack {
 const char *type_name(type ty) {
   switch (ty) {
@@ -262,6 +266,70 @@ struct functors_message_skip : public functors_defaults<functors_message_skip> {
   }
 };
 
+namespace {
+// Types that are a complete message in one byte: posfixint, negfixint, nil,
+// false, true and the empty fixmap, fixarray and fixstr
+bool is_single_byte_message(unsigned char x) {
+  return (x <= 0x7f) || (x >= 0xe0) || (x == 0xc0) || (x == 0xc2) ||
+         (x == 0xc3) || (x == 0x80) || (x == 0x90) || (x == 0xa0);
+}
+
+// Bitmask with bit i set iff start[i] is a single byte message
+#if defined(__SSE2__)
+unsigned single_byte_mask16(const unsigned char *start) {
+  __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(start));
+
+  // posfixint and negfixint are the signed bytes in [-32, 127]
+  __m128i fixint = _mm_cmpgt_epi8(x, _mm_set1_epi8(-33));
+  __m128i nil = _mm_cmpeq_epi8(x, _mm_set1_epi8((char)0xc0));
+  __m128i f = _mm_cmpeq_epi8(x, _mm_set1_epi8((char)0xc2));
+  __m128i t = _mm_cmpeq_epi8(x, _mm_set1_epi8((char)0xc3));
+  __m128i map = _mm_cmpeq_epi8(x, _mm_set1_epi8((char)0x80));
+  __m128i array = _mm_cmpeq_epi8(x, _mm_set1_epi8((char)0x90));
+  __m128i str = _mm_cmpeq_epi8(x, _mm_set1_epi8((char)0xa0));
+
+  __m128i any = _mm_or_si128(_mm_or_si128(_mm_or_si128(fixint, nil),
+                                          _mm_or_si128(f, t)),
+                             _mm_or_si128(_mm_or_si128(map, array), str));
+  return (unsigned)_mm_movemask_epi8(any);
+}
+#else
+unsigned single_byte_mask16(const unsigned char *start) {
+  unsigned mask = 0;
+  for (unsigned i = 0; i < 16; i++) {
+    mask |= (unsigned)is_single_byte_message(start[i]) << i;
+  }
+  return mask;
+}
+#endif
+
+// Length of the run of single byte messages at start, at most limit
+uint64_t single_byte_run(const unsigned char *start, const unsigned char *end,
+                         uint64_t limit) {
+  const unsigned char *cursor = start;
+  while ((uint64_t)(end - cursor) >= 16) {
+    unsigned mask = single_byte_mask16(cursor);
+    if (mask != 0xffffu) {
+      cursor += __builtin_ctz(~mask);
+      break;
+    }
+    cursor += 16;
+    if ((uint64_t)(cursor - start) >= limit) {
+      break;
+    }
+  }
+
+  if ((uint64_t)(end - cursor) < 16) {
+    while (cursor != end && is_single_byte_message(*cursor)) {
+      cursor++;
+    }
+  }
+
+  uint64_t run = cursor - start;
+  return run < limit ? run : limit;
+}
+} // namespace
+
 const unsigned char *fallback::skip_number_contiguous_messages(
     uint64_t N, const unsigned char *start, const unsigned char *end) {
 
@@ -269,6 +337,16 @@ const unsigned char *fallback::skip_number_contiguous_messages(
   auto skip = functors_message_skip(number_remaining);
 
   while (number_remaining != 0) {
+    // Runs of one byte messages, e.g. small integers, are skipped in one step
+    if (start != end && is_single_byte_message(*start)) {
+      uint64_t run = single_byte_run(start, end, number_remaining);
+      start += run;
+      number_remaining -= run;
+      if (number_remaining == 0) {
+        break;
+      }
+    }
+
     const unsigned char *r = handle_msgpack({start, end}, skip);
     number_remaining--;
     if (!r) {
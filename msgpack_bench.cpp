@@ -0,0 +1,259 @@
+#include "catch.hpp"
+#include "msgpack.h"
+#include "msgpack_canonical.h"
+#include "msgpack_lookup.h"
+#include "msgpack_map_index.h"
+#include "msgpack_parallel.h"
+
+extern "C" {
+#include "manykernels_msgpack.h"
+}
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Timing runs, hidden from the default test run. Invoke with
+// ./msgpack.exe [benchmark]
+
+using namespace msgpack;
+
+namespace {
+template <typename F> double time_ms(unsigned reps, F f) {
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned r = 0; r < reps; r++) {
+    f();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count() / reps;
+}
+
+// array32 of N elements, mostly posfixint / negfixint with the occasional
+// wider integer every 'stride' elements
+std::vector<unsigned char> fixint_heavy(uint32_t N, uint32_t stride) {
+  std::vector<unsigned char> res = {0xdd, (unsigned char)(N >> 24),
+                                    (unsigned char)(N >> 16),
+                                    (unsigned char)(N >> 8), (unsigned char)N};
+  for (uint32_t i = 0; i < N; i++) {
+    if (stride != 0 && i % stride == 0) {
+      res.push_back(0xcd);
+      res.push_back(0x12);
+      res.push_back(0x34);
+    } else {
+      res.push_back((i % 3 == 0) ? 0xf0 : (unsigned char)(i % 128));
+    }
+  }
+  return res;
+}
+} // namespace
+
+TEST_CASE("skip fixint heavy array", "[.][benchmark]") {
+  const uint32_t N = 1u << 22;
+  for (uint32_t stride : {0u, 1000u, 64u, 8u}) {
+    std::vector<unsigned char> data = fixint_heavy(N, stride);
+    const unsigned char *start = data.data();
+    const unsigned char *end = data.data() + data.size();
+
+    // Baseline steps over the elements one skip_next_message at a time
+    const unsigned char *per_message = nullptr;
+    const unsigned char *run_skip = nullptr;
+    double dispatch = time_ms(10, [&]() {
+      const unsigned char *p = start + 5;
+      for (uint32_t i = 0; i < N && p; i++) {
+        p = fallback::skip_next_message(p, end);
+      }
+      per_message = p;
+    });
+    double runs = time_ms(10, [&]() {
+      run_skip = fallback::skip_number_contiguous_messages(1, start, end);
+    });
+
+    CHECK(per_message == end);
+    CHECK(run_skip == end);
+    printf("stride %4u: per message %8.3fms, run skipping %8.3fms\n", stride,
+           dispatch, runs);
+  }
+}
+
+namespace {
+// Reads every unsigned element of an array message
+struct functors_array_sum : functors_defaults<functors_array_sum> {
+  functors_array_sum(std::atomic<uint64_t> &sum) : sum(sum) {}
+  std::atomic<uint64_t> &sum;
+  const unsigned char *handle_array(uint64_t N, byte_range bytes) {
+    uint64_t local = 0;
+    for (uint64_t i = 0; i < N && bytes.start; i++) {
+      foronly_unsigned(bytes, [&](uint64_t x) { local += x; });
+      bytes.start = fallback::skip_next_message(bytes.start, bytes.end);
+    }
+    sum += local;
+    return bytes.start;
+  }
+};
+} // namespace
+
+TEST_CASE("visit concatenated messages", "[.][benchmark]") {
+  // One million small arrays back to back, as in a metadata log
+  std::vector<unsigned char> data;
+  for (uint32_t i = 0; i < 1000000; i++) {
+    data.push_back(0x98);
+    for (unsigned j = 0; j < 8; j++) {
+      data.push_back(0xcd);
+      data.push_back((unsigned char)(i >> 8));
+      data.push_back((unsigned char)j);
+    }
+  }
+  const unsigned char *start = data.data();
+  const unsigned char *end = data.data() + data.size();
+
+  std::atomic<uint64_t> serial_sum(0);
+  double serial = time_ms(3, [&]() {
+    for (const unsigned char *p = start; p && p != end;) {
+      p = handle_msgpack({p, end}, functors_array_sum(serial_sum));
+    }
+  });
+
+  std::atomic<uint64_t> parallel_sum(0);
+  double parallel = time_ms(3, [&]() {
+    CHECK(parallel_handle_msgpack({start, end},
+                                  functors_array_sum(parallel_sum)) == end);
+  });
+
+  CHECK(serial_sum == parallel_sum);
+  printf("1M messages: serial %8.3fms, parallel (%u threads) %8.3fms\n",
+         serial, detail::default_thread_count(), parallel);
+}
+
+TEST_CASE("index huge array", "[.][benchmark]") {
+  // array32 of ten million mixed width integers
+  std::vector<unsigned char> data = fixint_heavy(10000000, 5);
+  byte_range bytes = {data.data(), data.data() + data.size()};
+
+  std::vector<uint64_t> serial_offsets;
+  std::vector<uint64_t> parallel_offsets;
+  double serial = time_ms(3, [&]() {
+    CHECK(index_elements(bytes, serial_offsets));
+  });
+  double parallel = time_ms(3, [&]() {
+    CHECK(index_elements_parallel(bytes, parallel_offsets));
+  });
+  std::vector<uint32_t> compact_offsets;
+  double compact = time_ms(3, [&]() {
+    CHECK(index_elements_parallel(bytes, compact_offsets));
+  });
+  CHECK(serial_offsets == parallel_offsets);
+  CHECK(std::equal(compact_offsets.begin(), compact_offsets.end(),
+                   parallel_offsets.begin()));
+  printf("index 10M elements: serial %8.3fms, parallel (%u threads) %8.3fms, "
+         "parallel compact %8.3fms\n",
+         serial, detail::default_thread_count(), parallel, compact);
+}
+
+TEST_CASE("kernel field extraction", "[.][benchmark]") {
+  std::vector<byte_range> kernels;
+  foreach_map({manykernels_msgpack,
+               manykernels_msgpack + manykernels_msgpack_len},
+              [&](byte_range key, byte_range value) {
+                if (message_is_string(key, "amdhsa.kernels")) {
+                  foreach_array(value, [&](byte_range kernel) {
+                    kernels.push_back(kernel);
+                  });
+                }
+              });
+
+  const char *keys[] = {".name", ".kernarg_segment_size",
+                        ".group_segment_fixed_size", ".sgpr_count",
+                        ".vgpr_count"};
+  const unsigned reps = 2000;
+
+  uint64_t linear_found = 0;
+  double linear = time_ms(reps, [&]() {
+    for (byte_range kernel : kernels) {
+      foreach_map(kernel, [&](byte_range key, byte_range) {
+        for (const char *k : keys) {
+          linear_found += message_is_string(key, k);
+        }
+      });
+    }
+  });
+
+  map_shape_cache cache(
+      std::vector<std::string>(keys, keys + sizeof(keys) / sizeof(keys[0])));
+  uint64_t cached_found = 0;
+  double cached = time_ms(reps, [&]() {
+    byte_range values[5];
+    for (byte_range kernel : kernels) {
+      cache.lookup(kernel, values);
+      for (byte_range v : values) {
+        cached_found += v.start != nullptr;
+      }
+    }
+  });
+
+  CHECK(linear_found == cached_found);
+  printf("%zu kernels x %u: linear %8.4fms, shape cache %8.4fms\n",
+         kernels.size(), reps, linear, cached);
+}
+
+TEST_CASE("canonicalize minimal input", "[.][benchmark]") {
+  // Already canonical input is moved as one span, so should track memcpy
+  std::vector<unsigned char> data = fixint_heavy(1u << 22, 64);
+  std::vector<unsigned char> out(data.size());
+  const unsigned char *start = data.data();
+  const unsigned char *end = data.data() + data.size();
+  REQUIRE(canonicalize({start, end}, out));
+  data = out;
+  start = data.data();
+  end = data.data() + data.size();
+
+  unsigned char *written = nullptr;
+  double copy = time_ms(10, [&]() { memcpy(out.data(), start, data.size()); });
+  double canonical =
+      time_ms(10, [&]() { written = canonicalize({start, end}, out.data()); });
+
+  CHECK(written == out.data() + data.size());
+  printf("%zu bytes: memcpy %8.3fms, canonicalize %8.3fms\n", data.size(),
+         copy, canonical);
+}
+
+TEST_CASE("wide map lookup", "[.][benchmark]") {
+  const uint32_t N = 4000;
+  std::vector<unsigned char> map = {0xde, (unsigned char)(N >> 8),
+                                    (unsigned char)N};
+  std::vector<std::string> keys;
+  for (uint32_t i = 0; i < N; i++) {
+    keys.push_back("field_" + std::to_string(i));
+    map.push_back(0xa0 | (unsigned char)keys.back().size());
+    map.insert(map.end(), keys.back().begin(), keys.back().end());
+    map.push_back((unsigned char)(i % 128));
+  }
+  byte_range bytes = {map.data(), map.data() + map.size()};
+
+  uint64_t linear_found = 0;
+  double linear = time_ms(1, [&]() {
+    for (const std::string &k : keys) {
+      foreach_map(bytes, [&](byte_range key, byte_range) {
+        linear_found += message_is_string(key, k.c_str());
+      });
+    }
+  });
+
+  map_index<uint32_t> index;
+  double build = time_ms(10, [&]() { index.build(bytes); });
+  uint64_t indexed_found = 0;
+  double indexed = time_ms(1, [&]() {
+    for (const std::string &k : keys) {
+      indexed_found += index.find(k).start != nullptr;
+    }
+  });
+
+  CHECK(linear_found == N);
+  CHECK(indexed_found == N);
+  printf("%u keys, all looked up: linear %8.3fms, index build %8.3fms, "
+         "indexed %8.3fms\n",
+         N, linear, build, indexed);
+}
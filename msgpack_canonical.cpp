@@ -0,0 +1,254 @@
+#include "msgpack_canonical.h"
+#include "msgpack_decode.h"
+#include "msgpack_traits.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+using msgpack::byte_range;
+using msgpack::token;
+
+// Longest header is uint64 / int64, [tag][u64 value]. ext32, [tag][u32
+// length][type], is the longest with a payload after it.
+const size_t max_header = 9;
+static_assert(max_header >= 1 + sizeof(uint64_t) &&
+                  max_header >= 1 + sizeof(uint32_t) + 1,
+              "Room for the widest header write_* emits");
+
+// Writes the canonical header of t, returning its length, or 0 for tokens
+// with only one encoding
+size_t canonical_header(const token &t, unsigned char *out) {
+  using namespace msgpack::detail;
+  const uint64_t N = t.payload.end - t.payload.start;
+  unsigned char *end = out;
+
+  switch (t.kind) {
+  case token::nil:
+  case token::boolean:
+  case token::floating:
+    return 0;
+  case token::unsigned_integer:
+    end = write_unsigned(t.value, out);
+    break;
+  case token::negative_integer:
+    end = write_signed((int64_t)t.value, out);
+    break;
+  case token::array:
+    end = write_array_header(t.value, out);
+    break;
+  case token::map:
+    end = write_map_header(t.value, out);
+    break;
+  case token::string:
+    if (N <= 31) {
+      *end++ = 0xa0 | (unsigned char)N;
+    } else if (N <= UINT8_MAX) {
+      end = write_tagged(0xd9, (uint8_t)N, out);
+    } else if (N <= UINT16_MAX) {
+      end = write_tagged(0xda, (uint16_t)N, out);
+    } else {
+      end = write_tagged(0xdb, (uint32_t)N, out);
+    }
+    break;
+  case token::binary:
+    if (N <= UINT8_MAX) {
+      end = write_tagged(0xc4, (uint8_t)N, out);
+    } else if (N <= UINT16_MAX) {
+      end = write_tagged(0xc5, (uint16_t)N, out);
+    } else {
+      end = write_tagged(0xc6, (uint32_t)N, out);
+    }
+    break;
+  case token::extension:
+    switch (N) {
+    case 1:
+      *end++ = 0xd4;
+      break;
+    case 2:
+      *end++ = 0xd5;
+      break;
+    case 4:
+      *end++ = 0xd6;
+      break;
+    case 8:
+      *end++ = 0xd7;
+      break;
+    case 16:
+      *end++ = 0xd8;
+      break;
+    default:
+      end = (N <= UINT8_MAX)    ? write_tagged(0xc7, (uint8_t)N, out)
+            : (N <= UINT16_MAX) ? write_tagged(0xc8, (uint16_t)N, out)
+                                : write_tagged(0xc9, (uint32_t)N, out);
+      break;
+    }
+    *end++ = (unsigned char)t.value;
+    break;
+  }
+  return end - out;
+}
+
+bool has_payload(const token &t) {
+  return t.kind == token::string || t.kind == token::binary ||
+         t.kind == token::extension;
+}
+
+uint64_t children(const token &t) {
+  return (t.kind == token::array) ? t.value
+         : (t.kind == token::map) ? 2 * t.value
+                                  : 0;
+}
+
+// Linear pass. Only headers that change are written, everything between
+// them is moved as one span.
+unsigned char *canonicalize_in_order(byte_range bytes, unsigned char *out) {
+  const unsigned char *span = bytes.start;
+  const unsigned char *p = bytes.start;
+  uint64_t pending = 1;
+
+  while (pending != 0) {
+    // Single byte headers are already minimal and need no token
+    const unsigned char c = (p < bytes.end) ? *p : 0xc1;
+    if (c <= 0x7f || c >= 0xe0 || c == 0xc0 || c == 0xc2 || c == 0xc3) {
+      p++;
+      pending--;
+      continue;
+    }
+    if (c <= 0x9f) {
+      // fixmap or fixarray
+      pending += (c <= 0x8f) ? 2 * (c & 0x0f) : (c & 0x0f);
+      p++;
+      pending--;
+      continue;
+    }
+    if (c >= 0xa0 && c <= 0xbf) {
+      const uint64_t N = c & 0x1f;
+      if ((uint64_t)(bytes.end - p) <= N) {
+        return nullptr;
+      }
+      p += 1 + N;
+      pending--;
+      continue;
+    }
+
+    token t;
+    const unsigned char *next = read_token({p, bytes.end}, t);
+    if (!next) {
+      return nullptr;
+    }
+    pending += children(t) - 1;
+
+    const unsigned char *header_end = has_payload(t) ? t.payload.start : next;
+    unsigned char header[max_header];
+    const size_t n = canonical_header(t, header);
+    if (n != 0 && (n != (size_t)(header_end - p) ||
+                   memcmp(header, p, n) != 0)) {
+      memmove(out, span, p - span);
+      out += p - span;
+      memcpy(out, header, n);
+      out += n;
+      span = header_end;
+    }
+    p = next;
+  }
+
+  memmove(out, span, p - span);
+  return out + (p - span);
+}
+
+// Recursive pass for sorted keys, appending the canonical form of the message
+// at bytes.start to out
+const unsigned char *canonicalize_sorted(byte_range bytes,
+                                         std::vector<unsigned char> &out) {
+  token t;
+  const unsigned char *p = read_token(bytes, t);
+  if (!p) {
+    return nullptr;
+  }
+
+  unsigned char header[max_header];
+  size_t n = canonical_header(t, header);
+  if (n == 0) {
+    out.insert(out.end(), bytes.start, p);
+    return p;
+  }
+  out.insert(out.end(), header, header + n);
+  if (has_payload(t)) {
+    out.insert(out.end(), t.payload.start, t.payload.end);
+  }
+
+  if (t.kind == token::array) {
+    for (uint64_t i = 0; i < t.value && p; i++) {
+      p = canonicalize_sorted({p, bytes.end}, out);
+    }
+  }
+
+  if (t.kind == token::map) {
+    // Pairs are written to scratch, then appended in key order
+    struct pair_span {
+      size_t start;
+      size_t key_end;
+      size_t end;
+    };
+    std::vector<unsigned char> scratch;
+    std::vector<pair_span> pairs;
+    for (uint64_t i = 0; i < t.value; i++) {
+      pair_span s;
+      s.start = scratch.size();
+      p = canonicalize_sorted({p, bytes.end}, scratch);
+      s.key_end = scratch.size();
+      p = p ? canonicalize_sorted({p, bytes.end}, scratch) : nullptr;
+      s.end = scratch.size();
+      if (!p) {
+        return nullptr;
+      }
+      pairs.push_back(s);
+    }
+
+    const unsigned char *base = scratch.data();
+    std::stable_sort(pairs.begin(), pairs.end(),
+                     [base](const pair_span &x, const pair_span &y) {
+                       return std::lexicographical_compare(
+                           base + x.start, base + x.key_end, base + y.start,
+                           base + y.key_end);
+                     });
+    for (const pair_span &s : pairs) {
+      out.insert(out.end(), base + s.start, base + s.end);
+    }
+  }
+
+  return p;
+}
+} // namespace
+
+namespace msgpack {
+
+unsigned char *canonicalize(byte_range bytes, unsigned char *out,
+                            bool sort_keys) {
+  if (!sort_keys) {
+    return canonicalize_in_order(bytes, out);
+  }
+
+  std::vector<unsigned char> tmp;
+  if (!canonicalize_sorted(bytes, tmp)) {
+    return nullptr;
+  }
+  memcpy(out, tmp.data(), tmp.size());
+  return out + tmp.size();
+}
+
+bool canonicalize(byte_range bytes, std::vector<unsigned char> &out,
+                  bool sort_keys) {
+  out.clear();
+  if (sort_keys) {
+    return canonicalize_sorted(bytes, out) != nullptr;
+  }
+
+  out.resize(bytes.end - bytes.start);
+  unsigned char *end = canonicalize_in_order(bytes, out.data());
+  out.resize(end ? end - out.data() : 0);
+  return end != nullptr;
+}
+
+} // namespace msgpack
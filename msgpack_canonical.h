@@ -0,0 +1,32 @@
+#ifndef MSGPACK_CANONICAL_H
+#define MSGPACK_CANONICAL_H
+
+#include "msgpack.h"
+
+#include <vector>
+
+namespace msgpack {
+
+// Rewrites the message at bytes.start in canonical form: every integer,
+// string, binary, extension, array and map header takes its smallest
+// encoding, with non-negative integers always unsigned. Floats are left as
+// they are. With sort_keys, the pairs of every map are also ordered by the
+// bytes of their canonical keys, duplicates keeping their order.
+//
+// The canonical form is never longer than the input, so out needs room for
+// bytes.end - bytes.start bytes. Without sort_keys out may be bytes.start,
+// rewriting in place, and runs of input that are already canonical are
+// moved in bulk rather than token by token.
+//
+// Returns one past the last byte written, or nullptr if the message is
+// malformed.
+unsigned char *canonicalize(byte_range bytes, unsigned char *out,
+                            bool sort_keys = false);
+
+// As above, replacing the contents of out
+bool canonicalize(byte_range bytes, std::vector<unsigned char> &out,
+                  bool sort_keys = false);
+
+} // namespace msgpack
+
+#endif
@@ -0,0 +1,100 @@
+#include "catch.hpp"
+#include "msgpack.h"
+#include "msgpack_canonical.h"
+#include "msgpack_compare.h"
+#include "msgpack_test_util.h"
+
+#include <vector>
+
+using namespace msgpack;
+
+namespace {
+std::vector<unsigned char> canonical(const std::vector<unsigned char> &bytes,
+                                     bool sort_keys = false) {
+  std::vector<unsigned char> out;
+  REQUIRE(canonicalize(range(bytes), out, sort_keys));
+  return out;
+}
+} // namespace
+
+TEST_CASE("canonicalize shrinks headers") {
+  typedef std::vector<unsigned char> bytes;
+
+  // uint32 5, int8 5, int16 200, int64 -1, int64 2^32 (same width unsigned)
+  CHECK(canonical({0xce, 0, 0, 0, 5}) == bytes{0x05});
+  CHECK(canonical({0xd0, 0x05}) == bytes{0x05});
+  CHECK(canonical({0xd1, 0x00, 0xc8}) == bytes{0xcc, 0xc8});
+  CHECK(canonical({0xd3, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff}) ==
+        bytes{0xff});
+  CHECK(canonical({0xd3, 0, 0, 0, 1, 0, 0, 0, 0}) ==
+        bytes{0xcf, 0, 0, 0, 1, 0, 0, 0, 0});
+
+  // str16 "ab", bin32 of one byte, ext8 of four bytes
+  CHECK(canonical({0xda, 0, 2, 'a', 'b'}) == bytes{0xa2, 'a', 'b'});
+  CHECK(canonical({0xc6, 0, 0, 0, 1, 7}) == bytes{0xc4, 1, 7});
+  CHECK(canonical({0xc7, 4, 9, 1, 2, 3, 4}) == bytes{0xd6, 9, 1, 2, 3, 4});
+
+  // array32 holding a map16 of one pair, keys and values wide
+  CHECK(canonical({0xdd, 0, 0, 0, 1, 0xde, 0, 1, 0xd9, 1, 'k', 0xcd, 0, 1}) ==
+        bytes{0x91, 0x81, 0xa1, 'k', 0x01});
+
+  // Floats, nil and booleans are left alone
+  bytes other = {0x93, 0xca, 0x3f, 0x80, 0, 0, 0xc0, 0xc3};
+  CHECK(canonical(other) == other);
+
+  // Trailing bytes after the message are not copied
+  CHECK(canonical({0xd0, 0x05, 0x01, 0x02}) == bytes{0x05});
+}
+
+TEST_CASE("canonicalize manykernels") {
+  std::vector<unsigned char> doc(sample().start, sample().end);
+
+  std::vector<unsigned char> once = canonical(doc);
+  CHECK(once.size() <= doc.size());
+  CHECK(equal(range(doc), range(once)));
+  CHECK(canonical(once) == once);
+
+  std::vector<unsigned char> sorted = canonical(doc, true);
+  CHECK(sorted.size() == once.size());
+  CHECK(!equal(range(once), range(sorted)));
+  CHECK(equal(range(once), range(sorted), true));
+  CHECK(canonical(sorted, true) == sorted);
+  CHECK(canonical(sorted) == sorted);
+
+  SECTION("in place") {
+    std::vector<unsigned char> widened = {0xdd, 0, 0, 0, 3, 0xcc, 0x01,
+                                          0xda, 0,    1, 'x', 0xc0};
+    std::vector<unsigned char> expect = canonical(widened);
+    unsigned char *end = canonicalize(range(widened), widened.data());
+    REQUIRE(end != nullptr);
+    widened.resize(end - widened.data());
+    CHECK(widened == expect);
+    CHECK(widened == std::vector<unsigned char>{0x93, 0x01, 0xa1, 'x', 0xc0});
+  }
+}
+
+TEST_CASE("canonicalize sorts keys") {
+  typedef std::vector<unsigned char> bytes;
+  // {"b": 1, "a": {"d": 2, "c": 3}, "a": 4}
+  bytes doc = {0x83, 0xa1, 'b', 0x01, 0xa1, 'a', 0x82, 0xa1, 'd', 0x02,
+               0xa1, 'c', 0x03, 0xa1, 'a', 0x04};
+  CHECK(canonical(doc) == doc);
+  CHECK(canonical(doc, true) ==
+        bytes{0x83, 0xa1, 'a', 0x82, 0xa1, 'c', 0x03, 0xa1, 'd', 0x02, 0xa1,
+              'a', 0x04, 0xa1, 'b', 0x01});
+}
+
+TEST_CASE("canonicalize malformed") {
+  std::vector<std::vector<unsigned char>> cases = {
+      {},
+      {0xc1},
+      {0x92, 0x01},
+      {0xda, 0, 5, 'a'},
+      {0x81, 0xa1, 'k'},
+  };
+  for (const std::vector<unsigned char> &c : cases) {
+    std::vector<unsigned char> out;
+    CHECK(!canonicalize(range(c), out));
+    CHECK(!canonicalize(range(c), out, true));
+  }
+}
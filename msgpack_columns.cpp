@@ -0,0 +1,219 @@
+#include "msgpack_columns.h"
+#include "msgpack_decode.h"
+#include "msgpack_lookup.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+using msgpack::byte_range;
+using msgpack::column;
+using msgpack::token;
+
+column::kind_t widen(column::kind_t kind, const token &t) {
+  column::kind_t next;
+  switch (t.kind) {
+  case token::boolean:
+    next = column::boolean;
+    break;
+  case token::unsigned_integer:
+    next = column::unsigned_integer;
+    break;
+  case token::negative_integer:
+    next = column::signed_integer;
+    break;
+  case token::floating:
+    next = column::floating;
+    break;
+  case token::string:
+    next = column::string;
+    break;
+  default:
+    return column::message;
+  }
+
+  if (kind == column::none || kind == next) {
+    return next;
+  }
+  const bool numbers = (kind == column::unsigned_integer ||
+                        kind == column::signed_integer ||
+                        kind == column::floating) &&
+                       (next == column::unsigned_integer ||
+                        next == column::signed_integer ||
+                        next == column::floating);
+  if (!numbers) {
+    return column::message;
+  }
+  if (kind == column::floating || next == column::floating) {
+    return column::floating;
+  }
+  return column::signed_integer;
+}
+
+double as_double(const token &t) {
+  switch (t.kind) {
+  case token::unsigned_integer:
+    return (double)t.value;
+  case token::negative_integer:
+    return (double)(int64_t)t.value;
+  default: {
+    double d;
+    memcpy(&d, &t.value, 8);
+    return d;
+  }
+  }
+}
+
+// values[i] is the value of row i, {nullptr, nullptr} if absent
+void fill(column &c, const std::vector<byte_range> &values) {
+  const uint64_t rows = values.size();
+  c.rows = rows;
+  c.present.assign((rows + 63) / 64, 0);
+
+  // Kind from the non-nil values, found in a first pass
+  std::vector<token> tokens(rows);
+  c.kind = column::none;
+  uint64_t largest = 0;
+  for (uint64_t i = 0; i < rows; i++) {
+    token &t = tokens[i];
+    if (!values[i].start || !msgpack::read_token(values[i], t) ||
+        t.kind == token::nil) {
+      t.kind = token::nil;
+      continue;
+    }
+    c.present[i / 64] |= UINT64_C(1) << (i % 64);
+    c.kind = widen(c.kind, t);
+    if (t.kind == token::unsigned_integer && t.value > largest) {
+      largest = t.value;
+    }
+  }
+  if (c.kind == column::signed_integer && largest > INT64_MAX) {
+    c.kind = column::floating;
+  }
+
+  switch (c.kind) {
+  case column::none:
+    break;
+  case column::boolean:
+    c.booleans.assign(rows, 0);
+    break;
+  case column::unsigned_integer:
+    c.unsigned_values.assign(rows, 0);
+    break;
+  case column::signed_integer:
+    c.signed_values.assign(rows, 0);
+    break;
+  case column::floating:
+    c.float_values.assign(rows, 0.0);
+    break;
+  case column::string:
+    c.string_offsets.assign(rows + 1, 0);
+    break;
+  case column::message:
+    c.messages.assign(rows, {nullptr, nullptr});
+    break;
+  }
+
+  for (uint64_t i = 0; i < rows; i++) {
+    const token &t = tokens[i];
+    const bool present = t.kind != token::nil;
+    switch (c.kind) {
+    case column::none:
+      break;
+    case column::boolean:
+      c.booleans[i] = present && t.value;
+      break;
+    case column::unsigned_integer:
+      c.unsigned_values[i] = present ? t.value : 0;
+      break;
+    case column::signed_integer:
+      c.signed_values[i] = present ? (int64_t)t.value : 0;
+      break;
+    case column::floating:
+      c.float_values[i] = present ? as_double(t) : 0.0;
+      break;
+    case column::string:
+      if (present) {
+        c.string_arena.append((const char *)t.payload.start,
+                              t.payload.end - t.payload.start);
+      }
+      c.string_offsets[i + 1] = c.string_arena.size();
+      break;
+    case column::message:
+      if (present) {
+        const unsigned char *end = msgpack::fallback::skip_next_message(
+            values[i].start, values[i].end);
+        c.messages[i] = {values[i].start, end};
+      }
+      break;
+    }
+  }
+}
+} // namespace
+
+namespace msgpack {
+
+bool to_columns(byte_range bytes, const std::vector<std::string> &keys,
+                std::vector<column> &out) {
+  token t;
+  const unsigned char *p = read_token(bytes, t);
+  if (!p || t.kind != token::array) {
+    return false;
+  }
+
+  // Every element is at least one byte, so a corrupt count can't force a
+  // huge allocation
+  const uint64_t rows = t.value;
+  if (rows > (uint64_t)(bytes.end - p)) {
+    return false;
+  }
+
+  map_shape_cache cache(keys);
+  std::vector<std::vector<byte_range>> values(
+      keys.size(), std::vector<byte_range>(rows, {nullptr, nullptr}));
+  std::vector<byte_range> row(keys.size());
+  for (uint64_t i = 0; i < rows; i++) {
+    const unsigned char *next = fallback::skip_next_message(p, bytes.end);
+    if (!next) {
+      return false;
+    }
+    if (is_map({p, next}) && cache.lookup({p, next}, row.data())) {
+      for (size_t k = 0; k < keys.size(); k++) {
+        values[k][i] = row[k];
+      }
+    }
+    p = next;
+  }
+
+  out.assign(keys.size(), column());
+  for (size_t k = 0; k < keys.size(); k++) {
+    out[k].name = keys[k];
+    fill(out[k], values[k]);
+  }
+  return true;
+}
+
+bool to_columns(byte_range bytes, std::vector<column> &out) {
+  token t;
+  const unsigned char *p = read_token(bytes, t);
+  if (!p || t.kind != token::array) {
+    return false;
+  }
+
+  std::vector<std::string> keys;
+  if (t.value != 0) {
+    foreach_map({p, bytes.end}, [&](byte_range key, byte_range) {
+      token k;
+      if (read_token(key, k) && k.kind == token::string) {
+        std::string name((const char *)k.payload.start,
+                         k.payload.end - k.payload.start);
+        if (std::find(keys.begin(), keys.end(), name) == keys.end()) {
+          keys.push_back(name);
+        }
+      }
+    });
+  }
+  return to_columns(bytes, keys, out);
+}
+
+} // namespace msgpack
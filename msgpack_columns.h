@@ -0,0 +1,66 @@
+#ifndef MSGPACK_COLUMNS_H
+#define MSGPACK_COLUMNS_H
+
+#include "msgpack.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace msgpack {
+
+// One key across the rows of an array of maps, stored contiguously. Only the
+// storage for the column's kind is filled, with one entry per row, null rows
+// holding zero, an empty string or {nullptr, nullptr}.
+struct column {
+  // Chosen from every non-null value of the key: boolean if all are
+  // booleans, unsigned_integer if all are non-negative integers,
+  // signed_integer if integers of either sign fit int64, floating for any
+  // other mix of numbers, string if all are strings. Anything else is kept
+  // as message, ranges into the input. none if every row is null.
+  enum kind_t {
+    none,
+    boolean,
+    unsigned_integer,
+    signed_integer,
+    floating,
+    string,
+    message,
+  };
+
+  std::string name;
+  kind_t kind = none;
+  uint64_t rows = 0;
+
+  // Bit (i % 64) of present[i / 64] is set if row i has a non-nil value
+  std::vector<uint64_t> present;
+  bool is_present(uint64_t row) const {
+    return (present[row / 64] >> (row % 64)) & 1;
+  }
+
+  std::vector<unsigned char> booleans;
+  std::vector<uint64_t> unsigned_values;
+  std::vector<int64_t> signed_values;
+  std::vector<double> float_values;
+
+  // Row i is string_arena[string_offsets[i], string_offsets[i + 1])
+  std::vector<uint64_t> string_offsets;
+  std::string string_arena;
+
+  std::vector<byte_range> messages;
+};
+
+// Converts the array of maps at bytes.start into one column per key, row i
+// of each column taken from element i. Keys are matched as strings with a
+// map_shape_cache, so maps sharing one shape cost a memcmp per key. A key
+// that is missing or nil, or an element that is not a map, leaves the row
+// null. Returns false if bytes does not start with a well formed array.
+bool to_columns(byte_range bytes, const std::vector<std::string> &keys,
+                std::vector<column> &out);
+
+// As above with the distinct string keys of the first element, in map order
+bool to_columns(byte_range bytes, std::vector<column> &out);
+
+} // namespace msgpack
+
+#endif
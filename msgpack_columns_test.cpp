@@ -0,0 +1,131 @@
+#include "catch.hpp"
+#include "msgpack.h"
+#include "msgpack_columns.h"
+#include "msgpack_decode.h"
+#include "msgpack_path.h"
+#include "msgpack_test_util.h"
+
+#include <string>
+#include <vector>
+
+using namespace msgpack;
+
+namespace {
+std::string row_string(const column &c, uint64_t i) {
+  return c.string_arena.substr(c.string_offsets[i],
+                               c.string_offsets[i + 1] - c.string_offsets[i]);
+}
+} // namespace
+
+TEST_CASE("to_columns manykernels") {
+  byte_range doc = sample();
+  byte_range kernels = find(doc, {path_element::key("amdhsa.kernels")});
+  REQUIRE(kernels.start != nullptr);
+
+  std::vector<column> columns;
+  REQUIRE(to_columns(kernels, {".name", ".sgpr_count", ".missing"}, columns));
+  REQUIRE(columns.size() == 3);
+  const column &name = columns[0];
+  const column &sgpr = columns[1];
+  CHECK(name.kind == column::string);
+  CHECK(sgpr.kind == column::unsigned_integer);
+  CHECK(columns[2].kind == column::none);
+  CHECK(columns[2].present == std::vector<uint64_t>(columns[2].present.size()));
+
+  // Same answers as walking the maps
+  uint64_t row = 0;
+  uint64_t linear_sum = 0;
+  foreach_array(kernels, [&](byte_range kernel) {
+    std::string s;
+    REQUIRE(decode(find(kernel, {path_element::key(".name")}), s));
+    CHECK(row_string(name, row) == s);
+    uint64_t x = 0;
+    REQUIRE(decode(find(kernel, {path_element::key(".sgpr_count")}), x));
+    CHECK(sgpr.unsigned_values[row] == x);
+    CHECK(sgpr.is_present(row));
+    linear_sum += x;
+    row++;
+  });
+  CHECK(name.rows == row);
+
+  uint64_t column_sum = 0;
+  for (uint64_t x : sgpr.unsigned_values) {
+    column_sum += x;
+  }
+  CHECK(column_sum == linear_sum);
+
+  std::vector<column> inferred;
+  REQUIRE(to_columns(kernels, inferred));
+  bool has_name = false;
+  for (const column &c : inferred) {
+    has_name |= c.name == ".name" && c.string_arena == name.string_arena;
+  }
+  CHECK(has_name);
+}
+
+TEST_CASE("to_columns kinds and nulls") {
+  // [{"a": 1, "b": true, "c": "x"},
+  //  {"a": -2, "c": nil, "d": [1]},
+  //  7,
+  //  {"a": 1.5, "b": false, "c": "yz", "d": 3}]
+  std::vector<unsigned char> doc = {
+      0x94, 0x83, 0xa1, 'a', 0x01, 0xa1, 'b',  0xc3, 0xa1, 'c',  0xa1,
+      'x',  0x83, 0xa1, 'a', 0xfe, 0xa1, 'c',  0xc0, 0xa1, 'd',  0x91,
+      0x01, 0x07, 0x84, 0xa1, 'a', 0xcb, 0x3f, 0xf8, 0,    0,    0,
+      0,    0,    0,    0xa1, 'b', 0xc2, 0xa1, 'c',  0xa2, 'y',  'z',
+      0xa1, 'd',  0x03};
+
+  std::vector<column> columns;
+  REQUIRE(to_columns(range(doc), {"a", "b", "c", "d"}, columns));
+  const column &a = columns[0], &b = columns[1], &c = columns[2],
+               &d = columns[3];
+
+  CHECK(a.kind == column::floating);
+  CHECK(a.float_values == std::vector<double>{1.0, -2.0, 0.0, 1.5});
+  CHECK(a.present == std::vector<uint64_t>{0xb});
+
+  CHECK(b.kind == column::boolean);
+  CHECK(b.booleans == std::vector<unsigned char>{1, 0, 0, 0});
+  CHECK(b.present == std::vector<uint64_t>{0x9});
+
+  CHECK(c.kind == column::string);
+  CHECK(c.string_arena == "xyz");
+  CHECK(c.string_offsets == std::vector<uint64_t>{0, 1, 1, 1, 3});
+  CHECK(c.present == std::vector<uint64_t>{0x9});
+
+  CHECK(d.kind == column::message);
+  REQUIRE(d.messages.size() == 4);
+  CHECK(d.messages[0].start == nullptr);
+  CHECK(d.messages[1].end - d.messages[1].start == 2);
+  CHECK(*d.messages[3].start == 0x03);
+
+  // Signed when every integer fits int64
+  std::vector<unsigned char> ints = {0x92, 0x81, 0xa1, 'a', 0x05,
+                                     0x81, 0xa1, 'a', 0xd0, 0x80};
+  REQUIRE(to_columns(range(ints), columns));
+  REQUIRE(columns.size() == 1);
+  CHECK(columns[0].kind == column::signed_integer);
+  CHECK(columns[0].signed_values == std::vector<int64_t>{5, -128});
+
+  std::vector<unsigned char> not_array = {0x80};
+  CHECK(!to_columns(range(not_array), columns));
+  std::vector<unsigned char> truncated = {0x92, 0x80};
+  CHECK(!to_columns(range(truncated), columns));
+  std::vector<unsigned char> empty = {0x90};
+  REQUIRE(to_columns(range(empty), columns));
+  CHECK(columns.empty());
+}
+
+TEST_CASE("to_columns same count rows with different keys") {
+  // [{"a": 1, "b": 2}, {"a": 1, "c": 3}], one shape for map_shape_cache
+  std::vector<unsigned char> doc = {0x92, 0x82, 0xa1, 'a', 0x01, 0xa1, 'b',
+                                    0x02, 0x82, 0xa1, 'a', 0x01, 0xa1, 'c',
+                                    0x03};
+  std::vector<column> columns;
+  REQUIRE(to_columns(range(doc), {"a", "c"}, columns));
+  REQUIRE(columns.size() == 2);
+  CHECK(columns[0].unsigned_values == std::vector<uint64_t>{1, 1});
+  CHECK(columns[1].kind == column::unsigned_integer);
+  CHECK(columns[1].present == std::vector<uint64_t>{0x2});
+  CHECK(columns[1].unsigned_values == std::vector<uint64_t>{0, 3});
+}
@@ -0,0 +1,251 @@
+#include "msgpack_compare.h"
+#include "msgpack_decode.h"
+#include "msgpack_hash.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+using msgpack::byte_range;
+using msgpack::token;
+
+const byte_range missing = {nullptr, nullptr};
+
+bool same_token(const token &x, const token &y) {
+  const uint64_t n = x.payload.end - x.payload.start;
+  return x.kind == y.kind && x.value == y.value &&
+         n == (uint64_t)(y.payload.end - y.payload.start) &&
+         memcmp(x.payload.start, y.payload.start, n) == 0;
+}
+
+uint64_t children(const token &t) {
+  return (t.kind == token::array) ? t.value
+         : (t.kind == token::map) ? 2 * t.value
+                                  : 0;
+}
+
+// Messages equal in order have equal token streams, so no recursion is
+// needed, only a count of the messages still to read
+bool equal_ordered(byte_range a, byte_range b) {
+  const unsigned char *p = a.start;
+  const unsigned char *q = b.start;
+  uint64_t pending = 1;
+  while (pending != 0) {
+    token x, y;
+    p = read_token({p, a.end}, x);
+    q = read_token({q, b.end}, y);
+    if (!p || !q || !same_token(x, y)) {
+      return false;
+    }
+    pending += children(x) - 1;
+  }
+  return true;
+}
+
+struct pair_ref {
+  uint64_t key_hash;
+  uint64_t value_hash;
+  byte_range key;
+  byte_range value;
+};
+
+bool operator<(const pair_ref &x, const pair_ref &y) {
+  return (x.key_hash != y.key_hash) ? x.key_hash < y.key_hash
+                                    : x.value_hash < y.value_hash;
+}
+
+// The N pairs of a map payload starting at p, hashed. Advances p past them.
+bool collect_pairs(const unsigned char *&p, const unsigned char *end,
+                   uint64_t N, std::vector<pair_ref> &out) {
+  out.clear();
+  for (uint64_t i = 0; i < N; i++) {
+    pair_ref r;
+    const unsigned char *key_end =
+        msgpack::structural_hash({p, end}, r.key_hash);
+    if (!key_end) {
+      return false;
+    }
+    const unsigned char *value_end =
+        msgpack::structural_hash({key_end, end}, r.value_hash);
+    if (!value_end) {
+      return false;
+    }
+    r.key = {p, key_end};
+    r.value = {key_end, value_end};
+    out.push_back(r);
+    p = value_end;
+  }
+  return true;
+}
+
+bool equal_unordered(byte_range a, byte_range b, const unsigned char **a_end,
+                     const unsigned char **b_end) {
+  token x, y;
+  const unsigned char *p = read_token(a, x);
+  const unsigned char *q = read_token(b, y);
+  if (!p || !q || !same_token(x, y)) {
+    return false;
+  }
+
+  if (x.kind == token::array) {
+    for (uint64_t i = 0; i < x.value; i++) {
+      if (!equal_unordered({p, a.end}, {q, b.end}, &p, &q)) {
+        return false;
+      }
+    }
+  }
+
+  if (x.kind == token::map) {
+    // Pairs can only be equal if their hashes are, so each pair of a is
+    // compared with the few pairs of b that share its hashes
+    std::vector<pair_ref> xs, ys;
+    if (!collect_pairs(p, a.end, x.value, xs) ||
+        !collect_pairs(q, b.end, y.value, ys)) {
+      return false;
+    }
+    std::sort(ys.begin(), ys.end());
+    std::vector<bool> used(ys.size(), false);
+
+    for (const pair_ref &e : xs) {
+      bool matched = false;
+      for (auto it = std::lower_bound(ys.begin(), ys.end(), e);
+           !matched && it != ys.end() && !(e < *it); ++it) {
+        const size_t j = it - ys.begin();
+        const unsigned char *unused_a, *unused_b;
+        matched = !used[j] &&
+                  equal_unordered(e.key, it->key, &unused_a, &unused_b) &&
+                  equal_unordered(e.value, it->value, &unused_a, &unused_b);
+        used[j] = used[j] || matched;
+      }
+      if (!matched) {
+        return false;
+      }
+    }
+  }
+
+  *a_end = p;
+  *b_end = q;
+  return true;
+}
+
+// a and b are each exactly one message, as found by skip_next_message. That
+// accepts some messages read_token does not, such as the reserved 0xc1.
+bool diff_at(byte_range a, byte_range b, msgpack::path &where,
+             std::vector<msgpack::difference> &out) {
+  using namespace msgpack;
+  token x, y;
+  const unsigned char *p = read_token(a, x);
+  const unsigned char *q = read_token(b, y);
+  if (!p || !q) {
+    return false;
+  }
+
+  const bool containers = x.kind == y.kind &&
+                          (x.kind == token::array || x.kind == token::map);
+  if (!containers) {
+    if (!equal_ordered(a, b)) {
+      out.push_back({where, a, b});
+    }
+    return true;
+  }
+
+  if (x.kind == token::array) {
+    const uint64_t N = std::max(x.value, y.value);
+    for (uint64_t i = 0; i < N; i++) {
+      byte_range ea = missing;
+      byte_range eb = missing;
+      if (i < x.value) {
+        ea = {p, fallback::skip_next_message(p, a.end)};
+        p = ea.end;
+      }
+      if (i < y.value) {
+        eb = {q, fallback::skip_next_message(q, b.end)};
+        q = eb.end;
+      }
+
+      where.push_back(path_element::index(i));
+      if (ea.start && eb.start) {
+        if (!diff_at(ea, eb, where, out)) {
+          return false;
+        }
+      } else {
+        out.push_back({where, ea, eb});
+      }
+      where.pop_back();
+    }
+    return true;
+  }
+
+  // Maps, matching keys by value. Sorting is stable so duplicate keys pair
+  // up in order.
+  std::vector<pair_ref> xs, ys;
+  if (!collect_pairs(p, a.end, x.value, xs) ||
+      !collect_pairs(q, b.end, y.value, ys)) {
+    return false;
+  }
+  std::vector<size_t> order(ys.size());
+  for (size_t j = 0; j < order.size(); j++) {
+    order[j] = j;
+  }
+  std::stable_sort(order.begin(), order.end(), [&](size_t i, size_t j) {
+    return ys[i].key_hash < ys[j].key_hash;
+  });
+  std::vector<bool> used(ys.size(), false);
+
+  for (const pair_ref &e : xs) {
+    size_t match = ys.size();
+    auto it = std::lower_bound(order.begin(), order.end(), e.key_hash,
+                               [&](size_t j, uint64_t h) {
+                                 return ys[j].key_hash < h;
+                               });
+    for (; it != order.end() && ys[*it].key_hash == e.key_hash; ++it) {
+      if (!used[*it] && equal(e.key, ys[*it].key, true)) {
+        match = *it;
+        break;
+      }
+    }
+
+    where.push_back(path_element::key_message(e.key));
+    if (match != ys.size()) {
+      used[match] = true;
+      if (!diff_at(e.value, ys[match].value, where, out)) {
+        return false;
+      }
+    } else {
+      out.push_back({where, e.value, missing});
+    }
+    where.pop_back();
+  }
+
+  for (size_t j = 0; j < ys.size(); j++) {
+    if (!used[j]) {
+      where.push_back(path_element::key_message(ys[j].key));
+      out.push_back({where, missing, ys[j].value});
+      where.pop_back();
+    }
+  }
+  return true;
+}
+} // namespace
+
+namespace msgpack {
+
+bool equal(byte_range a, byte_range b, bool unordered_maps) {
+  if (equal_ordered(a, b)) {
+    return true;
+  }
+  const unsigned char *a_end, *b_end;
+  return unordered_maps && equal_unordered(a, b, &a_end, &b_end);
+}
+
+bool diff(byte_range a, byte_range b, std::vector<difference> &out) {
+  const unsigned char *a_end = fallback::skip_next_message(a.start, a.end);
+  const unsigned char *b_end = fallback::skip_next_message(b.start, b.end);
+  if (!a_end || !b_end) {
+    return false;
+  }
+  path where;
+  return diff_at({a.start, a_end}, {b.start, b_end}, where, out);
+}
+
+} // namespace msgpack
@@ -0,0 +1,37 @@
+#ifndef MSGPACK_COMPARE_H
+#define MSGPACK_COMPARE_H
+
+#include "msgpack.h"
+#include "msgpack_path.h"
+
+#include <vector>
+
+namespace msgpack {
+
+// Compares the values of the messages at a.start and b.start, walking both in
+// lockstep without decoding them. Encoding choices are ignored: integers
+// compare by value, strings whatever their header, float32 as float64 (by
+// bits, so NaN equals itself). With unordered_maps, maps are equal if they
+// hold the same pairs in any order, as for structural_hash. False if either
+// message is malformed.
+bool equal(byte_range a, byte_range b, bool unordered_maps = false);
+
+// A subtree that differs between two documents. a or b is {nullptr, nullptr}
+// when the subtree is only present on the other side, e.g. a map key that was
+// added or an array that grew.
+struct difference {
+  path where;
+  byte_range a;
+  byte_range b;
+};
+
+// Appends to out the outermost differing subtrees of the messages at a.start
+// and b.start. Arrays are compared index by index. Maps are matched by key in
+// any order, duplicate keys pairing up in the order they appear. Containers
+// of different kinds, or a container and a scalar, differ as a whole.
+// Returns false if either message is malformed, with out unspecified.
+bool diff(byte_range a, byte_range b, std::vector<difference> &out);
+
+} // namespace msgpack
+
+#endif
@@ -0,0 +1,139 @@
+#include "catch.hpp"
+#include "msgpack.h"
+#include "msgpack_compare.h"
+#include "msgpack_path.h"
+#include "msgpack_test_util.h"
+
+#include <vector>
+
+using namespace msgpack;
+
+namespace {
+bool eq(const std::vector<unsigned char> &a,
+        const std::vector<unsigned char> &b, bool unordered_maps = false) {
+  return equal(range(a), range(b), unordered_maps);
+}
+
+path kernel_field(uint64_t kernel, const char *field) {
+  return {path_element::key("amdhsa.kernels"), path_element::index(kernel),
+          path_element::key(field)};
+}
+} // namespace
+
+TEST_CASE("equal") {
+  SECTION("encodings") {
+    CHECK(eq({0x08}, {0xcf, 0, 0, 0, 0, 0, 0, 0, 0x08}));
+    CHECK(eq({0xff}, {0xd1, 0xff, 0xff}));
+    CHECK(!eq({0xff}, {0xcc, 0xff}));
+    CHECK(eq({0xa1, 'a'}, {0xda, 0, 1, 'a'}));
+    CHECK(!eq({0xa1, 'a'}, {0xc4, 1, 'a'}));
+    CHECK(eq({0xd4, 7, 'x'}, {0xc7, 1, 7, 'x'}));
+    CHECK(eq({0xca, 0x3f, 0xc0, 0, 0}, {0xcb, 0x3f, 0xf8, 0, 0, 0, 0, 0, 0}));
+    CHECK(eq({0x92, 0x01, 0xa0}, {0xdd, 0, 0, 0, 2, 0xcc, 0x01, 0xd9, 0}));
+    CHECK(!eq({0x92, 0x01, 0x02}, {0x93, 0x01, 0x02, 0x03}));
+  }
+
+  SECTION("map order") {
+    std::vector<unsigned char> a = {0x82, 0xa1, 'a', 0x01, 0xa1, 'b', 0x02};
+    std::vector<unsigned char> b = {0x82, 0xa1, 'b', 0x02, 0xa1, 'a', 0x01};
+    CHECK(!eq(a, b));
+    CHECK(eq(a, b, true));
+
+    // Nested under an array, with duplicate keys
+    std::vector<unsigned char> c = {0x91, 0x83, 1, 2, 1, 3, 1, 2};
+    std::vector<unsigned char> d = {0x91, 0x83, 1, 3, 1, 2, 1, 2};
+    std::vector<unsigned char> e = {0x91, 0x83, 1, 3, 1, 3, 1, 2};
+    CHECK(eq(c, d, true));
+    CHECK(!eq(c, e, true));
+    CHECK(!eq(e, c, true));
+  }
+
+  SECTION("malformed") {
+    CHECK(!eq({0x92, 0x01}, {0x92, 0x01}));
+    CHECK(!eq({0xc1}, {0xc1}));
+    CHECK(!eq({}, {}));
+  }
+}
+
+TEST_CASE("path") {
+  byte_range doc = sample();
+
+  path p = kernel_field(2, ".name");
+  CHECK(to_string(p) == "[\"amdhsa.kernels\"][2][\".name\"]");
+
+  byte_range name = find(doc, p);
+  REQUIRE(name.start);
+  CHECK(is_string(name));
+  CHECK(fallback::skip_next_message(name.start, doc.end) == name.end);
+
+  CHECK(!find(doc, kernel_field(100000, ".name")).start);
+  CHECK(!find(doc, kernel_field(2, ".no_such_key")).start);
+  CHECK(!find(doc, {path_element::index(0)}).start);
+
+  byte_range whole = find(doc, {});
+  CHECK(whole.start == doc.start);
+  CHECK(whole.end == fallback::skip_next_message(doc.start, doc.end));
+
+  // Keys match by value, here an integer key written as uint16
+  std::vector<unsigned char> m = {0x81, 0xcd, 0x01, 0x00, 0xa1, 'x'};
+  std::vector<unsigned char> key = {0xcd, 0x01, 0x00};
+  path q = {path_element::key_message(range(key))};
+  CHECK(find(range(m), q).start == m.data() + 4);
+  CHECK(to_string(q) == "[256]");
+}
+
+TEST_CASE("diff") {
+  byte_range doc = sample();
+  std::vector<difference> out;
+
+  SECTION("identical") {
+    CHECK(diff(doc, doc, out));
+    CHECK(out.empty());
+  }
+
+  SECTION("one changed kernel field") {
+    std::vector<unsigned char> copy(doc.start, doc.end);
+    byte_range field = find(range(copy), kernel_field(3, ".sgpr_count"));
+    REQUIRE(field.start);
+    REQUIRE(*field.start < 0x7f);
+    const_cast<unsigned char *>(field.start)[0]++;
+
+    CHECK(diff(doc, range(copy), out));
+    REQUIRE(out.size() == 1);
+    CHECK(to_string(out[0].where) ==
+          "[\"amdhsa.kernels\"][3][\".sgpr_count\"]");
+    CHECK(out[0].b.start == field.start);
+    CHECK(out[0].a.start == doc.start + (field.start - copy.data()));
+  }
+
+  SECTION("keys and elements added and removed") {
+    // {"a": [1, 2], "b": 1, "c": {"x": 1}} vs {"c": {"x": 2}, "a": [1], "d": 1}
+    std::vector<unsigned char> a = {0x83, 0xa1, 'a', 0x92, 0x01, 0x02,
+                                    0xa1, 'b',  0x01, 0xa1, 'c',  0x81,
+                                    0xa1, 'x',  0x01};
+    std::vector<unsigned char> b = {0x83, 0xa1, 'c', 0x81, 0xa1, 'x',
+                                    0x02, 0xa1, 'a', 0x91, 0x01, 0xa1,
+                                    'd',  0x01};
+    CHECK(diff(range(a), range(b), out));
+    REQUIRE(out.size() == 4);
+    CHECK(to_string(out[0].where) == "[\"a\"][1]");
+    CHECK(out[0].a.start == a.data() + 5);
+    CHECK(!out[0].b.start);
+    CHECK(to_string(out[1].where) == "[\"b\"]");
+    CHECK(!out[1].b.start);
+    CHECK(to_string(out[2].where) == "[\"c\"][\"x\"]");
+    CHECK(to_string(out[3].where) == "[\"d\"]");
+    CHECK(!out[3].a.start);
+  }
+
+  SECTION("type change and malformed") {
+    std::vector<unsigned char> a = {0x91, 0x01};
+    std::vector<unsigned char> b = {0x81, 0x01, 0x01};
+    CHECK(diff(range(a), range(b), out));
+    REQUIRE(out.size() == 1);
+    CHECK(out[0].where.empty());
+
+    std::vector<unsigned char> bad = {0x92, 0x01};
+    CHECK(!diff(range(a), range(bad), out));
+  }
+}
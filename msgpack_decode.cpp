@@ -0,0 +1,202 @@
+#include "msgpack_decode.h"
+
+#include <cstring>
+
+namespace msgpack {
+
+const unsigned char *decode(byte_range bytes, bool &out) {
+  struct inner : functors_defaults<inner> {
+    inner(bool &out, bool &ok) : out(out), ok(ok) {}
+    bool &out;
+    bool &ok;
+    void handle_boolean(bool x) {
+      out = x;
+      ok = true;
+    }
+  };
+  bool ok = false;
+  const unsigned char *r = handle_msgpack<inner>(bytes, {out, ok});
+  return ok ? r : nullptr;
+}
+
+const unsigned char *decode(byte_range bytes, uint64_t &out) {
+  struct inner : functors_defaults<inner> {
+    inner(uint64_t &out, bool &ok) : out(out), ok(ok) {}
+    uint64_t &out;
+    bool &ok;
+    void handle_unsigned(uint64_t x) {
+      out = x;
+      ok = true;
+    }
+    void handle_signed(int64_t x) {
+      out = x;
+      ok = x >= 0;
+    }
+  };
+  bool ok = false;
+  const unsigned char *r = handle_msgpack<inner>(bytes, {out, ok});
+  return ok ? r : nullptr;
+}
+
+const unsigned char *decode(byte_range bytes, int64_t &out) {
+  struct inner : functors_defaults<inner> {
+    inner(int64_t &out, bool &ok) : out(out), ok(ok) {}
+    int64_t &out;
+    bool &ok;
+    void handle_unsigned(uint64_t x) {
+      out = x;
+      ok = x <= INT64_MAX;
+    }
+    void handle_signed(int64_t x) {
+      out = x;
+      ok = true;
+    }
+  };
+  bool ok = false;
+  const unsigned char *r = handle_msgpack<inner>(bytes, {out, ok});
+  return ok ? r : nullptr;
+}
+
+const unsigned char *decode(byte_range bytes, std::string &out) {
+  struct inner : functors_defaults<inner> {
+    inner(std::string &out, bool &ok) : out(out), ok(ok) {}
+    std::string &out;
+    bool &ok;
+    void handle_string(size_t N, const unsigned char *str) {
+      out.assign(str, str + N);
+      ok = true;
+    }
+  };
+  bool ok = false;
+  const unsigned char *r = handle_msgpack<inner>(bytes, {out, ok});
+  return ok ? r : nullptr;
+}
+
+const unsigned char *decode_string(byte_range bytes, byte_range &payload) {
+  struct inner : functors_defaults<inner> {
+    inner(byte_range &out, bool &ok) : out(out), ok(ok) {}
+    byte_range &out;
+    bool &ok;
+    void handle_string(size_t N, const unsigned char *str) {
+      out = {str, str + N};
+      ok = true;
+    }
+  };
+  bool ok = false;
+  const unsigned char *r = handle_msgpack<inner>(bytes, {payload, ok});
+  return ok ? r : nullptr;
+}
+
+const unsigned char *decode(byte_range bytes, byte_range &out) {
+  const unsigned char *r = fallback::skip_next_message(bytes.start, bytes.end);
+  if (r) {
+    out = {bytes.start, r};
+  }
+  return r;
+}
+
+const unsigned char *read_token(byte_range bytes, token &out) {
+  const uint64_t available = bytes.end - bytes.start;
+  if (available == 0) {
+    return nullptr;
+  }
+
+  const unsigned char *start = bytes.start;
+  const msgpack::type ty = parse_type(*start);
+  const uint64_t header = bytes_used_fixed(ty);
+  if (available < header) {
+    return nullptr;
+  }
+  const uint64_t N = payload_info(ty)(start);
+
+  out.value = N;
+  out.payload = {start + header, start + header};
+  out.next = start + header;
+
+  switch (categorize(ty)) {
+  case msgpack::boolean:
+    out.kind = token::boolean;
+    return out.next;
+  case msgpack::unsigned_integer:
+    out.kind = token::unsigned_integer;
+    return out.next;
+  case msgpack::signed_integer:
+    out.kind = (bitcast<uint64_t, int64_t>(N) < 0) ? token::negative_integer
+                                                   : token::unsigned_integer;
+    return out.next;
+  case msgpack::array:
+    out.kind = token::array;
+    return out.next;
+  case msgpack::map:
+    out.kind = token::map;
+    return out.next;
+  case msgpack::string:
+  case msgpack::other:
+    break;
+  }
+
+  switch (ty) {
+  case msgpack::nil:
+    out.kind = token::nil;
+    out.value = 0;
+    return out.next;
+
+  case msgpack::float32: {
+    uint32_t bits;
+    memcpy(&bits, start + 1, 4);
+    bits = __builtin_bswap32(bits);
+    float f;
+    memcpy(&f, &bits, 4);
+    double d = f;
+    memcpy(&out.value, &d, 8);
+    out.kind = token::floating;
+    return out.next;
+  }
+
+  case msgpack::float64: {
+    uint64_t bits;
+    memcpy(&bits, start + 1, 8);
+    out.value = __builtin_bswap64(bits);
+    out.kind = token::floating;
+    return out.next;
+  }
+
+  case msgpack::fixext1:
+  case msgpack::fixext2:
+  case msgpack::fixext4:
+  case msgpack::fixext8:
+  case msgpack::fixext16:
+    // [tag][type][data], the data length implied by the tag
+    out.kind = token::extension;
+    out.value = start[1];
+    out.payload = {start + 2, start + header};
+    return out.next;
+
+  case msgpack::never_used:
+    return nullptr;
+
+  default:
+    break;
+  }
+
+  // Strings, bin and ext carry N bytes after the header
+  if (available - header < N) {
+    return nullptr;
+  }
+  out.payload.end = start + header + N;
+  out.next = out.payload.end;
+
+  if (cat::is_string(ty)) {
+    out.kind = token::string;
+  } else if (ty == msgpack::ext8 || ty == msgpack::ext16 ||
+             ty == msgpack::ext32) {
+    // [tag][length][type][data]
+    out.kind = token::extension;
+    out.value = start[header - 1];
+  } else {
+    out.kind = token::binary;
+  }
+  return out.next;
+}
+
+} // namespace msgpack
@@ -0,0 +1,231 @@
+#ifndef MSGPACK_DECODE_H
+#define MSGPACK_DECODE_H
+
+#include "msgpack.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if __cplusplus >= 201703L
+#include <optional>
+#include <variant>
+#endif
+
+namespace msgpack {
+// Typed readers. Each decodes the message at bytes.start into out and returns
+// one past the end of it, or nullptr if the message is malformed or of an
+// incompatible type. out is unspecified on failure.
+
+const unsigned char *decode(byte_range bytes, bool &out);
+
+// Integers are accepted from either signedness when the value fits
+const unsigned char *decode(byte_range bytes, uint64_t &out);
+const unsigned char *decode(byte_range bytes, int64_t &out);
+
+// Narrower integer types, failing if the value does not fit
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value &&
+                            !std::is_same<T, bool>::value,
+                        const unsigned char *>::type
+decode(byte_range bytes, T &out) {
+  typedef typename std::conditional<std::is_signed<T>::value, int64_t,
+                                    uint64_t>::type wide;
+  wide x;
+  const unsigned char *r = decode(bytes, x);
+  if (!r || static_cast<wide>(static_cast<T>(x)) != x) {
+    return nullptr;
+  }
+  out = static_cast<T>(x);
+  return r;
+}
+
+const unsigned char *decode(byte_range bytes, std::string &out);
+
+// The payload of a string message, without copying it
+const unsigned char *decode_string(byte_range bytes, byte_range &payload);
+
+// Any single message, left undecoded
+const unsigned char *decode(byte_range bytes, byte_range &out);
+
+// One message reduced to its value, with the choice of encoding removed. The
+// integer 8 reads the same whether stored as posfixint or int64, as does a
+// string with any of the four string headers. Containers are read as their
+// header alone; their elements follow at next.
+struct token {
+  enum kind_t {
+    nil,
+    boolean,
+    unsigned_integer, // including non-negative values of signed encodings
+    negative_integer,
+    floating,         // float32 is widened to float64
+    string,
+    binary,
+    extension,
+    array,
+    map,
+  };
+
+  kind_t kind;
+
+  // Value of a boolean or integer, bits of a double, element count of an
+  // array, pair count of a map or the type of an extension
+  uint64_t value;
+
+  // Bytes of a string, binary or extension
+  byte_range payload;
+
+  // One past the message, or past the header of a container
+  const unsigned char *next;
+};
+
+// Reads the token at bytes.start. Returns token.next, or nullptr if the
+// message is malformed or truncated. Container elements are not checked.
+const unsigned char *read_token(byte_range bytes, token &out);
+
+namespace detail {
+// A callback returning const unsigned char * decodes its element from an
+// unbounded range and returns one past it, so the element is read once. A
+// callback returning bool is given the element alone, found by skipping it
+// first.
+template <typename C>
+const unsigned char *decode_element(C &callback, byte_range rest,
+                                    std::true_type) {
+  return callback(rest);
+}
+
+template <typename C>
+const unsigned char *decode_element(C &callback, byte_range rest,
+                                    std::false_type) {
+  const unsigned char *next = fallback::skip_next_message(rest.start, rest.end);
+  return (next && callback(byte_range{rest.start, next})) ? next : nullptr;
+}
+
+template <typename C>
+const unsigned char *decode_pair(C &callback, byte_range key, byte_range rest,
+                                 std::true_type) {
+  return callback(key, rest);
+}
+
+template <typename C>
+const unsigned char *decode_pair(C &callback, byte_range key, byte_range rest,
+                                 std::false_type) {
+  const unsigned char *next = fallback::skip_next_message(rest.start, rest.end);
+  return (next && callback(key, byte_range{rest.start, next})) ? next
+                                                                : nullptr;
+}
+} // namespace detail
+
+// Calls callback(element) for each element of the array at bytes.start, or
+// callback(key, value) for each pair of the map. Returns one past the
+// container, or nullptr if it is not of that type, is malformed or the
+// callback failed.
+//
+// The callback either returns bool, false to stop, and is passed the element
+// (or value) alone, or returns const unsigned char *, one past the element
+// or nullptr to stop, and is passed the element through to the end of
+// bytes. The second form decodes each element in one pass, so should skip
+// any element it ignores with fallback::skip_next_message. Keys are always
+// passed alone.
+template <typename C>
+const unsigned char *decode_array(byte_range bytes, C callback) {
+  if (!is_array(bytes)) {
+    return nullptr;
+  }
+  typedef typename std::is_same<decltype(callback(bytes)),
+                                const unsigned char *>::type returns_end;
+  const msgpack::type ty = parse_type(*bytes.start);
+  const uint64_t N = payload_info(ty)(bytes.start);
+  const unsigned char *p = bytes.start + bytes_used_fixed(ty);
+  for (uint64_t i = 0; i < N && p; i++) {
+    p = detail::decode_element(callback, byte_range{p, bytes.end},
+                               returns_end());
+  }
+  return p;
+}
+
+template <typename C>
+const unsigned char *decode_map(byte_range bytes, C callback) {
+  if (!is_map(bytes)) {
+    return nullptr;
+  }
+  typedef typename std::is_same<decltype(callback(bytes, bytes)),
+                                const unsigned char *>::type returns_end;
+  const msgpack::type ty = parse_type(*bytes.start);
+  const uint64_t N = payload_info(ty)(bytes.start);
+  const unsigned char *p = bytes.start + bytes_used_fixed(ty);
+  for (uint64_t i = 0; i < N && p; i++) {
+    const unsigned char *key_end = fallback::skip_next_message(p, bytes.end);
+    if (!key_end) {
+      return nullptr;
+    }
+    p = detail::decode_pair(callback, byte_range{p, key_end},
+                            byte_range{key_end, bytes.end}, returns_end());
+  }
+  return p;
+}
+
+template <typename T>
+const unsigned char *decode(byte_range bytes, std::vector<T> &out) {
+  out.clear();
+  return decode_array(bytes, [&](byte_range element) -> const unsigned char * {
+    out.emplace_back();
+    return decode(element, out.back());
+  });
+}
+
+#if __cplusplus >= 201703L
+// Nil reads as monostate or an empty optional. A variant takes the first of
+// its alternatives, in declaration order, that decodes the message. Variants
+// are encoded untagged, see msgpack_traits.h for when that round trips.
+inline const unsigned char *decode(byte_range bytes, std::monostate &) {
+  if (bytes.start == bytes.end || *bytes.start != 0xc0) {
+    return nullptr;
+  }
+  return bytes.start + 1;
+}
+
+template <typename T>
+const unsigned char *decode(byte_range bytes, std::optional<T> &out) {
+  if (bytes.start != bytes.end && *bytes.start == 0xc0) {
+    out.reset();
+    return bytes.start + 1;
+  }
+  return decode(bytes, out.emplace());
+}
+
+template <typename... Ts>
+const unsigned char *decode(byte_range bytes, std::variant<Ts...> &out) {
+  const unsigned char *r = nullptr;
+  auto alternative = [&](auto tag) {
+    typename decltype(tag)::type x{};
+    r = decode(bytes, x);
+    if (r) {
+      out = std::move(x);
+    }
+    return r != nullptr;
+  };
+  (alternative(std::common_type<Ts>()) || ...);
+  return r;
+}
+#endif
+
+namespace detail {
+// Matches a fixed byte sequence, e.g. an encoded key, at p. Returns one past
+// it or nullptr. Used by generated decoders.
+inline const unsigned char *expect_bytes(const unsigned char *p,
+                                         const unsigned char *end,
+                                         const unsigned char *expect,
+                                         size_t N) {
+  if ((uint64_t)(end - p) < N || memcmp(p, expect, N) != 0) {
+    return nullptr;
+  }
+  return p + N;
+}
+} // namespace detail
+
+} // namespace msgpack
+
+#endif
@@ -0,0 +1,267 @@
+#include "msgpack_encode.h"
+#include "msgpack_endian.h"
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+using msgpack::detail::write_tagged;
+
+uint64_t available(unsigned char *start, unsigned char *end) {
+  return end - start;
+}
+
+// Elements per encoding decision. Large enough for the fixed stride loops to
+// vectorize, small enough that one outlier doesn't widen the whole array.
+const uint64_t block = 16;
+
+// Narrowest encoding holding every value in a block
+template <typename T>
+msgpack::type select_type(const T *data, uint64_t n, std::true_type) {
+  using namespace msgpack;
+  int64_t lo = 0;
+  int64_t hi = 0;
+  for (uint64_t i = 0; i < n; i++) {
+    int64_t v = data[i];
+    lo = v < lo ? v : lo;
+    hi = v > hi ? v : hi;
+  }
+
+  if (lo >= -32 && hi <= 127) {
+    return posfixint;
+  }
+  if (lo >= 0) {
+    return (hi <= UINT8_MAX)    ? uint8
+           : (hi <= UINT16_MAX) ? uint16
+           : (hi <= UINT32_MAX) ? uint32
+                                : uint64;
+  }
+  return (lo >= INT8_MIN && hi <= INT8_MAX)     ? int8
+         : (lo >= INT16_MIN && hi <= INT16_MAX) ? int16
+         : (lo >= INT32_MIN && hi <= INT32_MAX) ? int32
+                                                : int64;
+}
+
+template <typename T>
+msgpack::type select_type(const T *data, uint64_t n, std::false_type) {
+  using namespace msgpack;
+  uint64_t hi = 0;
+  for (uint64_t i = 0; i < n; i++) {
+    uint64_t v = data[i];
+    hi = v > hi ? v : hi;
+  }
+  return (hi <= 127)          ? posfixint
+         : (hi <= UINT8_MAX)  ? uint8
+         : (hi <= UINT16_MAX) ? uint16
+         : (hi <= UINT32_MAX) ? uint32
+                              : uint64;
+}
+
+// Vector fast path for a full block of fixint values. Returns false without
+// writing anything if any value in the block needs a wider encoding.
+template <typename T> bool fixint_block(const T *, unsigned char *) {
+  return false;
+}
+
+#if defined(__SSE2__)
+bool fixint_block_32(const void *data, int32_t lo, unsigned char *out) {
+  static_assert(block == 16, "Four vectors of four lanes");
+  const __m128i *p = static_cast<const __m128i *>(data);
+  __m128i a = _mm_loadu_si128(p + 0);
+  __m128i b = _mm_loadu_si128(p + 1);
+  __m128i c = _mm_loadu_si128(p + 2);
+  __m128i d = _mm_loadu_si128(p + 3);
+
+  const __m128i below = _mm_set1_epi32(lo - 1);
+  const __m128i above = _mm_set1_epi32(128);
+  auto in_range = [&](__m128i x) {
+    return _mm_and_si128(_mm_cmpgt_epi32(x, below), _mm_cmplt_epi32(x, above));
+  };
+
+  __m128i ok = _mm_and_si128(_mm_and_si128(in_range(a), in_range(b)),
+                             _mm_and_si128(in_range(c), in_range(d)));
+  if (_mm_movemask_epi8(ok) != 0xffff) {
+    return false;
+  }
+
+  // Every lane is within int8, so the saturating packs are exact
+  __m128i bytes =
+      _mm_packs_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(out), bytes);
+  return true;
+}
+
+// uint32 values above INT32_MAX read as negative and fail the lower bound
+template <> bool fixint_block(const uint32_t *data, unsigned char *out) {
+  return fixint_block_32(data, 0, out);
+}
+template <> bool fixint_block(const int32_t *data, unsigned char *out) {
+  return fixint_block_32(data, -32, out);
+}
+#endif
+
+template <typename U, typename T>
+unsigned char *put_sized(unsigned char tag, const T *data, uint64_t n,
+                         unsigned char *out) {
+  for (uint64_t i = 0; i < n; i++) {
+    out = write_tagged(tag, static_cast<U>(data[i]), out);
+  }
+  return out;
+}
+
+template <typename T>
+unsigned char *put_block(msgpack::type ty, const T *data, uint64_t n,
+                         unsigned char *out) {
+  using namespace msgpack;
+  switch (ty) {
+  case posfixint: {
+    // posfixint and negfixint are the low byte of the two's complement value
+    for (uint64_t i = 0; i < n; i++) {
+      out[i] = static_cast<unsigned char>(data[i]);
+    }
+    return out + n;
+  }
+  case uint8:
+    return put_sized<uint8_t>(0xcc, data, n, out);
+  case uint16:
+    return put_sized<uint16_t>(0xcd, data, n, out);
+  case uint32:
+    return put_sized<uint32_t>(0xce, data, n, out);
+  case uint64:
+    return put_sized<uint64_t>(0xcf, data, n, out);
+  case int8:
+    return put_sized<uint8_t>(0xd0, data, n, out);
+  case int16:
+    return put_sized<uint16_t>(0xd1, data, n, out);
+  case int32:
+    return put_sized<uint32_t>(0xd2, data, n, out);
+  case int64:
+    return put_sized<uint64_t>(0xd3, data, n, out);
+  default:
+    __builtin_unreachable();
+  }
+}
+
+template <typename T>
+unsigned char *encode_integer_array(const T *data, uint64_t N,
+                                    unsigned char *start, unsigned char *end) {
+  start = msgpack::encode_array_header(N, start, end);
+  if (!start) {
+    return nullptr;
+  }
+
+  for (uint64_t i = 0; i < N; i += block) {
+    const uint64_t n = (N - i) < block ? (N - i) : block;
+    const T *values = data + i;
+
+    if (n == block && available(start, end) >= block &&
+        fixint_block(values, start)) {
+      start += block;
+      continue;
+    }
+
+    msgpack::type ty = select_type(values, n, std::is_signed<T>());
+    if (available(start, end) < n * msgpack::bytes_used_fixed(ty)) {
+      return nullptr;
+    }
+    start = put_block(ty, values, n, start);
+  }
+
+  return start;
+}
+
+template <typename U, typename T>
+unsigned char *encode_float_array(unsigned char tag, const T *data,
+                                  uint64_t N, unsigned char *start,
+                                  unsigned char *end) {
+  static_assert(sizeof(U) == sizeof(T), "");
+  start = msgpack::encode_array_header(N, start, end);
+  if (!start) {
+    return nullptr;
+  }
+  if (available(start, end) < N * (1 + sizeof(T))) {
+    return nullptr;
+  }
+
+  for (uint64_t i = 0; i < N; i++) {
+    U bits;
+    memcpy(&bits, &data[i], sizeof(U));
+    start = write_tagged(tag, bits, start);
+  }
+  return start;
+}
+
+} // namespace
+
+namespace msgpack {
+unsigned char *encode_array_header(uint64_t N, unsigned char *start,
+                                   unsigned char *end) {
+  if (N <= 15) {
+    if (available(start, end) < 1) {
+      return nullptr;
+    }
+    *start = 0x90 | static_cast<unsigned char>(N);
+    return start + 1;
+  }
+  if (N <= UINT16_MAX) {
+    if (available(start, end) < 3) {
+      return nullptr;
+    }
+    return write_tagged(0xdc, static_cast<uint16_t>(N), start);
+  }
+  if (N <= UINT32_MAX) {
+    if (available(start, end) < 5) {
+      return nullptr;
+    }
+    return write_tagged(0xdd, static_cast<uint32_t>(N), start);
+  }
+  return nullptr;
+}
+
+unsigned char *encode_array(const uint8_t *data, uint64_t N,
+                            unsigned char *start, unsigned char *end) {
+  return encode_integer_array(data, N, start, end);
+}
+unsigned char *encode_array(const uint16_t *data, uint64_t N,
+                            unsigned char *start, unsigned char *end) {
+  return encode_integer_array(data, N, start, end);
+}
+unsigned char *encode_array(const uint32_t *data, uint64_t N,
+                            unsigned char *start, unsigned char *end) {
+  return encode_integer_array(data, N, start, end);
+}
+unsigned char *encode_array(const uint64_t *data, uint64_t N,
+                            unsigned char *start, unsigned char *end) {
+  return encode_integer_array(data, N, start, end);
+}
+unsigned char *encode_array(const int8_t *data, uint64_t N,
+                            unsigned char *start, unsigned char *end) {
+  return encode_integer_array(data, N, start, end);
+}
+unsigned char *encode_array(const int16_t *data, uint64_t N,
+                            unsigned char *start, unsigned char *end) {
+  return encode_integer_array(data, N, start, end);
+}
+unsigned char *encode_array(const int32_t *data, uint64_t N,
+                            unsigned char *start, unsigned char *end) {
+  return encode_integer_array(data, N, start, end);
+}
+unsigned char *encode_array(const int64_t *data, uint64_t N,
+                            unsigned char *start, unsigned char *end) {
+  return encode_integer_array(data, N, start, end);
+}
+unsigned char *encode_array(const float *data, uint64_t N,
+                            unsigned char *start, unsigned char *end) {
+  return encode_float_array<uint32_t>(0xca, data, N, start, end);
+}
+unsigned char *encode_array(const double *data, uint64_t N,
+                            unsigned char *start, unsigned char *end) {
+  return encode_float_array<uint64_t>(0xcb, data, N, start, end);
+}
+
+} // namespace msgpack
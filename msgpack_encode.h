@@ -0,0 +1,49 @@
+#ifndef MSGPACK_ENCODE_H
+#define MSGPACK_ENCODE_H
+
+#include "msgpack.h"
+
+#include <cstdint>
+
+namespace msgpack {
+// Writers return one past the last byte written, or nullptr if the message
+// does not fit in [start, end). Nothing useful is left in the buffer on
+// failure.
+
+unsigned char *encode_array_header(uint64_t N, unsigned char *start,
+                                   unsigned char *end);
+
+// Bulk encoders for numeric arrays. Write an array message containing the N
+// values from data. Integers are encoded in blocks of sixteen elements, each
+// block using the narrowest encoding that holds every value in the block, so
+// runs of small values collapse to fixint while the inner loops stay branch
+// free. Floats keep their width (float32 or float64).
+unsigned char *encode_array(const uint8_t *data, uint64_t N,
+                            unsigned char *start, unsigned char *end);
+unsigned char *encode_array(const uint16_t *data, uint64_t N,
+                            unsigned char *start, unsigned char *end);
+unsigned char *encode_array(const uint32_t *data, uint64_t N,
+                            unsigned char *start, unsigned char *end);
+unsigned char *encode_array(const uint64_t *data, uint64_t N,
+                            unsigned char *start, unsigned char *end);
+unsigned char *encode_array(const int8_t *data, uint64_t N,
+                            unsigned char *start, unsigned char *end);
+unsigned char *encode_array(const int16_t *data, uint64_t N,
+                            unsigned char *start, unsigned char *end);
+unsigned char *encode_array(const int32_t *data, uint64_t N,
+                            unsigned char *start, unsigned char *end);
+unsigned char *encode_array(const int64_t *data, uint64_t N,
+                            unsigned char *start, unsigned char *end);
+unsigned char *encode_array(const float *data, uint64_t N,
+                            unsigned char *start, unsigned char *end);
+unsigned char *encode_array(const double *data, uint64_t N,
+                            unsigned char *start, unsigned char *end);
+
+// Upper bound on the bytes written by encode_array for N elements of type T
+template <typename T> constexpr uint64_t encode_array_bound(uint64_t N) {
+  return 5 + N * (1 + sizeof(T));
+}
+
+} // namespace msgpack
+
+#endif
@@ -0,0 +1,184 @@
+#include "catch.hpp"
+#include "msgpack.h"
+#include "msgpack_encode.h"
+
+#include <cstring>
+#include <vector>
+
+using namespace msgpack;
+
+namespace {
+template <typename T>
+std::vector<unsigned char> encode_vector(const std::vector<T> &values) {
+  std::vector<unsigned char> out(encode_array_bound<T>(values.size()));
+  unsigned char *r =
+      encode_array(values.data(), values.size(), out.data(),
+                   out.data() + out.size());
+  REQUIRE(r != nullptr);
+  out.resize(r - out.data());
+  return out;
+}
+
+std::vector<uint64_t> decode_unsigned(byte_range bytes) {
+  std::vector<uint64_t> res;
+  foreach_array(bytes, [&](byte_range element) {
+    foronly_unsigned(element, [&](uint64_t x) { res.push_back(x); });
+  });
+  return res;
+}
+
+// Non-negative values may be encoded as either posfixint or a uint type
+std::vector<int64_t> decode_signed(byte_range bytes) {
+  std::vector<int64_t> res;
+  foreach_array(bytes, [&](byte_range element) {
+    foronly_signed(element, [&](int64_t x) { res.push_back(x); });
+    foronly_unsigned(element, [&](uint64_t x) { res.push_back((int64_t)x); });
+  });
+  return res;
+}
+
+template <typename T> void check_unsigned(const std::vector<T> &values) {
+  std::vector<unsigned char> bytes = encode_vector(values);
+  std::vector<uint64_t> got =
+      decode_unsigned({bytes.data(), bytes.data() + bytes.size()});
+  REQUIRE(got.size() == values.size());
+  for (size_t i = 0; i < values.size(); i++) {
+    CHECK(got[i] == values[i]);
+  }
+}
+
+template <typename T> void check_signed(const std::vector<T> &values) {
+  std::vector<unsigned char> bytes = encode_vector(values);
+  std::vector<int64_t> got =
+      decode_signed({bytes.data(), bytes.data() + bytes.size()});
+  REQUIRE(got.size() == values.size());
+  for (size_t i = 0; i < values.size(); i++) {
+    CHECK(got[i] == values[i]);
+  }
+}
+} // namespace
+
+TEST_CASE("encode_array header") {
+  for (uint64_t n : {0, 1, 15, 16, 17, 31, 32, 33, 65535, 65536, 70000}) {
+    std::vector<uint32_t> values(n, 3);
+    std::vector<unsigned char> bytes = encode_vector(values);
+    uint64_t header = n <= 15 ? 1 : n <= 65535 ? 3 : 5;
+    CHECK(bytes.size() == header + n);
+    CHECK(is_array({bytes.data(), bytes.data() + bytes.size()}));
+    CHECK(decode_unsigned({bytes.data(), bytes.data() + bytes.size()}).size() ==
+          n);
+  }
+}
+
+TEST_CASE("encode_array unsigned") {
+  std::vector<uint64_t> edges = {0,          1,          127,
+                                 128,        UINT8_MAX,  UINT8_MAX + 1,
+                                 UINT16_MAX, UINT16_MAX + 1, UINT32_MAX,
+                                 UINT32_MAX + UINT64_C(1), UINT64_MAX};
+  std::vector<uint64_t> values;
+  for (unsigned rep = 0; rep < 40; rep++) {
+    for (uint64_t e : edges) {
+      values.push_back(e);
+    }
+    for (unsigned i = 0; i < rep; i++) {
+      values.push_back(i);
+    }
+  }
+
+  check_unsigned(values);
+
+  std::vector<uint32_t> u32;
+  std::vector<uint16_t> u16;
+  std::vector<uint8_t> u8;
+  for (uint64_t v : values) {
+    u32.push_back((uint32_t)v);
+    u16.push_back((uint16_t)v);
+    u8.push_back((uint8_t)v);
+  }
+  check_unsigned(u32);
+  check_unsigned(u16);
+  check_unsigned(u8);
+}
+
+TEST_CASE("encode_array signed") {
+  std::vector<int64_t> edges = {-1,        0,         1,         -32,
+                                -33,       127,       128,       INT8_MIN,
+                                INT16_MIN, INT16_MAX, INT32_MIN, INT32_MAX,
+                                INT64_MIN, INT64_MAX};
+  std::vector<int64_t> values;
+  for (unsigned rep = 0; rep < 40; rep++) {
+    for (int64_t e : edges) {
+      values.push_back(e);
+    }
+    for (unsigned i = 0; i < rep; i++) {
+      values.push_back(-(int64_t)i);
+    }
+  }
+
+  check_signed(values);
+
+  std::vector<int32_t> s32;
+  std::vector<int16_t> s16;
+  std::vector<int8_t> s8;
+  for (int64_t v : values) {
+    s32.push_back((int32_t)v);
+    s16.push_back((int16_t)v);
+    s8.push_back((int8_t)v);
+  }
+  check_signed(s32);
+  check_signed(s16);
+  check_signed(s8);
+}
+
+TEST_CASE("encode_array block encodings") {
+  SECTION("small values collapse to fixint") {
+    std::vector<int32_t> values;
+    for (int i = -32; i < 128; i++) {
+      values.push_back(i);
+    }
+    std::vector<unsigned char> bytes = encode_vector(values);
+    CHECK(bytes.size() == 3 + values.size());
+    check_signed(values);
+  }
+
+  SECTION("an outlier only widens its own block") {
+    std::vector<uint32_t> values(64, 1);
+    values[20] = 1000;
+    std::vector<unsigned char> bytes = encode_vector(values);
+    CHECK(bytes.size() == 3 + 48 + 16 * 3);
+    check_unsigned(values);
+  }
+}
+
+TEST_CASE("encode_array float") {
+  std::vector<double> values = {0.0, -1.5, 3.25, 1e300};
+  std::vector<unsigned char> bytes = encode_vector(values);
+  REQUIRE(bytes.size() == 1 + 9 * values.size());
+
+  for (size_t i = 0; i < values.size(); i++) {
+    const unsigned char *element = bytes.data() + 1 + 9 * i;
+    CHECK(element[0] == 0xcb);
+    uint64_t bits;
+    memcpy(&bits, element + 1, 8);
+    bits = __builtin_bswap64(bits);
+    double d;
+    memcpy(&d, &bits, 8);
+    CHECK(d == values[i]);
+  }
+
+  std::vector<float> f = {1.0f, -2.0f};
+  std::vector<unsigned char> fbytes = encode_vector(f);
+  CHECK(fbytes.size() == 1 + 5 * f.size());
+  CHECK(fbytes[1] == 0xca);
+}
+
+TEST_CASE("encode_array insufficient buffer") {
+  std::vector<uint64_t> values(100, UINT64_MAX);
+  std::vector<unsigned char> out(encode_array_bound<uint64_t>(values.size()));
+  for (size_t len : {size_t(0), size_t(2), size_t(3), size_t(3 + 900 - 1)}) {
+    CHECK(encode_array(values.data(), values.size(), out.data(),
+                       out.data() + len) == nullptr);
+  }
+  CHECK(encode_array(values.data(), values.size(), out.data(),
+                     out.data() + out.size()) != nullptr);
+}
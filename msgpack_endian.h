@@ -0,0 +1,28 @@
+#ifndef MSGPACK_ENDIAN_H
+#define MSGPACK_ENDIAN_H
+
+#include <cstdint>
+#include <cstring>
+
+// Internal to the encoders, shared by msgpack_traits.h and msgpack_encode.cpp
+
+namespace msgpack {
+namespace detail {
+// Big endian stores. Assumes a little endian host, as msgpack.cpp does.
+inline uint8_t big_endian(uint8_t x) { return x; }
+inline uint16_t big_endian(uint16_t x) { return __builtin_bswap16(x); }
+inline uint32_t big_endian(uint32_t x) { return __builtin_bswap32(x); }
+inline uint64_t big_endian(uint64_t x) { return __builtin_bswap64(x); }
+
+// Writes tag followed by x in big endian, returning one past the end
+template <typename U>
+unsigned char *write_tagged(unsigned char tag, U x, unsigned char *out) {
+  x = big_endian(x);
+  out[0] = tag;
+  memcpy(out + 1, &x, sizeof(U));
+  return out + 1 + sizeof(U);
+}
+} // namespace detail
+} // namespace msgpack
+
+#endif
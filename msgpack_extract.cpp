@@ -0,0 +1,59 @@
+#include "msgpack_extract.h"
+#include "msgpack_traits.h"
+
+#include <cstring>
+
+namespace msgpack {
+
+bool extract(byte_range bytes, const path &p, std::vector<unsigned char> &out) {
+  byte_range subtree = find(bytes, p);
+  if (!subtree.start) {
+    return false;
+  }
+  out.assign(subtree.start, subtree.end);
+  return true;
+}
+
+bool gather(byte_range bytes, const std::vector<path> &paths,
+            std::vector<unsigned char> &out) {
+  std::vector<byte_range> messages;
+  messages.reserve(paths.size());
+  for (const path &p : paths) {
+    byte_range subtree = find(bytes, p);
+    if (!subtree.start) {
+      return false;
+    }
+    messages.push_back(subtree);
+  }
+  return gather(messages, out);
+}
+
+bool gather(const std::vector<byte_range> &messages,
+            std::vector<unsigned char> &out) {
+  if (messages.size() > UINT32_MAX) {
+    return false;
+  }
+
+  // Sized first so the copies go into a single allocation
+  std::vector<byte_range> spans;
+  spans.reserve(messages.size());
+  uint64_t total = detail::container_header_size(messages.size());
+  for (byte_range m : messages) {
+    const unsigned char *end = fallback::skip_next_message(m.start, m.end);
+    if (!end) {
+      return false;
+    }
+    spans.push_back({m.start, end});
+    total += end - m.start;
+  }
+
+  out.resize(total);
+  unsigned char *w = detail::write_array_header(messages.size(), out.data());
+  for (byte_range s : spans) {
+    memcpy(w, s.start, s.end - s.start);
+    w += s.end - s.start;
+  }
+  return true;
+}
+
+} // namespace msgpack
@@ -0,0 +1,29 @@
+#ifndef MSGPACK_EXTRACT_H
+#define MSGPACK_EXTRACT_H
+
+#include "msgpack.h"
+#include "msgpack_path.h"
+
+#include <vector>
+
+namespace msgpack {
+
+// Copies the message reached by p into out as a standalone buffer. The
+// subtree is located by find and copied as one span, nothing is re-encoded.
+// Returns false if p is missing or the bytes are malformed.
+bool extract(byte_range bytes, const path &p, std::vector<unsigned char> &out);
+
+// Writes to out an array holding the messages reached by each path, in
+// order. Returns false if any of them is missing.
+bool gather(byte_range bytes, const std::vector<path> &paths,
+            std::vector<unsigned char> &out);
+
+// As above for messages already located, e.g. the elements visited by
+// foreach_array. Each range must start with a well formed message, anything
+// after it is ignored.
+bool gather(const std::vector<byte_range> &messages,
+            std::vector<unsigned char> &out);
+
+} // namespace msgpack
+
+#endif
@@ -0,0 +1,70 @@
+#include "catch.hpp"
+#include "msgpack.h"
+#include "msgpack_compare.h"
+#include "msgpack_extract.h"
+#include "msgpack_test_util.h"
+
+#include <vector>
+
+using namespace msgpack;
+
+namespace {
+path kernel(uint64_t i) {
+  return {path_element::key("amdhsa.kernels"), path_element::index(i)};
+}
+} // namespace
+
+TEST_CASE("extract") {
+  byte_range doc = sample();
+
+  std::vector<unsigned char> out;
+  REQUIRE(extract(doc, kernel(3), out));
+  byte_range in_place = find(doc, kernel(3));
+  CHECK(out == std::vector<unsigned char>(in_place.start, in_place.end));
+  CHECK(is_map(range(out)));
+  CHECK(fallback::skip_next_message(out.data(), out.data() + out.size()) ==
+        out.data() + out.size());
+
+  // The copy is usable on its own, independent of the source
+  byte_range name = find(range(out), {path_element::key(".name")});
+  CHECK(name.start != nullptr);
+  CHECK(equal(name, find(doc, {path_element::key("amdhsa.kernels"),
+                               path_element::index(3),
+                               path_element::key(".name")})));
+
+  CHECK(!extract(doc, kernel(100000), out));
+  CHECK(!extract(doc, {path_element::key("missing")}, out));
+}
+
+TEST_CASE("gather") {
+  byte_range doc = sample();
+
+  std::vector<path> paths;
+  for (uint64_t i : {5, 0, 2, 0}) {
+    paths.push_back(kernel(i));
+  }
+  paths.push_back({path_element::key("amdhsa.version")});
+
+  std::vector<unsigned char> out;
+  REQUIRE(gather(doc, paths, out));
+  CHECK(out[0] == (0x90 | paths.size()));
+
+  uint64_t i = 0;
+  foreach_array(range(out), [&](byte_range e) {
+    CHECK(equal(e, find(doc, paths[i])));
+    i++;
+  });
+  CHECK(i == paths.size());
+  CHECK(fallback::skip_next_message(out.data(), out.data() + out.size()) ==
+        out.data() + out.size());
+
+  paths.push_back(kernel(100000));
+  CHECK(!gather(doc, paths, out));
+
+  std::vector<byte_range> none;
+  REQUIRE(gather(none, out));
+  CHECK(out == std::vector<unsigned char>{0x90});
+
+  std::vector<unsigned char> truncated = {0x92, 0x01};
+  CHECK(!gather(std::vector<byte_range>{range(truncated)}, out));
+}
@@ -0,0 +1,245 @@
+#ifndef MSGPACK_FIELDS_H
+#define MSGPACK_FIELDS_H
+
+#include "msgpack.h"
+#include "msgpack_decode.h"
+#include "msgpack_traits.h"
+
+#include <cstdint>
+#include <cstring>
+
+// Binds the members of a struct to the keys of a map:
+//
+//   struct kernel_info {
+//     std::string name;
+//     uint32_t sgpr_count;
+//   };
+//   MSGPACK_FIELDS(kernel_info, name, sgpr_count)
+//
+// after which msgpack::decode(bytes, info) fills a kernel_info from a map in
+// one pass, and msgpack::encode(info) writes it as a map keyed by the member
+// names. Keys are hashed and dispatched through a switch over hashes of
+// the member names computed at compile time, then confirmed with memcmp.
+// Members are decoded with the matching msgpack::decode overload so may be
+// integers, bool, std::string, byte_range, vectors or other bound structs.
+// Unknown keys are skipped and missing keys leave the member unchanged.
+//
+// Keys that are the member name with a common prefix, like ".name", use
+// MSGPACK_FIELDS_WITH_PREFIX(kernel_info, ".", name, sgpr_count).
+//
+// Keys that can't be bound this way are handled by defining
+// msgpack_decode_field(T &, byte_range name, byte_range value) by hand. value
+// runs from the start of the value to the end of the map; return one past the
+// value, skipping it if the key is not wanted, or nullptr on failure.
+//
+// Use at namespace scope in the namespace of the struct. Up to 32 members.
+// Two names with the same hash fail to compile as duplicate case labels.
+
+namespace msgpack {
+namespace detail {
+// FNV-1a
+constexpr uint64_t field_hash(const char *name,
+                              uint64_t h = UINT64_C(14695981039346656037)) {
+  return *name ? field_hash(name + 1, (h ^ (unsigned char)*name) *
+                                          UINT64_C(1099511628211))
+               : h;
+}
+
+inline uint64_t field_hash(byte_range name) {
+  uint64_t h = UINT64_C(14695981039346656037);
+  for (const unsigned char *p = name.start; p != name.end; p++) {
+    h = (h ^ *p) * UINT64_C(1099511628211);
+  }
+  return h;
+}
+
+template <size_t L>
+bool field_name_is(const char (&expect)[L], byte_range name) {
+  return (size_t)(name.end - name.start) == L - 1 &&
+         memcmp(name.start, expect, L - 1) == 0;
+}
+} // namespace detail
+
+// Decodes a map into a struct bound with MSGPACK_FIELDS. Returns one past the
+// map, or nullptr if it is not a map, is malformed, or a bound member fails
+// to decode.
+template <typename T>
+auto decode(byte_range bytes, T &out)
+    -> decltype(msgpack_decode_field(out, byte_range(), byte_range()),
+                (const unsigned char *)nullptr) {
+  return decode_map(
+      bytes, [&](byte_range key, byte_range value) -> const unsigned char * {
+        byte_range name;
+        return decode_string(key, name)
+                   ? msgpack_decode_field(out, name, value)
+                   : fallback::skip_next_message(value.start, value.end);
+      });
+}
+
+namespace detail {
+// Visitors passed to msgpack_visit_fields
+struct field_counter {
+  uint64_t count = 0;
+  template <size_t L, typename M>
+  void operator()(const char (&)[L], const M &) {
+    count++;
+  }
+};
+
+struct field_sizer {
+  uint64_t bytes = 0;
+  template <size_t L, typename M>
+  void operator()(const char (&)[L], const M &member) {
+    bytes = add_sizes(bytes, string_size(L - 1));
+    bytes = add_sizes(bytes, msgpack_traits<M>::size(member));
+  }
+};
+
+struct field_writer {
+  unsigned char *out;
+  template <size_t L, typename M>
+  void operator()(const char (&name)[L], const M &member) {
+    out = write_string(name, L - 1, out);
+    out = msgpack_traits<M>::write(member, out);
+  }
+};
+} // namespace detail
+
+template <typename T>
+struct msgpack_traits<
+    T, typename detail::make_void<decltype(msgpack_visit_fields(
+           std::declval<const T &>(),
+           std::declval<detail::field_counter &>()))>::type> {
+  static uint64_t count(const T &x) {
+    detail::field_counter c;
+    msgpack_visit_fields(x, c);
+    return c.count;
+  }
+
+  static uint64_t size(const T &x) {
+    detail::field_sizer s;
+    msgpack_visit_fields(x, s);
+    return detail::add_sizes(detail::container_header_size(count(x)), s.bytes);
+  }
+
+  static unsigned char *write(const T &x, unsigned char *out) {
+    detail::field_writer w = {detail::write_map_header(count(x), out)};
+    msgpack_visit_fields(x, w);
+    return w.out;
+  }
+};
+} // namespace msgpack
+
+#define MSGPACK_FIELDS(T, ...) MSGPACK_FIELDS_WITH_PREFIX(T, "", __VA_ARGS__)
+
+#define MSGPACK_FIELDS_WITH_PREFIX(T, PREFIX, ...)                             \
+  inline const unsigned char *msgpack_decode_field(                            \
+      T &out, ::msgpack::byte_range name, ::msgpack::byte_range value) {       \
+    using ::msgpack::decode;                                                   \
+    switch (::msgpack::detail::field_hash(name)) {                             \
+      MSGPACK_FIELDS_FOR_EACH(MSGPACK_FIELDS_DECODE_CASE, PREFIX, __VA_ARGS__) \
+    default:                                                                   \
+      break;                                                                   \
+    }                                                                          \
+    return ::msgpack::fallback::skip_next_message(value.start, value.end);     \
+  }                                                                            \
+  template <typename F> void msgpack_visit_fields(const T &in, F &visit) {     \
+    MSGPACK_FIELDS_FOR_EACH(MSGPACK_FIELDS_VISIT, PREFIX, __VA_ARGS__)         \
+  }
+
+#define MSGPACK_FIELDS_DECODE_CASE(PREFIX, f)                                  \
+  case ::msgpack::detail::field_hash(PREFIX #f):                               \
+    if (::msgpack::detail::field_name_is(PREFIX #f, name)) {                   \
+      return decode(value, out.f);                                             \
+    }                                                                          \
+    break;
+
+#define MSGPACK_FIELDS_VISIT(PREFIX, f) visit(PREFIX #f, in.f);
+
+// Applies M(C, x) to each x in the remaining arguments
+#define MSGPACK_FIELDS_FOR_EACH(M, C, ...)                                     \
+  MSGPACK_FIELDS_PICK(                                                         \
+      __VA_ARGS__, MSGPACK_FIELDS_FE_32, MSGPACK_FIELDS_FE_31,                 \
+      MSGPACK_FIELDS_FE_30, MSGPACK_FIELDS_FE_29, MSGPACK_FIELDS_FE_28,        \
+      MSGPACK_FIELDS_FE_27, MSGPACK_FIELDS_FE_26, MSGPACK_FIELDS_FE_25,        \
+      MSGPACK_FIELDS_FE_24, MSGPACK_FIELDS_FE_23, MSGPACK_FIELDS_FE_22,        \
+      MSGPACK_FIELDS_FE_21, MSGPACK_FIELDS_FE_20, MSGPACK_FIELDS_FE_19,        \
+      MSGPACK_FIELDS_FE_18, MSGPACK_FIELDS_FE_17, MSGPACK_FIELDS_FE_16,        \
+      MSGPACK_FIELDS_FE_15, MSGPACK_FIELDS_FE_14, MSGPACK_FIELDS_FE_13,        \
+      MSGPACK_FIELDS_FE_12, MSGPACK_FIELDS_FE_11, MSGPACK_FIELDS_FE_10,        \
+      MSGPACK_FIELDS_FE_9, MSGPACK_FIELDS_FE_8, MSGPACK_FIELDS_FE_7,           \
+      MSGPACK_FIELDS_FE_6, MSGPACK_FIELDS_FE_5, MSGPACK_FIELDS_FE_4,           \
+      MSGPACK_FIELDS_FE_3, MSGPACK_FIELDS_FE_2, MSGPACK_FIELDS_FE_1)           \
+  (M, C, __VA_ARGS__)
+
+#define MSGPACK_FIELDS_PICK(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, \
+                            _13, _14, _15, _16, _17, _18, _19, _20, _21, _22,  \
+                            _23, _24, _25, _26, _27, _28, _29, _30, _31, _32,  \
+                            N, ...)                                            \
+  N
+
+#define MSGPACK_FIELDS_FE_1(M, C, x) M(C, x)
+#define MSGPACK_FIELDS_FE_2(M, C, x, ...)                                      \
+  M(C, x) MSGPACK_FIELDS_FE_1(M, C, __VA_ARGS__)
+#define MSGPACK_FIELDS_FE_3(M, C, x, ...)                                      \
+  M(C, x) MSGPACK_FIELDS_FE_2(M, C, __VA_ARGS__)
+#define MSGPACK_FIELDS_FE_4(M, C, x, ...)                                      \
+  M(C, x) MSGPACK_FIELDS_FE_3(M, C, __VA_ARGS__)
+#define MSGPACK_FIELDS_FE_5(M, C, x, ...)                                      \
+  M(C, x) MSGPACK_FIELDS_FE_4(M, C, __VA_ARGS__)
+#define MSGPACK_FIELDS_FE_6(M, C, x, ...)                                      \
+  M(C, x) MSGPACK_FIELDS_FE_5(M, C, __VA_ARGS__)
+#define MSGPACK_FIELDS_FE_7(M, C, x, ...)                                      \
+  M(C, x) MSGPACK_FIELDS_FE_6(M, C, __VA_ARGS__)
+#define MSGPACK_FIELDS_FE_8(M, C, x, ...)                                      \
+  M(C, x) MSGPACK_FIELDS_FE_7(M, C, __VA_ARGS__)
+#define MSGPACK_FIELDS_FE_9(M, C, x, ...)                                      \
+  M(C, x) MSGPACK_FIELDS_FE_8(M, C, __VA_ARGS__)
+#define MSGPACK_FIELDS_FE_10(M, C, x, ...)                                     \
+  M(C, x) MSGPACK_FIELDS_FE_9(M, C, __VA_ARGS__)
+#define MSGPACK_FIELDS_FE_11(M, C, x, ...)                                     \
+  M(C, x) MSGPACK_FIELDS_FE_10(M, C, __VA_ARGS__)
+#define MSGPACK_FIELDS_FE_12(M, C, x, ...)                                     \
+  M(C, x) MSGPACK_FIELDS_FE_11(M, C, __VA_ARGS__)
+#define MSGPACK_FIELDS_FE_13(M, C, x, ...)                                     \
+  M(C, x) MSGPACK_FIELDS_FE_12(M, C, __VA_ARGS__)
+#define MSGPACK_FIELDS_FE_14(M, C, x, ...)                                     \
+  M(C, x) MSGPACK_FIELDS_FE_13(M, C, __VA_ARGS__)
+#define MSGPACK_FIELDS_FE_15(M, C, x, ...)                                     \
+  M(C, x) MSGPACK_FIELDS_FE_14(M, C, __VA_ARGS__)
+#define MSGPACK_FIELDS_FE_16(M, C, x, ...)                                     \
+  M(C, x) MSGPACK_FIELDS_FE_15(M, C, __VA_ARGS__)
+#define MSGPACK_FIELDS_FE_17(M, C, x, ...)                                     \
+  M(C, x) MSGPACK_FIELDS_FE_16(M, C, __VA_ARGS__)
+#define MSGPACK_FIELDS_FE_18(M, C, x, ...)                                     \
+  M(C, x) MSGPACK_FIELDS_FE_17(M, C, __VA_ARGS__)
+#define MSGPACK_FIELDS_FE_19(M, C, x, ...)                                     \
+  M(C, x) MSGPACK_FIELDS_FE_18(M, C, __VA_ARGS__)
+#define MSGPACK_FIELDS_FE_20(M, C, x, ...)                                     \
+  M(C, x) MSGPACK_FIELDS_FE_19(M, C, __VA_ARGS__)
+#define MSGPACK_FIELDS_FE_21(M, C, x, ...)                                     \
+  M(C, x) MSGPACK_FIELDS_FE_20(M, C, __VA_ARGS__)
+#define MSGPACK_FIELDS_FE_22(M, C, x, ...)                                     \
+  M(C, x) MSGPACK_FIELDS_FE_21(M, C, __VA_ARGS__)
+#define MSGPACK_FIELDS_FE_23(M, C, x, ...)                                     \
+  M(C, x) MSGPACK_FIELDS_FE_22(M, C, __VA_ARGS__)
+#define MSGPACK_FIELDS_FE_24(M, C, x, ...)                                     \
+  M(C, x) MSGPACK_FIELDS_FE_23(M, C, __VA_ARGS__)
+#define MSGPACK_FIELDS_FE_25(M, C, x, ...)                                     \
+  M(C, x) MSGPACK_FIELDS_FE_24(M, C, __VA_ARGS__)
+#define MSGPACK_FIELDS_FE_26(M, C, x, ...)                                     \
+  M(C, x) MSGPACK_FIELDS_FE_25(M, C, __VA_ARGS__)
+#define MSGPACK_FIELDS_FE_27(M, C, x, ...)                                     \
+  M(C, x) MSGPACK_FIELDS_FE_26(M, C, __VA_ARGS__)
+#define MSGPACK_FIELDS_FE_28(M, C, x, ...)                                     \
+  M(C, x) MSGPACK_FIELDS_FE_27(M, C, __VA_ARGS__)
+#define MSGPACK_FIELDS_FE_29(M, C, x, ...)                                     \
+  M(C, x) MSGPACK_FIELDS_FE_28(M, C, __VA_ARGS__)
+#define MSGPACK_FIELDS_FE_30(M, C, x, ...)                                     \
+  M(C, x) MSGPACK_FIELDS_FE_29(M, C, __VA_ARGS__)
+#define MSGPACK_FIELDS_FE_31(M, C, x, ...)                                     \
+  M(C, x) MSGPACK_FIELDS_FE_30(M, C, __VA_ARGS__)
+#define MSGPACK_FIELDS_FE_32(M, C, x, ...)                                     \
+  M(C, x) MSGPACK_FIELDS_FE_31(M, C, __VA_ARGS__)
+
+#endif
@@ -0,0 +1,120 @@
+#include "catch.hpp"
+#include "manykernels_decoder.h"
+#include "msgpack.h"
+#include "msgpack_fields.h"
+#include "msgpack_test_util.h"
+
+#include <string>
+#include <vector>
+
+namespace example {
+struct arg_info {
+  std::string name;
+  uint32_t offset = 0;
+  uint32_t size = 0;
+};
+MSGPACK_FIELDS_WITH_PREFIX(arg_info, ".", name, offset, size)
+
+struct kernel_info {
+  std::string name;
+  std::string symbol;
+  uint16_t sgpr_count = 0;
+  uint16_t vgpr_count = 0;
+  uint64_t kernarg_segment_size = 0;
+  std::vector<uint32_t> language_version;
+  std::vector<arg_info> args;
+};
+MSGPACK_FIELDS_WITH_PREFIX(kernel_info, ".", name, symbol, sgpr_count,
+                           vgpr_count, kernarg_segment_size, language_version,
+                           args)
+
+struct metadata {
+  std::vector<kernel_info> kernels;
+};
+
+// Keys that are not identifiers are bound by hand
+inline const unsigned char *msgpack_decode_field(metadata &out,
+                                                 msgpack::byte_range name,
+                                                 msgpack::byte_range value) {
+  if (msgpack::detail::field_name_is("amdhsa.kernels", name)) {
+    return msgpack::decode(value, out.kernels);
+  }
+  return msgpack::fallback::skip_next_message(value.start, value.end);
+}
+
+struct point {
+  int8_t x = 0;
+  bool visible = false;
+  msgpack::byte_range extra = {nullptr, nullptr};
+};
+MSGPACK_FIELDS(point, x, visible, extra)
+} // namespace example
+
+using namespace msgpack;
+
+static_assert(detail::field_hash("") == UINT64_C(14695981039346656037), "");
+static_assert(detail::field_hash("a") != detail::field_hash("b"), "");
+
+TEST_CASE("MSGPACK_FIELDS") {
+  SECTION("field hash") {
+    const unsigned char name[] = {'.', 'n', 'a', 'm', 'e'};
+    CHECK(detail::field_hash(byte_range{name, name + 5}) ==
+          detail::field_hash(".name"));
+  }
+
+  SECTION("manykernels") {
+    example::metadata md;
+    const unsigned char *end = decode(sample(), md);
+    CHECK(end == fallback::skip_next_message(sample().start, sample().end));
+
+    // Cross check against the schema generated decoder
+    manykernels::kernel_metadata expect;
+    REQUIRE(decode(sample(), expect));
+    REQUIRE(md.kernels.size() == expect.amdhsa_kernels.size());
+    bool ok = true;
+    for (size_t i = 0; i < md.kernels.size(); i++) {
+      const example::kernel_info &k = md.kernels[i];
+      const manykernels::kernel_metadata_amdhsa_kernels &e =
+          expect.amdhsa_kernels[i];
+      ok &= k.name == e.name;
+      ok &= k.symbol == e.symbol;
+      ok &= k.sgpr_count == e.sgpr_count;
+      ok &= k.vgpr_count == e.vgpr_count;
+      ok &= k.kernarg_segment_size == e.kernarg_segment_size;
+      ok &= k.language_version.size() == e.language_version.size();
+      ok &= k.args.size() == e.args.size();
+      for (size_t a = 0; ok && a < k.args.size(); a++) {
+        ok &= k.args[a].name == e.args[a].name;
+        ok &= k.args[a].offset == e.args[a].offset;
+        ok &= k.args[a].size == e.args[a].size;
+      }
+    }
+    CHECK(ok);
+  }
+
+  SECTION("unknown and missing keys") {
+    // {"w": 1, "visible": true, "extra": [1, 2]}
+    std::vector<unsigned char> bytes = {
+        0x83, 0xa1, 'w',  0x01, 0xa7, 'v',  'i',  's',  'i',  'b',
+        'l',  'e',  0xc3, 0xa5, 'e',  'x',  't',  'r',  'a',  0x92,
+        0x01, 0x02};
+    example::point p;
+    p.x = 7;
+    CHECK(decode(range(bytes), p) == bytes.data() + bytes.size());
+    CHECK(p.x == 7);
+    CHECK(p.visible);
+    CHECK(p.extra.start == bytes.data() + 19);
+    CHECK(p.extra.end == bytes.data() + bytes.size());
+  }
+
+  SECTION("values that do not fit fail") {
+    // {"x": 200}, {"x": "a"}, [1]
+    std::vector<unsigned char> wide = {0x81, 0xa1, 'x', 0xcc, 200};
+    std::vector<unsigned char> text = {0x81, 0xa1, 'x', 0xa1, 'a'};
+    std::vector<unsigned char> array = {0x91, 0x01};
+    example::point p;
+    CHECK(decode(range(wide), p) == nullptr);
+    CHECK(decode(range(text), p) == nullptr);
+    CHECK(decode(range(array), p) == nullptr);
+  }
+}
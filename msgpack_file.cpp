@@ -0,0 +1,118 @@
+#include "msgpack_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+uintptr_t page_size() {
+  static const uintptr_t size = sysconf(_SC_PAGESIZE);
+  return size;
+}
+
+// madvise wants page aligned addresses
+const unsigned char *page_down(const unsigned char *p) {
+  uintptr_t x = reinterpret_cast<uintptr_t>(p);
+  return reinterpret_cast<const unsigned char *>(x & ~(page_size() - 1));
+}
+
+void advise(const unsigned char *from, const unsigned char *to, int advice) {
+  from = page_down(from);
+  if (from < to) {
+    madvise(const_cast<unsigned char *>(from), to - from, advice);
+  }
+}
+} // namespace
+
+namespace msgpack {
+
+const uint64_t message_stream::default_window;
+
+bool mapped_file::open(const char *path) {
+  close();
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    ::close(fd);
+    return false;
+  }
+
+  if (st.st_size == 0) {
+    ::close(fd);
+    return true;
+  }
+
+  void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping holds its own reference to the file
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+
+  madvise(map, st.st_size, MADV_SEQUENTIAL);
+  start = static_cast<unsigned char *>(map);
+  size = st.st_size;
+  return true;
+}
+
+void mapped_file::close() {
+  if (start) {
+    munmap(start, size);
+  }
+  start = nullptr;
+  size = 0;
+}
+
+message_stream::message_stream(const mapped_file &file, uint64_t window)
+    : base(file.bytes().start), position(file.bytes().start),
+      end(file.bytes().end), window(window), requested(base), released(base) {
+}
+
+void message_stream::advise() {
+  // A single message larger than the window can carry the parse past the
+  // requested region
+  if (requested < position) {
+    requested = position;
+  }
+
+  // Request the next window once the parse is half way through this one
+  if ((uint64_t)(requested - position) < window / 2 && requested != end) {
+    const unsigned char *to =
+        ((uint64_t)(end - position) > window) ? position + window : end;
+    ::advise(requested, to, MADV_WILLNEED);
+    requested = to;
+  }
+
+  // Drop whole pages more than a window behind the parse position
+  if ((uint64_t)(position - released) > 2 * window) {
+    const unsigned char *to = page_down(position - window);
+    if (released < to) {
+      ::advise(released, to, MADV_DONTNEED);
+      released = to;
+    }
+  }
+}
+
+bool message_stream::next(byte_range *message) {
+  if (position == end) {
+    return false;
+  }
+
+  advise();
+
+  const unsigned char *next = fallback::skip_next_message(position, end);
+  if (!next) {
+    return false;
+  }
+
+  *message = {position, next};
+  position = next;
+  return true;
+}
+
+} // namespace msgpack
@@ -0,0 +1,63 @@
+#ifndef MSGPACK_FILE_H
+#define MSGPACK_FILE_H
+
+#include "msgpack.h"
+
+#include <cstdint>
+
+namespace msgpack {
+
+// Read only memory map of a whole file. Files larger than physical memory are
+// fine, pages are read on demand and may be dropped again under pressure.
+class mapped_file {
+public:
+  mapped_file() {}
+  ~mapped_file() { close(); }
+  mapped_file(const mapped_file &) = delete;
+  mapped_file &operator=(const mapped_file &) = delete;
+
+  // Returns false if the file cannot be opened or mapped. An empty file maps
+  // to an empty range.
+  bool open(const char *path);
+  void close();
+
+  byte_range bytes() const { return {start, start + size}; }
+
+private:
+  unsigned char *start = nullptr;
+  uint64_t size = 0;
+};
+
+// Presents consecutive top level messages of a mapped file as byte_ranges.
+// Pages within window bytes ahead of the parse position are requested before
+// they are needed and pages more than window bytes behind are released, so
+// resident memory stays around two windows for an arbitrarily large file.
+// Ranges returned earlier remain valid, they are paged back in if touched.
+class message_stream {
+public:
+  static const uint64_t default_window = UINT64_C(64) << 20;
+
+  message_stream(const mapped_file &file, uint64_t window = default_window);
+
+  // Sets *message to the next message and returns true, or returns false at
+  // the end of the file or on a malformed or truncated message.
+  bool next(byte_range *message);
+
+  // True once every byte of the file has been returned as a message
+  bool at_end() const { return position == end; }
+  const unsigned char *current() const { return position; }
+
+private:
+  void advise();
+
+  const unsigned char *base;
+  const unsigned char *position;
+  const unsigned char *end;
+  uint64_t window;
+  const unsigned char *requested;
+  const unsigned char *released;
+};
+
+} // namespace msgpack
+
+#endif
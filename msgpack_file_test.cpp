@@ -0,0 +1,105 @@
+#include "catch.hpp"
+#include "msgpack.h"
+#include "msgpack_encode.h"
+#include "msgpack_file.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace msgpack;
+
+namespace {
+struct temp_file {
+  temp_file(const std::vector<unsigned char> &bytes) {
+    char tmpl[] = "/tmp/msgpack_file_XXXXXX";
+    int fd = mkstemp(tmpl);
+    REQUIRE(fd >= 0);
+    path = tmpl;
+    size_t written = 0;
+    while (written < bytes.size()) {
+      ssize_t r = write(fd, bytes.data() + written, bytes.size() - written);
+      REQUIRE(r > 0);
+      written += r;
+    }
+    close(fd);
+  }
+  ~temp_file() { unlink(path.c_str()); }
+  std::string path;
+};
+} // namespace
+
+TEST_CASE("mapped_file") {
+  SECTION("missing file") {
+    mapped_file file;
+    CHECK(!file.open("/nonexistent/msgpack/file"));
+    CHECK(file.bytes().start == file.bytes().end);
+  }
+
+  SECTION("empty file") {
+    temp_file tmp({});
+    mapped_file file;
+    CHECK(file.open(tmp.path.c_str()));
+    message_stream stream(file);
+    byte_range message;
+    CHECK(!stream.next(&message));
+    CHECK(stream.at_end());
+  }
+}
+
+TEST_CASE("message_stream") {
+  // Concatenation of arrays of varying length, spanning many pages
+  std::vector<unsigned char> bytes;
+  std::vector<uint64_t> offsets;
+  for (uint32_t i = 0; i < 2000; i++) {
+    std::vector<uint32_t> values(i % 97, i);
+    std::vector<unsigned char> tmp(encode_array_bound<uint32_t>(values.size()));
+    unsigned char *r = encode_array(values.data(), values.size(), tmp.data(),
+                                    tmp.data() + tmp.size());
+    REQUIRE(r);
+    offsets.push_back(bytes.size());
+    bytes.insert(bytes.end(), tmp.data(), r);
+  }
+  offsets.push_back(bytes.size());
+
+  temp_file tmp(bytes);
+  mapped_file file;
+  REQUIRE(file.open(tmp.path.c_str()));
+  REQUIRE((uint64_t)(file.bytes().end - file.bytes().start) == bytes.size());
+
+  for (uint64_t window : {UINT64_C(1), UINT64_C(4096), UINT64_C(20000),
+                          message_stream::default_window}) {
+    message_stream stream(file, window);
+    const unsigned char *base = file.bytes().start;
+
+    uint64_t count = 0;
+    bool ok = true;
+    byte_range message;
+    while (stream.next(&message)) {
+      ok &= (message.start == base + offsets[count]);
+      ok &= (message.end == base + offsets[count + 1]);
+      count++;
+    }
+    CHECK(ok);
+    CHECK(count == offsets.size() - 1);
+    CHECK(stream.at_end());
+  }
+
+  SECTION("truncated") {
+    bytes.push_back(0x92);
+    temp_file trunc(bytes);
+    mapped_file truncated;
+    REQUIRE(truncated.open(trunc.path.c_str()));
+    message_stream stream(truncated, 4096);
+    byte_range message;
+    uint64_t count = 0;
+    while (stream.next(&message)) {
+      count++;
+    }
+    CHECK(count == offsets.size() - 1);
+    CHECK(!stream.at_end());
+  }
+}
@@ -0,0 +1,222 @@
+#include "msgpack_filter.h"
+#include "msgpack_compare.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace {
+using msgpack::byte_range;
+using msgpack::predicate;
+using msgpack::token;
+
+bool path_equal(const msgpack::path &a, const msgpack::path &b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); i++) {
+    if (a[i].is_index() != b[i].is_index() ||
+        a[i].position != b[i].position ||
+        a[i].encoded_key != b[i].encoded_key) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool is_number(const token &t) {
+  return t.kind == token::unsigned_integer ||
+         t.kind == token::negative_integer || t.kind == token::floating;
+}
+
+double as_double(const token &t) {
+  if (t.kind == token::unsigned_integer) {
+    return (double)t.value;
+  }
+  if (t.kind == token::negative_integer) {
+    return (double)(int64_t)t.value;
+  }
+  double d;
+  memcpy(&d, &t.value, 8);
+  return d;
+}
+
+// Three way comparison of two numbers. Integers compare exactly, anything
+// involving a float through double. unordered is set for NaN.
+int compare_numbers(const token &a, const token &b, bool &unordered) {
+  unordered = false;
+  if (a.kind != token::floating && b.kind != token::floating) {
+    if (a.kind != b.kind) {
+      return (a.kind == token::negative_integer) ? -1 : 1;
+    }
+    if (a.kind == token::negative_integer) {
+      int64_t x = (int64_t)a.value, y = (int64_t)b.value;
+      return (x < y) ? -1 : (x > y);
+    }
+    return (a.value < b.value) ? -1 : (a.value > b.value);
+  }
+
+  double x = as_double(a), y = as_double(b);
+  if (x != x || y != y) {
+    unordered = true;
+    return 0;
+  }
+  return (x < y) ? -1 : (x > y);
+}
+
+int compare_strings(const token &a, const token &b) {
+  const size_t N = a.payload.end - a.payload.start;
+  const size_t M = b.payload.end - b.payload.start;
+  int c = memcmp(a.payload.start, b.payload.start, std::min(N, M));
+  return (c != 0) ? c : (N < M) ? -1 : (N > M);
+}
+
+bool holds(predicate::op o, int c) {
+  switch (o) {
+  case predicate::eq:
+    return c == 0;
+  case predicate::ne:
+    return c != 0;
+  case predicate::lt:
+    return c < 0;
+  case predicate::le:
+    return c <= 0;
+  case predicate::gt:
+    return c > 0;
+  case predicate::ge:
+    return c >= 0;
+  }
+  return false;
+}
+
+bool evaluate(predicate::op o, byte_range value, byte_range operand) {
+  token a, b;
+  if (!msgpack::read_token(value, a) || !msgpack::read_token(operand, b)) {
+    return false;
+  }
+
+  if (is_number(a) && is_number(b)) {
+    bool unordered;
+    int c = compare_numbers(a, b, unordered);
+    return unordered ? (o == predicate::ne) : holds(o, c);
+  }
+  if (a.kind == token::string && b.kind == token::string) {
+    return holds(o, compare_strings(a, b));
+  }
+  if (o == predicate::eq || o == predicate::ne) {
+    return msgpack::equal(value, operand) == (o == predicate::eq);
+  }
+  return false;
+}
+} // namespace
+
+namespace msgpack {
+
+predicate::group &predicate::at(const path &p) {
+  for (group &g : groups) {
+    if (path_equal(g.where, p)) {
+      return g;
+    }
+  }
+  groups.push_back({p, path(p.begin() + (p.empty() ? 0 : 1), p.end()), {}});
+  return groups.back();
+}
+
+predicate &predicate::add(const path &p, op o,
+                          std::vector<unsigned char> operand) {
+  at(p).conditions.push_back({false, o, std::move(operand)});
+  condition_count++;
+  return *this;
+}
+
+predicate &predicate::where(const path &p, op o, const char *value) {
+  return add(p, o, encode(std::string(value)));
+}
+
+predicate &predicate::exists(const path &p) {
+  at(p).conditions.push_back({true, eq, {}});
+  condition_count++;
+  return *this;
+}
+
+bool predicate::holds_all(const group &g, byte_range value) {
+  if (!value.start) {
+    return false;
+  }
+  for (const condition &c : g.conditions) {
+    if (!c.exists &&
+        !evaluate(c.o, value,
+                  {c.operand.data(), c.operand.data() + c.operand.size()})) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool predicate::matches(byte_range message) const {
+  for (const group &g : groups) {
+    if (!holds_all(g, find(message, g.where))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+const unsigned char *predicate::match_next(byte_range bytes,
+                                           bool &matched) const {
+  // Groups found so far are tracked in a bitmask
+  token t;
+  const unsigned char *q = read_token(bytes, t);
+  if (!q || (t.kind != token::map && t.kind != token::array) ||
+      groups.size() > 64) {
+    const unsigned char *end =
+        fallback::skip_next_message(bytes.start, bytes.end);
+    matched = end && matches({bytes.start, end});
+    return end;
+  }
+
+  const bool is_map = t.kind == token::map;
+  uint64_t found = 0;
+  matched = true;
+  for (uint64_t i = 0; i < t.value; i++) {
+    const unsigned char *key_end =
+        is_map ? fallback::skip_next_message(q, bytes.end) : q;
+    const unsigned char *end =
+        key_end ? fallback::skip_next_message(key_end, bytes.end) : nullptr;
+    if (!end) {
+      return nullptr;
+    }
+
+    // As find, the first matching key is the one used
+    for (size_t g = 0; g < groups.size() && matched; g++) {
+      const uint64_t bit = UINT64_C(1) << g;
+      const path &where = groups[g].where;
+      if ((found & bit) || where.empty() ||
+          where[0].is_index() == is_map) {
+        continue;
+      }
+      const path_element &head = where[0];
+      const bool hit =
+          is_map ? equal({q, key_end}, {head.encoded_key.data(),
+                                        head.encoded_key.data() +
+                                            head.encoded_key.size()})
+                 : head.position == i;
+      if (hit) {
+        found |= bit;
+        matched = holds_all(groups[g], find({key_end, end}, groups[g].tail));
+      }
+    }
+    q = end;
+  }
+
+  // Conditions on the whole message, and paths that were never reached
+  for (size_t g = 0; g < groups.size() && matched; g++) {
+    if (!(found & (UINT64_C(1) << g))) {
+      matched = groups[g].where.empty() &&
+                holds_all(groups[g], {bytes.start, q});
+    }
+  }
+  return q;
+}
+
+} // namespace msgpack
@@ -0,0 +1,118 @@
+#ifndef MSGPACK_FILTER_H
+#define MSGPACK_FILTER_H
+
+#include "msgpack.h"
+#include "msgpack_decode.h"
+#include "msgpack_path.h"
+#include "msgpack_traits.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace msgpack {
+
+// A conjunction of conditions on the values at paths within a message.
+// Evaluating it follows each path with find, which steps over unrelated
+// subtrees with the skip functions and never decodes them, and stops at the
+// first condition that fails. Conditions on the same path share one lookup.
+//
+// Numbers compare by value across integer widths, signedness and float.
+// Strings compare bytewise. Values of other kinds, or of a kind the operand
+// can't be compared with, only satisfy eq / ne through equal. A missing
+// path fails every condition on it, ne included.
+class predicate {
+public:
+  enum op { eq, ne, lt, le, gt, ge };
+
+  // The operand is anything msgpack_traits can encode
+  template <typename T>
+  predicate &where(const path &p, op o, const T &value) {
+    return add(p, o, encode(value));
+  }
+  predicate &where(const path &p, op o, const char *value);
+
+  // Satisfied if the path is present, whatever its value
+  predicate &exists(const path &p);
+
+  size_t size() const { return condition_count; }
+
+  // True if every condition holds for the message at message.start
+  bool matches(byte_range message) const;
+
+  // Sets matched as matches would and returns the end of the message at
+  // bytes.start, or nullptr if it is malformed. One walk over the top level
+  // of a map or array finds both, descending only into the entries that
+  // start a condition's path, where matches followed by a skip would walk
+  // the message twice.
+  const unsigned char *match_next(byte_range bytes, bool &matched) const;
+
+private:
+  struct condition {
+    bool exists;
+    op o;
+    std::vector<unsigned char> operand;
+  };
+  struct group {
+    path where;
+    // where without its first element
+    path tail;
+    std::vector<condition> conditions;
+  };
+
+  predicate &add(const path &p, op o, std::vector<unsigned char> operand);
+  group &at(const path &p);
+  static bool holds_all(const group &g, byte_range value);
+
+  std::vector<group> groups;
+  size_t condition_count = 0;
+};
+
+// Calls emit(message) for each of the back to back top level messages in
+// bytes that satisfies pred. Returns one past the last message scanned,
+// bytes.end unless the range ends in a malformed or truncated message.
+template <typename F>
+const unsigned char *filter_messages(byte_range bytes, const predicate &pred,
+                                     F emit) {
+  const unsigned char *p = bytes.start;
+  while (p != bytes.end) {
+    bool matched;
+    const unsigned char *next = pred.match_next({p, bytes.end}, matched);
+    if (!next) {
+      break;
+    }
+    if (matched) {
+      emit(byte_range{p, next});
+    }
+    p = next;
+  }
+  return p;
+}
+
+// Calls emit(element) for each element of the array at bytes.start that
+// satisfies pred, e.g. the kernels of amdhsa.kernels. Returns false if bytes
+// does not start with a well formed array, after emitting any matches ahead
+// of the malformed element.
+template <typename F>
+bool filter_elements(byte_range bytes, const predicate &pred, F emit) {
+  token t;
+  const unsigned char *p = read_token(bytes, t);
+  if (!p || t.kind != token::array) {
+    return false;
+  }
+  for (uint64_t i = 0; i < t.value; i++) {
+    bool matched;
+    const unsigned char *next = pred.match_next({p, bytes.end}, matched);
+    if (!next) {
+      return false;
+    }
+    if (matched) {
+      emit(byte_range{p, next});
+    }
+    p = next;
+  }
+  return true;
+}
+
+} // namespace msgpack
+
+#endif
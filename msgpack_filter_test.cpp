@@ -0,0 +1,178 @@
+#include "catch.hpp"
+#include "msgpack.h"
+#include "msgpack_decode.h"
+#include "msgpack_filter.h"
+#include "msgpack_test_util.h"
+
+#include <string>
+#include <vector>
+
+using namespace msgpack;
+
+namespace {
+path field(const char *name) { return {path_element::key(name)}; }
+
+uint64_t unsigned_field(byte_range kernel, const char *name) {
+  uint64_t x = 0;
+  decode(find(kernel, field(name)), x);
+  return x;
+}
+} // namespace
+
+TEST_CASE("filter kernels") {
+  byte_range kernels = kernel_array();
+  REQUIRE(kernels.start != nullptr);
+
+  predicate wide;
+  wide.where(field(".kernarg_segment_size"), predicate::gt, 256);
+
+  uint64_t expect = 0;
+  uint64_t total = 0;
+  foreach_array(kernels, [&](byte_range kernel) {
+    expect += unsigned_field(kernel, ".kernarg_segment_size") > 256;
+    total++;
+  });
+
+  uint64_t found = 0;
+  CHECK(filter_elements(kernels, wide, [&](byte_range kernel) {
+    CHECK(unsigned_field(kernel, ".kernarg_segment_size") > 256);
+    found++;
+  }));
+  CHECK(found == expect);
+
+  // Combined conditions, a range on one path shares its lookup
+  predicate band;
+  band.where(field(".sgpr_count"), predicate::ge, 16)
+      .where(field(".sgpr_count"), predicate::lt, 64.5)
+      .exists(field(".name"));
+  CHECK(band.size() == 3);
+  found = 0;
+  expect = 0;
+  foreach_array(kernels, [&](byte_range kernel) {
+    uint64_t x = unsigned_field(kernel, ".sgpr_count");
+    expect += x >= 16 && x < 64;
+  });
+  filter_elements(kernels, band, [&](byte_range) { found++; });
+  CHECK(found == expect);
+
+  // One kernel by name
+  std::string name;
+  REQUIRE(decode(find(kernels, {path_element::index(7),
+                                path_element::key(".name")}),
+                 name));
+  predicate named;
+  named.where(field(".name"), predicate::eq, name);
+  found = 0;
+  filter_elements(kernels, named, [&](byte_range) { found++; });
+  CHECK(found == 1);
+
+  predicate absent;
+  absent.exists(field(".no_such_field"));
+  found = 0;
+  filter_elements(kernels, absent, [&](byte_range) { found++; });
+  CHECK(found == 0);
+
+  predicate none;
+  found = 0;
+  filter_elements(kernels, none, [&](byte_range) { found++; });
+  CHECK(found == total);
+}
+
+TEST_CASE("filter comparisons") {
+  // Back to back {"v": ...} documents: uint64 max, -5 as int16, 2.5, "abc",
+  // [1], nil, and a document without v
+  std::vector<unsigned char> stream = {
+      0x81, 0xa1, 'v', 0xcf, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+      0x81, 0xa1, 'v', 0xd1, 0xff, 0xfb,
+      0x81, 0xa1, 'v', 0xcb, 0x40, 0x04, 0, 0, 0, 0, 0, 0,
+      0x81, 0xa1, 'v', 0xa3, 'a', 'b', 'c',
+      0x81, 0xa1, 'v', 0x91, 0x01,
+      0x81, 0xa1, 'v', 0xc0,
+      0x81, 0xa1, 'w', 0x01};
+
+  // Which documents match, one bit each in stream order
+  auto select = [&](const predicate &pred) {
+    uint64_t bits = 0;
+    uint64_t i = 0;
+    const unsigned char *p = stream.data();
+    const unsigned char *end = filter_messages(
+        range(stream), pred, [&](byte_range message) {
+          while (p != message.start) {
+            p = fallback::skip_next_message(p, stream.data() + stream.size());
+            i++;
+          }
+          bits |= 1u << i;
+        });
+    CHECK(end == stream.data() + stream.size());
+    return bits;
+  };
+  predicate pred;
+  CHECK(select(pred.where(field("v"), predicate::gt, -6)) == 0x7);
+  pred = predicate();
+  CHECK(select(pred.where(field("v"), predicate::lt, 0)) == 0x2);
+  pred = predicate();
+  CHECK(select(pred.where(field("v"), predicate::eq, UINT64_MAX)) == 0x1);
+  pred = predicate();
+  CHECK(select(pred.where(field("v"), predicate::le, 2.5)) == 0x6);
+  pred = predicate();
+  CHECK(select(pred.where(field("v"), predicate::ge, "abb")) == 0x8);
+  pred = predicate();
+  CHECK(select(pred.where(field("v"), predicate::eq,
+                          std::vector<uint64_t>{1})) == 0x10);
+  pred = predicate();
+  CHECK(select(pred.where(field("v"), predicate::ne, "abc")) == 0x37);
+  pred = predicate();
+  CHECK(select(pred.exists(field("v"))) == 0x3f);
+
+  std::vector<unsigned char> truncated = {0x81, 0xa1, 'v', 0x01, 0x81, 0xa1};
+  predicate any;
+  CHECK(filter_messages(range(truncated), any, [](byte_range) {}) ==
+        truncated.data() + 4);
+  CHECK(!filter_elements(range(truncated), any, [](byte_range) {}));
+}
+
+TEST_CASE("filter match_next agrees with matches") {
+  std::vector<predicate> preds(6);
+  preds[0].where(field(".sgpr_count"), predicate::ge, 16);
+  preds[1]
+      .exists(field(".name"))
+      .where({path_element::key(".args"), path_element::index(0),
+              path_element::key(".size")},
+             predicate::eq, 8);
+  preds[2].exists({path_element::index(1)});
+  preds[3].exists({});
+  preds[4].exists(field(".missing"));
+
+  // Elements of the array, the top level sample and a few odd messages,
+  // including a map with a repeated key
+  std::vector<byte_range> messages;
+  foreach_array(kernel_array(),
+                [&](byte_range kernel) { messages.push_back(kernel); });
+  messages.push_back(sample());
+  const std::vector<std::vector<unsigned char>> odd = {
+      {0x2a},
+      {0x92, 0x01, 0x02},
+      {0x82, 0xa5, '.', 'n', 'a', 'm', 'e', 0x01, 0xa5, '.', 'n', 'a', 'm', 'e',
+       0x02},
+      {0x90}};
+  for (const std::vector<unsigned char> &m : odd) {
+    messages.push_back(range(m));
+  }
+  preds[5].where(field(".name"), predicate::eq, 1);
+
+  bool ok = true;
+  for (const predicate &pred : preds) {
+    for (byte_range m : messages) {
+      const unsigned char *end = fallback::skip_next_message(m.start, m.end);
+      bool matched = !pred.matches({m.start, end});
+      ok &= pred.match_next(m, matched) == end;
+      ok &= matched == pred.matches({m.start, end});
+    }
+  }
+  CHECK(ok);
+
+  // Malformed
+  const std::vector<unsigned char> truncated = {0x82, 0xa1, 'a', 0x01, 0xa1};
+  bool matched;
+  CHECK(preds[0].match_next(range(truncated), matched) == nullptr);
+}
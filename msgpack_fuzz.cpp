@@ -131,3 +131,43 @@ TEST_CASE("from urandom") {
   free(bytes);
   close(fd);
 }
+
+TEST_CASE("skip runs of single byte messages") {
+  // Mostly one byte messages, with occasional wider scalars and containers
+  const unsigned char single[] = {0x00, 0x01, 0x7f, 0xe0, 0xff, 0xc0,
+                                  0xc2, 0xc3, 0x80, 0x90, 0xa0};
+  const unsigned char other[] = {0xcd, 0x12, 0x34, 0xa2, 'a', 'b', 0x92, 0xcc};
+
+  uint64_t state = 42;
+  auto next = [&]() -> uint64_t {
+    state = state * UINT64_C(6364136223846793005) + UINT64_C(1442695040888963407);
+    return state >> 33;
+  };
+
+  const unsigned N = 4096;
+  unsigned char *bytes = (unsigned char *)malloc(N);
+
+  bool ok = true;
+  for (unsigned rep = 0; rep < 8; rep++) {
+    for (unsigned i = 0; i < N; i++) {
+      bytes[i] = (next() % 32 == 0) ? other[next() % sizeof(other)]
+                                    : single[next() % sizeof(single)];
+    }
+
+    for (unsigned offset = 0; offset < 64; offset++) {
+      const unsigned char *start = bytes + offset;
+      const unsigned char *end = bytes + N;
+      const unsigned char *expect = start;
+      for (uint64_t k = 1; k < 512; k++) {
+        if (expect) {
+          expect = fallback::skip_next_message(expect, end);
+        }
+        const unsigned char *got =
+            fallback::skip_number_contiguous_messages(k, start, end);
+        ok &= (got == expect);
+      }
+    }
+  }
+  CHECK(ok);
+  free(bytes);
+}
@@ -0,0 +1,102 @@
+#include "msgpack_hash.h"
+#include "msgpack_decode.h"
+
+#include <cstring>
+#include <vector>
+
+namespace {
+using msgpack::token;
+
+const uint64_t seed = UINT64_C(0x9e3779b97f4a7c15);
+
+uint64_t mix(uint64_t a, uint64_t b) {
+  __uint128_t r = (__uint128_t)(a ^ seed) * (b ^ UINT64_C(0xe7037ed1a0b428db));
+  return (uint64_t)r ^ (uint64_t)(r >> 64);
+}
+
+uint64_t hash_bytes(uint64_t h, msgpack::byte_range bytes) {
+  const unsigned char *p = bytes.start;
+  uint64_t N = bytes.end - bytes.start;
+  for (; N >= 8; N -= 8, p += 8) {
+    uint64_t w;
+    memcpy(&w, p, 8);
+    h = mix(h, w);
+  }
+  uint64_t tail = 0;
+  memcpy(&tail, p, N);
+  return mix(h, tail ^ (N << 56));
+}
+
+// Hash of a scalar. The kind is mixed in so that e.g. the string "a" and
+// the binary "a" differ.
+uint64_t hash_scalar(const token &t) {
+  uint64_t h = mix(t.kind, t.value);
+  if (t.kind == token::string || t.kind == token::binary ||
+      t.kind == token::extension) {
+    h = hash_bytes(h, t.payload);
+  }
+  return h;
+}
+
+// A container being hashed. Arrays chain their elements in order, maps sum
+// the hashes of their pairs so the order doesn't matter.
+struct frame {
+  bool is_map;
+  uint64_t remaining; // messages, counting keys and values separately
+  uint64_t count;
+  uint64_t acc;
+  uint64_t key;
+};
+} // namespace
+
+namespace msgpack {
+
+const unsigned char *structural_hash(byte_range bytes, uint64_t &hash) {
+  std::vector<frame> stack;
+  const unsigned char *p = bytes.start;
+
+  for (;;) {
+    token t;
+    p = read_token({p, bytes.end}, t);
+    if (!p) {
+      return nullptr;
+    }
+
+    uint64_t h;
+    if (t.kind == token::array || t.kind == token::map) {
+      const bool is_map = t.kind == token::map;
+      const uint64_t messages = is_map ? 2 * t.value : t.value;
+      if (messages != 0) {
+        stack.push_back({is_map, messages, t.value, 0, 0});
+        continue;
+      }
+      h = mix(t.kind, 0);
+    } else {
+      h = hash_scalar(t);
+    }
+
+    // Pass the hash up through every container it completes
+    for (;;) {
+      if (stack.empty()) {
+        hash = h;
+        return p;
+      }
+      frame &f = stack.back();
+      f.remaining--;
+      if (!f.is_map) {
+        f.acc = mix(f.acc, h);
+      } else if (f.remaining % 2 == 1) {
+        f.key = h;
+      } else {
+        f.acc += mix(f.key, h);
+      }
+      if (f.remaining != 0) {
+        break;
+      }
+      h = mix(f.is_map ? token::map : token::array, mix(f.count, f.acc));
+      stack.pop_back();
+    }
+  }
+}
+
+} // namespace msgpack
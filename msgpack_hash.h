@@ -0,0 +1,22 @@
+#ifndef MSGPACK_HASH_H
+#define MSGPACK_HASH_H
+
+#include "msgpack.h"
+
+#include <cstdint>
+
+namespace msgpack {
+
+// Hash of the value of the message at bytes.start, insensitive to how it was
+// encoded. Integers hash by value whatever their width or signedness, strings
+// whatever their header, float32 as the float64 of the same value and the
+// pairs of a map in any order. Types stay distinct, so the string "a" and
+// the binary "a" hash differently, as do 1 and 1.0.
+//
+// Computed in one pass over the bytes, without decoding into a tree. Returns
+// one past the end of the message, or nullptr if it is malformed.
+const unsigned char *structural_hash(byte_range bytes, uint64_t &hash);
+
+} // namespace msgpack
+
+#endif
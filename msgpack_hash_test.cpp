@@ -0,0 +1,119 @@
+#include "catch.hpp"
+#include "msgpack.h"
+#include "msgpack_decode.h"
+#include "msgpack_hash.h"
+#include "msgpack_test_util.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace msgpack;
+
+namespace {
+uint64_t hash_of(const std::vector<unsigned char> &bytes) {
+  uint64_t h = 0;
+  const unsigned char *end = structural_hash(
+      {bytes.data(), bytes.data() + bytes.size()}, h);
+  CHECK(end == bytes.data() + bytes.size());
+  return h;
+}
+
+// The map at bytes with its pairs in reverse order, under a map32 header
+std::vector<unsigned char> reversed_map(byte_range bytes) {
+  std::vector<byte_range> pairs;
+  decode_map(bytes, [&](byte_range key, byte_range value) -> bool {
+    pairs.push_back({key.start, value.end});
+    return true;
+  });
+  std::reverse(pairs.begin(), pairs.end());
+
+  const uint32_t N = pairs.size();
+  std::vector<unsigned char> res = {0xdf, (unsigned char)(N >> 24),
+                                    (unsigned char)(N >> 16),
+                                    (unsigned char)(N >> 8), (unsigned char)N};
+  for (byte_range p : pairs) {
+    res.insert(res.end(), p.start, p.end);
+  }
+  return res;
+}
+} // namespace
+
+TEST_CASE("structural_hash") {
+  SECTION("integer encodings") {
+    const uint64_t eight = hash_of({0x08});
+    CHECK(hash_of({0xcc, 0x08}) == eight);
+    CHECK(hash_of({0xcd, 0x00, 0x08}) == eight);
+    CHECK(hash_of({0xd3, 0, 0, 0, 0, 0, 0, 0, 0x08}) == eight);
+    CHECK(hash_of({0x09}) != eight);
+
+    const uint64_t minus_one = hash_of({0xff});
+    CHECK(hash_of({0xd0, 0xff}) == minus_one);
+    CHECK(hash_of({0xd3, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff}) ==
+          minus_one);
+    CHECK(hash_of({0xcf, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff}) !=
+          minus_one);
+  }
+
+  SECTION("strings, binary and floats") {
+    const uint64_t foo = hash_of({0xa3, 'f', 'o', 'o'});
+    CHECK(hash_of({0xd9, 3, 'f', 'o', 'o'}) == foo);
+    CHECK(hash_of({0xdb, 0, 0, 0, 3, 'f', 'o', 'o'}) == foo);
+    CHECK(hash_of({0xa3, 'f', 'o', 'x'}) != foo);
+    CHECK(hash_of({0xc4, 3, 'f', 'o', 'o'}) != foo);
+    CHECK(hash_of({0xa0}) != hash_of({0xc4, 0}));
+
+    // 1.5 as float32 and float64
+    CHECK(hash_of({0xca, 0x3f, 0xc0, 0, 0}) ==
+          hash_of({0xcb, 0x3f, 0xf8, 0, 0, 0, 0, 0, 0}));
+    CHECK(hash_of({0xc3}) != hash_of({0xc2}));
+    CHECK(hash_of({0xc0}) != hash_of({0x00}));
+  }
+
+  SECTION("containers") {
+    // [1, 2] vs [2, 1], {1: 2, 3: 4} vs {3: 4, 1: 2} vs {1: 4, 3: 2}
+    CHECK(hash_of({0x92, 0x01, 0x02}) == hash_of({0xdc, 0, 2, 0x01, 0x02}));
+    CHECK(hash_of({0x92, 0x01, 0x02}) != hash_of({0x92, 0x02, 0x01}));
+    CHECK(hash_of({0x82, 1, 2, 3, 4}) == hash_of({0x82, 3, 4, 1, 2}));
+    CHECK(hash_of({0x82, 1, 2, 3, 4}) != hash_of({0x82, 1, 4, 3, 2}));
+    CHECK(hash_of({0x90}) != hash_of({0x80}));
+    CHECK(hash_of({0x91, 0x90}) != hash_of({0x90}));
+    CHECK(hash_of({0x92, 0x91, 0x01, 0x01}) !=
+          hash_of({0x92, 0x01, 0x91, 0x01}));
+  }
+
+  SECTION("manykernels") {
+    byte_range doc = sample();
+    uint64_t h;
+    const unsigned char *end = structural_hash(doc, h);
+    CHECK(end == fallback::skip_next_message(doc.start, doc.end));
+
+    std::vector<uint64_t> hashes;
+    foreach_map(doc, [&](byte_range key, byte_range value) {
+      if (!message_is_string(key, "amdhsa.kernels")) {
+        return;
+      }
+      foreach_array(value, [&](byte_range kernel) {
+        uint64_t k;
+        REQUIRE(structural_hash(kernel, k));
+        CHECK(hash_of(reversed_map(kernel)) == k);
+        hashes.push_back(k);
+      });
+    });
+
+    // Every kernel has a distinct name so a distinct hash
+    REQUIRE(hashes.size() > 1);
+    std::sort(hashes.begin(), hashes.end());
+    CHECK(std::unique(hashes.begin(), hashes.end()) == hashes.end());
+  }
+
+  SECTION("malformed") {
+    uint64_t h;
+    const unsigned char truncated[] = {0x92, 0x01};
+    const unsigned char reserved[] = {0xc1};
+    const unsigned char short_str[] = {0xa3, 'a'};
+    CHECK(!structural_hash({truncated, truncated + 2}, h));
+    CHECK(!structural_hash({reserved, reserved + 1}, h));
+    CHECK(!structural_hash({short_str, short_str + 2}, h));
+    CHECK(!structural_hash({truncated, truncated}, h));
+  }
+}
@@ -0,0 +1,160 @@
+#include "msgpack_iovec.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+
+#include <unistd.h>
+
+namespace {
+using msgpack::detail::write_tagged;
+
+// str or bin header for a payload of N bytes
+size_t payload_header(bool binary, uint64_t N, unsigned char *out) {
+  unsigned char *end;
+  if (!binary && N <= 31) {
+    *out = 0xa0 | static_cast<unsigned char>(N);
+    end = out + 1;
+  } else if (N <= UINT8_MAX) {
+    end = write_tagged(binary ? 0xc4 : 0xd9, static_cast<uint8_t>(N), out);
+  } else if (N <= UINT16_MAX) {
+    end = write_tagged(binary ? 0xc5 : 0xda, static_cast<uint16_t>(N), out);
+  } else {
+    end = write_tagged(binary ? 0xc6 : 0xdb, static_cast<uint32_t>(N), out);
+  }
+  return end - out;
+}
+
+#if defined(IOV_MAX)
+const size_t iov_batch = IOV_MAX;
+#else
+const size_t iov_batch = 1024;
+#endif
+} // namespace
+
+namespace msgpack {
+
+unsigned char *iovec_writer::reserve(size_t N) {
+  const size_t at = arena.size();
+  arena.resize(at + N);
+  total += N;
+  if (!segments.empty() && !segments.back().referenced &&
+      segments.back().offset + segments.back().length == at) {
+    segments.back().length += N;
+  } else {
+    segments.push_back({nullptr, at, N});
+  }
+  return arena.data() + at;
+}
+
+// Only for caller owned bytes, which may be referenced rather than copied
+void iovec_writer::append(const void *data, size_t N) {
+  if (N == 0) {
+    return;
+  }
+  if (N < reference_threshold) {
+    memcpy(reserve(N), data, N);
+    return;
+  }
+  segments.push_back({static_cast<const unsigned char *>(data), 0, N});
+  total += N;
+}
+
+bool iovec_writer::begin_array(uint64_t N) {
+  if (N > UINT32_MAX) {
+    return false;
+  }
+  detail::write_array_header(N, reserve(detail::container_header_size(N)));
+  return true;
+}
+
+bool iovec_writer::begin_map(uint64_t N) {
+  if (N > UINT32_MAX) {
+    return false;
+  }
+  detail::write_map_header(N, reserve(detail::container_header_size(N)));
+  return true;
+}
+
+bool iovec_writer::write_string(const char *data, uint64_t N) {
+  if (N > UINT32_MAX) {
+    return false;
+  }
+  unsigned char header[5];
+  const size_t n = payload_header(false, N, header);
+  memcpy(reserve(n), header, n);
+  append(data, N);
+  return true;
+}
+
+bool iovec_writer::write_binary(const void *data, uint64_t N) {
+  if (N > UINT32_MAX) {
+    return false;
+  }
+  unsigned char header[5];
+  const size_t n = payload_header(true, N, header);
+  memcpy(reserve(n), header, n);
+  append(data, N);
+  return true;
+}
+
+bool iovec_writer::write_message(byte_range message) {
+  const unsigned char *end =
+      fallback::skip_next_message(message.start, message.end);
+  if (!end) {
+    return false;
+  }
+  append(message.start, end - message.start);
+  return true;
+}
+
+std::vector<struct iovec> iovec_writer::iovecs() const {
+  std::vector<struct iovec> res(segments.size());
+  for (size_t i = 0; i < segments.size(); i++) {
+    const segment &s = segments[i];
+    const unsigned char *base =
+        s.referenced ? s.referenced : arena.data() + s.offset;
+    res[i].iov_base = const_cast<unsigned char *>(base);
+    res[i].iov_len = s.length;
+  }
+  return res;
+}
+
+bool iovec_writer::write_to(int fd) const {
+  std::vector<struct iovec> v = iovecs();
+  size_t first = 0;
+  while (first < v.size()) {
+    const size_t count =
+        (v.size() - first) < iov_batch ? (v.size() - first) : iov_batch;
+    ssize_t written = writev(fd, v.data() + first, (int)count);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    if (written == 0) {
+      return false;
+    }
+
+    // Drop the entries that were written, trim a partially written one
+    size_t n = written;
+    while (first < v.size() && n >= v[first].iov_len) {
+      n -= v[first].iov_len;
+      first++;
+    }
+    if (n != 0) {
+      v[first].iov_base = static_cast<unsigned char *>(v[first].iov_base) + n;
+      v[first].iov_len -= n;
+    }
+  }
+  return true;
+}
+
+void iovec_writer::clear() {
+  total = 0;
+  arena.clear();
+  segments.clear();
+}
+
+} // namespace msgpack
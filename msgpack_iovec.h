@@ -0,0 +1,81 @@
+#ifndef MSGPACK_IOVEC_H
+#define MSGPACK_IOVEC_H
+
+#include "msgpack.h"
+#include "msgpack_traits.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <sys/uio.h>
+
+namespace msgpack {
+
+// Builds messages as a list of iovecs for writev / pwritev. Headers and small
+// values are encoded into an owned arena; string, binary and pre-encoded
+// message payloads of at least reference_threshold bytes are referenced where
+// they are instead of copied. Referenced memory must stay valid and unchanged
+// until the output has been written.
+class iovec_writer {
+public:
+  iovec_writer(size_t reference_threshold = 512)
+      : reference_threshold(reference_threshold) {}
+
+  // Headers for containers of known size, followed by N elements (2N for a
+  // map). Return false if N exceeds UINT32_MAX.
+  bool begin_array(uint64_t N);
+  bool begin_map(uint64_t N);
+
+  // Small values, always copied. Returns false, writing nothing, if x can't
+  // be encoded.
+  template <typename T> bool write(const T &x) {
+    const uint64_t N = encoded_size(x);
+    if (N == too_large_to_encode) {
+      return false;
+    }
+    msgpack_traits<T>::write(x, reserve(N));
+    return true;
+  }
+
+  // Return false if N exceeds UINT32_MAX
+  bool write_string(const char *data, uint64_t N);
+  bool write_binary(const void *data, uint64_t N);
+
+  // One already encoded message. Returns false if the range does not start
+  // with a well formed message.
+  bool write_message(byte_range message);
+
+  // Total bytes described by the iovecs
+  uint64_t size() const { return total; }
+
+  // The output in order. Adjacent arena bytes share one entry. Pointers into
+  // the arena are invalidated by further writes.
+  std::vector<struct iovec> iovecs() const;
+
+  // Writes everything to fd with writev, resuming after short writes and
+  // batching by IOV_MAX. Returns false on a write error.
+  bool write_to(int fd) const;
+
+  void clear();
+
+private:
+  // Arena segments hold an offset, since the arena may move as it grows
+  struct segment {
+    const unsigned char *referenced;
+    size_t offset;
+    size_t length;
+  };
+
+  unsigned char *reserve(size_t N);
+  void append(const void *data, size_t N);
+
+  size_t reference_threshold;
+  uint64_t total = 0;
+  std::vector<unsigned char> arena;
+  std::vector<segment> segments;
+};
+
+} // namespace msgpack
+
+#endif
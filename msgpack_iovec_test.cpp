@@ -0,0 +1,135 @@
+#include "catch.hpp"
+#include "msgpack.h"
+#include "msgpack_iovec.h"
+#include "msgpack_test_util.h"
+#include "msgpack_traits.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace msgpack;
+
+namespace {
+std::vector<unsigned char> gather(const iovec_writer &w) {
+  std::vector<unsigned char> res;
+  for (const struct iovec &v : w.iovecs()) {
+    const unsigned char *p = static_cast<const unsigned char *>(v.iov_base);
+    res.insert(res.end(), p, p + v.iov_len);
+  }
+  return res;
+}
+
+std::vector<unsigned char> read_all(FILE *f) {
+  std::vector<unsigned char> res;
+  rewind(f);
+  int c;
+  while ((c = fgetc(f)) != EOF) {
+    res.push_back((unsigned char)c);
+  }
+  return res;
+}
+} // namespace
+
+TEST_CASE("iovec_writer references large payloads") {
+  const std::string small = "kernel";
+  const std::string large(100000, 'x');
+  const std::vector<unsigned char> blob(70000, 7);
+
+  iovec_writer w(1024);
+  REQUIRE(w.begin_map(3));
+  w.write(std::string(".name"));
+  REQUIRE(w.write_string(small.data(), small.size()));
+  w.write(std::string(".source"));
+  REQUIRE(w.write_string(large.data(), large.size()));
+  w.write(std::string(".code"));
+  REQUIRE(w.write_binary(blob.data(), blob.size()));
+
+  std::vector<unsigned char> expect = {0x83};
+  for (const std::vector<unsigned char> &part :
+       {encode(std::string(".name")), encode(small),
+        encode(std::string(".source")), encode(large),
+        encode(std::string(".code"))}) {
+    expect.insert(expect.end(), part.begin(), part.end());
+  }
+  expect.push_back(0xc6);
+  expect.insert(expect.end(), {0x00, 0x01, 0x11, 0x70});
+  expect.insert(expect.end(), blob.begin(), blob.end());
+
+  CHECK(w.size() == expect.size());
+  CHECK(gather(w) == expect);
+
+  // Arena runs are merged, the two large payloads are separate entries
+  std::vector<struct iovec> v = w.iovecs();
+  REQUIRE(v.size() == 4);
+  CHECK(v[1].iov_base == (const void *)large.data());
+  CHECK(v[3].iov_base == (const void *)blob.data());
+
+  FILE *f = tmpfile();
+  REQUIRE(f != nullptr);
+  CHECK(w.write_to(fileno(f)));
+  CHECK(read_all(f) == expect);
+  fclose(f);
+}
+
+TEST_CASE("iovec_writer messages and batching") {
+  std::vector<unsigned char> message = encode(std::vector<uint64_t>(300, 1));
+  std::vector<unsigned char> truncated = {0x92, 0x01};
+
+  iovec_writer w(64);
+  CHECK(!w.write_message({truncated.data(), truncated.data() + 2}));
+  CHECK(w.size() == 0);
+
+  // Alternating arena and referenced entries, more than one writev batch.
+  // The header shares the first arena entry.
+  const uint64_t N = 3000;
+  REQUIRE(w.begin_array(2 * N));
+  std::vector<unsigned char> expect = {0xdc, 0x17, 0x70};
+  for (uint64_t i = 0; i < N; i++) {
+    w.write(i);
+    REQUIRE(w.write_message(
+        {message.data(), message.data() + message.size()}));
+    std::vector<unsigned char> x = encode(i);
+    expect.insert(expect.end(), x.begin(), x.end());
+    expect.insert(expect.end(), message.begin(), message.end());
+  }
+  CHECK(w.iovecs().size() == 2 * N);
+
+  FILE *f = tmpfile();
+  REQUIRE(f != nullptr);
+  CHECK(w.write_to(fileno(f)));
+  CHECK(read_all(f) == expect);
+  fclose(f);
+
+  w.clear();
+  CHECK(w.size() == 0);
+  CHECK(w.iovecs().empty());
+}
+
+TEST_CASE("iovec_writer copies headers below the threshold") {
+  // The str32 and bin32 headers are five bytes, over this threshold, and
+  // must still be copied rather than referenced
+  const std::string large(70000, 's');
+  const std::vector<unsigned char> blob(70000, 'b');
+  iovec_writer w(4);
+  REQUIRE(w.write_string(large.data(), large.size()));
+  REQUIRE(w.write_binary(blob.data(), blob.size()));
+
+  std::vector<unsigned char> expect = encode(large);
+  expect.insert(expect.end(), {0xc6, 0x00, 0x01, 0x11, 0x70});
+  expect.insert(expect.end(), blob.begin(), blob.end());
+  CHECK(gather(w) == expect);
+
+  std::vector<struct iovec> v = w.iovecs();
+  REQUIRE(v.size() == 4);
+  CHECK(v[1].iov_base == (const void *)large.data());
+  CHECK(v[3].iov_base == (const void *)blob.data());
+}
+
+TEST_CASE("iovec_writer value too large to encode") {
+  iovec_writer w;
+  CHECK(!w.write(std::vector<oversized>(1)));
+  CHECK(w.size() == 0);
+  CHECK(w.write(1));
+  CHECK(w.size() == 1);
+}
@@ -0,0 +1,222 @@
+#include "msgpack_lookup.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+// Number of key value pairs in a map message, false if it isn't one
+bool map_pairs(msgpack::byte_range bytes, uint64_t *pairs) {
+  using namespace msgpack;
+  if (!is_map(bytes)) {
+    return false;
+  }
+  *pairs = payload_info(parse_type(*bytes.start))(bytes.start);
+  return true;
+}
+// First (up to) eight bytes of a string as an integer, zero padded
+uint64_t prefix(const unsigned char *str, size_t N) {
+  uint64_t res = 0;
+  memcpy(&res, str, N < 8 ? N : 8);
+  return res;
+}
+
+// String payload of a str-family message, without the generic dispatch
+bool string_payload(msgpack::byte_range bytes, size_t *N,
+                    const unsigned char **str) {
+  const uint64_t available = bytes.end - bytes.start;
+  if (available == 0) {
+    return false;
+  }
+
+  const unsigned char ty = *bytes.start;
+  uint64_t header;
+  uint64_t length;
+  if (ty >= 0xa0 && ty <= 0xbf) {
+    header = 1;
+    length = ty & 0x1fu;
+  } else if (ty == 0xd9 && available >= 2) {
+    header = 2;
+    length = bytes.start[1];
+  } else if (ty == 0xda && available >= 3) {
+    header = 3;
+    length = ((uint64_t)bytes.start[1] << 8) | bytes.start[2];
+  } else if (ty == 0xdb && available >= 5) {
+    uint32_t b;
+    memcpy(&b, bytes.start + 1, 4);
+    header = 5;
+    length = __builtin_bswap32(b);
+  } else {
+    return false;
+  }
+
+  if (available - header < length) {
+    return false;
+  }
+  *N = length;
+  *str = bytes.start + header;
+  return true;
+}
+} // namespace
+
+namespace msgpack {
+
+const size_t key_set::npos;
+
+key_set::key_set(const std::vector<std::string> &keys) : keys(keys) {
+  size_t longest = 0;
+  for (const std::string &key : keys) {
+    longest = std::max(longest, key.size());
+  }
+
+  for (size_t i = 0; i < keys.size(); i++) {
+    const unsigned char *str =
+        reinterpret_cast<const unsigned char *>(keys[i].data());
+    candidates.push_back({prefix(str, keys[i].size()), i});
+  }
+
+  // Order by length, then prefix, then index so duplicates resolve to the
+  // first occurrence
+  std::sort(candidates.begin(), candidates.end(),
+            [&](const candidate &x, const candidate &y) {
+              size_t xn = keys[x.index].size(), yn = keys[y.index].size();
+              if (xn != yn) {
+                return xn < yn;
+              }
+              if (x.prefix != y.prefix) {
+                return x.prefix < y.prefix;
+              }
+              return x.index < y.index;
+            });
+
+  by_length.assign(longest + 2, 0);
+  for (const candidate &c : candidates) {
+    by_length[keys[c.index].size() + 1]++;
+  }
+  for (size_t N = 1; N < by_length.size(); N++) {
+    by_length[N] += by_length[N - 1];
+  }
+}
+
+size_t key_set::classify(byte_range bytes) const {
+  size_t N;
+  const unsigned char *str;
+  if (!string_payload(bytes, &N, &str)) {
+    return npos;
+  }
+  return classify(N, str);
+}
+
+size_t key_set::classify(size_t N, const unsigned char *str) const {
+  if (N + 1 >= by_length.size()) {
+    return npos;
+  }
+
+  const candidate *first = candidates.data() + by_length[N];
+  const candidate *last = candidates.data() + by_length[N + 1];
+  const uint64_t p = prefix(str, N);
+
+  const candidate *c = std::lower_bound(
+      first, last, p,
+      [](const candidate &x, uint64_t value) { return x.prefix < value; });
+
+  for (; c != last && c->prefix == p; c++) {
+    if (N <= 8 || memcmp(keys[c->index].data() + 8, str + 8, N - 8) == 0) {
+      return c->index;
+    }
+  }
+  return npos;
+}
+
+map_shape_cache::map_shape_cache(const std::vector<std::string> &keys)
+    : matcher(keys), entries(keys.size(), {0, {}}) {}
+
+bool map_shape_cache::lookup(byte_range map, byte_range *values) {
+  uint64_t pairs;
+  if (!map_pairs(map, &pairs)) {
+    return false;
+  }
+
+  bool all_hit = (pairs == cached_pairs);
+  for (size_t k = 0; k < entries.size() && all_hit; k++) {
+    const entry &e = entries[k];
+    values[k] = {nullptr, nullptr};
+    if (e.encoded.empty()) {
+      continue;
+    }
+
+    const uint64_t available = map.end - map.start;
+    const uint64_t N = e.encoded.size();
+    if (e.offset > available || available - e.offset < N ||
+        memcmp(map.start + e.offset, e.encoded.data(), N) != 0) {
+      all_hit = false;
+      break;
+    }
+
+    const unsigned char *value = map.start + e.offset + N;
+    const unsigned char *value_end = fallback::skip_next_message(value, map.end);
+    if (!value_end) {
+      all_hit = false;
+      break;
+    }
+    values[k] = {value, value_end};
+  }
+
+  // Keys absent from the cached map are only known to be absent from this
+  // one if every key of it is where the cached map had it
+  for (size_t i = 0; i < shape.size() && all_hit; i++) {
+    const entry &e = shape[i];
+    const uint64_t available = map.end - map.start;
+    const uint64_t N = e.encoded.size();
+    all_hit = e.offset <= available && available - e.offset >= N &&
+              memcmp(map.start + e.offset, e.encoded.data(), N) == 0;
+  }
+
+  if (all_hit) {
+    hit_count++;
+    return true;
+  }
+
+  miss_count++;
+  return scan(map, values, pairs);
+}
+
+bool map_shape_cache::scan(byte_range map, byte_range *values,
+                           uint64_t pairs) {
+  for (size_t k = 0; k < entries.size(); k++) {
+    values[k] = {nullptr, nullptr};
+    entries[k].encoded.clear();
+  }
+
+  shape.clear();
+
+  size_t found = 0;
+  uint64_t seen = 0;
+  foreach_map(map, [&](byte_range key, byte_range value) {
+    seen++;
+    shape.push_back({(uint64_t)(key.start - map.start),
+                     std::vector<unsigned char>(key.start, key.end)});
+    if (found == entries.size()) {
+      return;
+    }
+    size_t k = matcher.classify(key);
+    if (k == key_set::npos || values[k].start) {
+      return;
+    }
+    values[k] = value;
+    entries[k].offset = key.start - map.start;
+    entries[k].encoded.assign(key.start, key.end);
+    found++;
+  });
+
+  // Every key of the map is only needed to confirm that some are absent
+  if (found == entries.size()) {
+    shape.clear();
+  }
+
+  // foreach_map stops quietly on a malformed element
+  const bool ok = (seen == pairs);
+  cached_pairs = ok ? pairs : UINT64_MAX;
+  return ok;
+}
+
+} // namespace msgpack
@@ -0,0 +1,99 @@
+#ifndef MSGPACK_LOOKUP_H
+#define MSGPACK_LOOKUP_H
+
+#include "msgpack.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace msgpack {
+
+// Matches string messages against a set of keys only known at runtime, e.g.
+// loaded from configuration. The keys are bucketed by length and, within a
+// bucket, sorted by their first eight bytes packed into an integer. classify
+// reads the string header once, then compares the payload's first eight
+// bytes against the bucket with a binary search, only falling back to memcmp
+// for the tail of keys longer than eight bytes.
+class key_set {
+public:
+  static const size_t npos = SIZE_MAX;
+
+  key_set(const std::vector<std::string> &keys);
+
+  size_t size() const { return keys.size(); }
+  const std::string &key(size_t i) const { return keys[i]; }
+
+  // Index of the key equal to the string message at bytes.start, or npos if
+  // it is not a string or not in the set. Duplicate keys resolve to the
+  // first index.
+  size_t classify(byte_range bytes) const;
+
+  // As classify, given a string payload
+  size_t classify(size_t N, const unsigned char *str) const;
+
+private:
+  struct candidate {
+    uint64_t prefix;
+    size_t index;
+  };
+
+  std::vector<std::string> keys;
+  // candidates[by_length[N] .. by_length[N + 1]) have length N
+  std::vector<size_t> by_length;
+  std::vector<candidate> candidates;
+};
+
+// Looks up a fixed set of string keys in a sequence of maps that usually
+// share one shape, e.g. the kernel maps of amdhsa.kernels. The offset and the
+// exact encoding of each key found in the previous map are remembered. In the
+// next map with the same number of elements, each key is checked at that
+// offset with one memcmp and its value skipped over. Only keys that miss are
+// searched for with a linear scan, which refreshes the cache.
+//
+// If some keys were absent from the cached map, a hit also checks every key
+// of that map at its cached offset, so that the absent keys are known to be
+// absent here too. Such a hit costs one memcmp per key of the map rather than
+// one per key looked up, though values are still only skipped for the keys
+// looked up. When every key was found a hit stays at one memcmp and one skip
+// per key looked up. A hit is trusted on the memcmps alone. Bytes of some other
+// message that happen to equal an encoded key at a cached offset will be
+// misread as that key, so prefer foreach_map for adversarial input.
+class map_shape_cache {
+public:
+  // Keys are expected to be distinct
+  map_shape_cache(const std::vector<std::string> &keys);
+
+  size_t size() const { return entries.size(); }
+
+  // Sets values[i] to the value of the first occurrence of key i, or to
+  // {nullptr, nullptr} if the key is absent. Returns false if map is not a
+  // well formed map message.
+  bool lookup(byte_range map, byte_range *values);
+
+  uint64_t hits() const { return hit_count; }
+  uint64_t misses() const { return miss_count; }
+
+private:
+  bool scan(byte_range map, byte_range *values, uint64_t pairs);
+
+  key_set matcher;
+
+  struct entry {
+    // Offset from the start of the map message and the encoded key bytes,
+    // empty if the key was absent from the cached map
+    uint64_t offset;
+    std::vector<unsigned char> encoded;
+  };
+
+  std::vector<entry> entries;
+  // Every key of the cached map, empty if all of the keys were found in it
+  std::vector<entry> shape;
+  uint64_t cached_pairs = UINT64_MAX;
+  uint64_t hit_count = 0;
+  uint64_t miss_count = 0;
+};
+
+} // namespace msgpack
+
+#endif
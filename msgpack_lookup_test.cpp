@@ -0,0 +1,182 @@
+#include "catch.hpp"
+#include "msgpack.h"
+#include "msgpack_lookup.h"
+#include "msgpack_test_util.h"
+
+#include <string>
+#include <vector>
+
+using namespace msgpack;
+
+namespace {
+std::vector<byte_range> kernel_maps() {
+  std::vector<byte_range> res;
+  foreach_array(kernel_array(),
+                [&](byte_range kernel) { res.push_back(kernel); });
+  return res;
+}
+
+// Reference lookup, first occurrence of the key
+byte_range linear_lookup(byte_range map, const std::string &key) {
+  byte_range res = {nullptr, nullptr};
+  foreach_map(map, [&](byte_range k, byte_range v) {
+    if (!res.start && message_is_string(k, key.c_str())) {
+      res = v;
+    }
+  });
+  return res;
+}
+} // namespace
+
+TEST_CASE("map_shape_cache") {
+  const std::vector<std::string> keys = {".name", ".kernarg_segment_size",
+                                         ".sgpr_count", ".not_a_key",
+                                         ".vgpr_count"};
+
+  SECTION("manykernels") {
+    std::vector<byte_range> kernels = kernel_maps();
+    REQUIRE(kernels.size() > 1);
+
+    map_shape_cache cache(keys);
+    std::vector<byte_range> values(cache.size());
+    bool ok = true;
+    for (byte_range kernel : kernels) {
+      REQUIRE(cache.lookup(kernel, values.data()));
+      for (size_t k = 0; k < keys.size(); k++) {
+        byte_range expect = linear_lookup(kernel, keys[k]);
+        ok &= values[k].start == expect.start;
+        ok &= values[k].end == expect.end;
+      }
+    }
+    CHECK(ok);
+    CHECK(cache.hits() + cache.misses() == kernels.size());
+    CHECK(cache.hits() > 0);
+  }
+
+  SECTION("shape changes") {
+    // {"a": 1, "b": 2} then {"b": 3, "a": 4} then {"a": 5, "b": 6}
+    const unsigned char first[] = {0x82, 0xa1, 'a', 0x01, 0xa1, 'b', 0x02};
+    const unsigned char second[] = {0x82, 0xa1, 'b', 0x03, 0xa1, 'a', 0x04};
+    const unsigned char third[] = {0x82, 0xa1, 'a', 0x05, 0xa1, 'b', 0x06};
+
+    map_shape_cache cache({"a", "b"});
+    byte_range values[2];
+
+    auto check = [&](const unsigned char *map, size_t N, uint64_t a,
+                     uint64_t b) {
+      REQUIRE(cache.lookup({map, map + N}, values));
+      uint64_t got_a = 0, got_b = 0;
+      foronly_unsigned(values[0], [&](uint64_t x) { got_a = x; });
+      foronly_unsigned(values[1], [&](uint64_t x) { got_b = x; });
+      CHECK(got_a == a);
+      CHECK(got_b == b);
+    };
+
+    check(first, sizeof(first), 1, 2);
+    CHECK(cache.misses() == 1);
+    check(second, sizeof(second), 4, 3);
+    CHECK(cache.misses() == 2);
+    check(third, sizeof(third), 5, 6);
+    CHECK(cache.misses() == 3);
+    check(first, sizeof(first), 1, 2);
+    CHECK(cache.hits() == 1);
+  }
+
+  SECTION("key absent from the cached shape") {
+    // {"a": 1, "b": 2} then {"a": 1, "c": 3}, same pair count and offsets
+    const unsigned char first[] = {0x82, 0xa1, 'a', 0x01, 0xa1, 'b', 0x02};
+    const unsigned char second[] = {0x82, 0xa1, 'a', 0x01, 0xa1, 'c', 0x03};
+
+    map_shape_cache cache({"a", "c"});
+    byte_range values[2];
+    REQUIRE(cache.lookup({first, first + sizeof(first)}, values));
+    CHECK(values[0].start == first + 3);
+    CHECK(values[1].start == nullptr);
+
+    REQUIRE(cache.lookup({second, second + sizeof(second)}, values));
+    CHECK(values[0].start == second + 3);
+    CHECK(values[1].start == second + 6);
+
+    // The same shape again hits, absent key included
+    REQUIRE(cache.lookup({first, first + sizeof(first)}, values));
+    CHECK(values[1].start == nullptr);
+    REQUIRE(cache.lookup({first, first + sizeof(first)}, values));
+    CHECK(values[1].start == nullptr);
+    CHECK(cache.hits() == 1);
+  }
+
+  SECTION("malformed") {
+    map_shape_cache cache({"a"});
+    byte_range values[1];
+    const unsigned char truncated[] = {0x82, 0xa1, 'a', 0x01, 0xa1};
+    CHECK(!cache.lookup({truncated, truncated + sizeof(truncated)}, values));
+    const unsigned char array[] = {0x90};
+    CHECK(!cache.lookup({array, array + 1}, values));
+  }
+}
+
+namespace {
+std::vector<unsigned char> encode_str(unsigned char ty, const std::string &s) {
+  std::vector<unsigned char> res;
+  const uint32_t N = s.size();
+  switch (ty) {
+  case 0xa0:
+    res.push_back(0xa0 | N);
+    break;
+  case 0xd9:
+    res = {0xd9, (unsigned char)N};
+    break;
+  case 0xda:
+    res = {0xda, (unsigned char)(N >> 8), (unsigned char)N};
+    break;
+  case 0xdb:
+    res = {0xdb, 0, 0, (unsigned char)(N >> 8), (unsigned char)N};
+    break;
+  }
+  res.insert(res.end(), s.begin(), s.end());
+  return res;
+}
+} // namespace
+
+TEST_CASE("key_set") {
+  const std::vector<std::string> keys = {
+      ".kernarg_segment_size", ".kernarg_segment_align", ".name", "",
+      ".sgpr_count", "12345678", "123456789", ".name", std::string(40, 'z')};
+  key_set set(keys);
+  CHECK(set.size() == keys.size());
+
+  SECTION("every encoding of every key") {
+    for (size_t i = 0; i < keys.size(); i++) {
+      // Duplicates resolve to the first occurrence
+      size_t expect = (i == 7) ? 2 : i;
+      for (unsigned char ty : {0xa0, 0xd9, 0xda, 0xdb}) {
+        if (ty == 0xa0 && keys[i].size() > 31) {
+          continue;
+        }
+        std::vector<unsigned char> bytes = encode_str(ty, keys[i]);
+        CHECK(set.classify({bytes.data(), bytes.data() + bytes.size()}) ==
+              expect);
+      }
+    }
+  }
+
+  SECTION("non members") {
+    for (const std::string &s :
+         {std::string(".kernarg_segment_sizf"), std::string(".nam"),
+          std::string("1234567"), std::string("123456780"),
+          std::string(41, 'z'), std::string(39, 'z')}) {
+      std::vector<unsigned char> bytes = encode_str(0xd9, s);
+      CHECK(set.classify({bytes.data(), bytes.data() + bytes.size()}) ==
+            key_set::npos);
+    }
+  }
+
+  SECTION("not a string") {
+    const unsigned char uint[] = {0x05};
+    const unsigned char truncated[] = {0xa5, '.', 'n'};
+    CHECK(set.classify({uint, uint + 1}) == key_set::npos);
+    CHECK(set.classify({truncated, truncated + sizeof(truncated)}) ==
+          key_set::npos);
+    CHECK(set.classify({uint, uint}) == key_set::npos);
+  }
+}
@@ -0,0 +1,167 @@
+#include "msgpack_map_index.h"
+#include "msgpack_compare.h"
+#include "msgpack_decode.h"
+#include "msgpack_hash.h"
+#include "msgpack_parallel.h"
+#include "msgpack_traits.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+const unsigned char index_magic[8] = {'M', 'P', 'K', 'M', 'I', 'D', 'X', '1'};
+
+// Host is little endian, as the saved form is
+template <typename T> void put(std::vector<unsigned char> &out, T x) {
+  const size_t at = out.size();
+  out.resize(at + sizeof(T));
+  memcpy(out.data() + at, &x, sizeof(T));
+}
+
+template <typename T> bool get(const unsigned char *&p, const unsigned char *end,
+                               T &x) {
+  if ((size_t)(end - p) < sizeof(T)) {
+    return false;
+  }
+  memcpy(&x, p, sizeof(T));
+  p += sizeof(T);
+  return true;
+}
+} // namespace
+
+namespace msgpack {
+
+template <typename Offset> bool map_index<Offset>::build(byte_range bytes) {
+  base = nullptr;
+  length = 0;
+  entries.clear();
+
+  std::vector<Offset> offsets;
+  if (!is_map(bytes) || !index_elements(bytes, offsets)) {
+    return false;
+  }
+
+  const size_t N = offsets.size() / 2;
+  entries.resize(N);
+  for (size_t i = 0; i < N; i++) {
+    entry &e = entries[i];
+    e.key = offsets[2 * i];
+    e.value = offsets[2 * i + 1];
+    e.end = offsets[2 * i + 2];
+    structural_hash({bytes.start + e.key, bytes.start + e.value}, e.hash);
+  }
+
+  std::stable_sort(
+      entries.begin(), entries.end(),
+      [](const entry &x, const entry &y) { return x.hash < y.hash; });
+  base = bytes.start;
+  length = offsets.back();
+  return true;
+}
+
+template <typename Offset>
+bool map_index<Offset>::candidates(byte_range key, uint64_t &hash,
+                                   size_t &from, size_t &to) const {
+  if (!structural_hash(key, hash)) {
+    return false;
+  }
+  auto lo = std::lower_bound(
+      entries.begin(), entries.end(), hash,
+      [](const entry &e, uint64_t h) { return e.hash < h; });
+  auto hi = std::upper_bound(
+      lo, entries.end(), hash,
+      [](uint64_t h, const entry &e) { return h < e.hash; });
+  from = lo - entries.begin();
+  to = hi - entries.begin();
+  return true;
+}
+
+template <typename Offset>
+bool map_index<Offset>::key_matches(size_t i, byte_range key) const {
+  return equal({base + entries[i].key, base + entries[i].value}, key);
+}
+
+template <typename Offset>
+byte_range map_index<Offset>::find(byte_range key) const {
+  uint64_t hash;
+  size_t from, to;
+  if (candidates(key, hash, from, to)) {
+    for (size_t i = from; i < to; i++) {
+      if (key_matches(i, key)) {
+        return value(i);
+      }
+    }
+  }
+  return {nullptr, nullptr};
+}
+
+template <typename Offset>
+byte_range map_index<Offset>::find(const std::string &key) const {
+  std::vector<unsigned char> encoded = encode(key);
+  return find(byte_range{encoded.data(), encoded.data() + encoded.size()});
+}
+
+template <typename Offset>
+void map_index<Offset>::save(std::vector<unsigned char> &out) const {
+  out.assign(index_magic, index_magic + sizeof(index_magic));
+  put<uint64_t>(out, sizeof(Offset));
+  put<uint64_t>(out, length);
+  put<uint64_t>(out, entries.size());
+  for (const entry &e : entries) {
+    put(out, e.hash);
+    put(out, e.key);
+    put(out, e.value);
+    put(out, e.end);
+  }
+}
+
+template <typename Offset>
+bool map_index<Offset>::load(byte_range bytes, byte_range saved) {
+  base = nullptr;
+  length = 0;
+  entries.clear();
+
+  const unsigned char *p = saved.start;
+  uint64_t width, saved_length, N;
+  if ((size_t)(saved.end - p) < sizeof(index_magic) ||
+      memcmp(p, index_magic, sizeof(index_magic)) != 0) {
+    return false;
+  }
+  p += sizeof(index_magic);
+  if (!get(p, saved.end, width) || !get(p, saved.end, saved_length) ||
+      !get(p, saved.end, N) || width != sizeof(Offset) ||
+      saved_length > (uint64_t)(bytes.end - bytes.start)) {
+    return false;
+  }
+
+  token t;
+  const size_t entry_bytes = sizeof(uint64_t) + 3 * sizeof(Offset);
+  if (!read_token(bytes, t) || t.kind != token::map || t.value != N ||
+      (uint64_t)(saved.end - p) != N * entry_bytes) {
+    return false;
+  }
+
+  std::vector<entry> loaded(N);
+  const Offset first = t.next - bytes.start;
+  for (uint64_t i = 0; i < N; i++) {
+    entry &e = loaded[i];
+    get(p, saved.end, e.hash);
+    get(p, saved.end, e.key);
+    get(p, saved.end, e.value);
+    get(p, saved.end, e.end);
+    if (e.key < first || e.key >= e.value || e.value >= e.end ||
+        e.end > saved_length || (i != 0 && loaded[i - 1].hash > e.hash)) {
+      return false;
+    }
+  }
+
+  entries.swap(loaded);
+  base = bytes.start;
+  length = saved_length;
+  return true;
+}
+
+template class map_index<uint32_t>;
+template class map_index<uint64_t>;
+
+} // namespace msgpack
@@ -0,0 +1,87 @@
+#ifndef MSGPACK_MAP_INDEX_H
+#define MSGPACK_MAP_INDEX_H
+
+#include "msgpack.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace msgpack {
+
+// Key lookup in one wide map message without a linear scan. build records
+// the key, value and end offset of every pair, as index_elements does, with
+// the structural_hash of the key, and sorts the pairs by hash. A lookup
+// hashes the probe key, binary searches for the run of pairs with that hash
+// and confirms each with equal, so keys match by value whatever their
+// encoding. Duplicate keys are kept in the order they appear in the map.
+//
+// Offset is uint32_t or uint64_t, as for index_elements. The index refers to
+// the map by address and must be rebuilt or reloaded if it moves.
+template <typename Offset> class map_index {
+public:
+  // Returns false, leaving the index empty, if bytes does not start with a
+  // well formed map, or one that extends past the reach of Offset
+  bool build(byte_range bytes);
+
+  // Number of pairs
+  size_t size() const { return entries.size(); }
+
+  // Value of the first pair whose key equals the message at key.start, or
+  // {nullptr, nullptr} if there is none
+  byte_range find(byte_range key) const;
+  byte_range find(const std::string &key) const;
+
+  // Calls f(value) for each pair whose key equals the message at key.start,
+  // in map order. Returns the number of calls.
+  template <typename F> uint64_t find_all(byte_range key, F f) const {
+    uint64_t hash;
+    size_t from, to;
+    if (!candidates(key, hash, from, to)) {
+      return 0;
+    }
+    uint64_t found = 0;
+    for (size_t i = from; i < to; i++) {
+      if (key_matches(i, key)) {
+        f(value(i));
+        found++;
+      }
+    }
+    return found;
+  }
+
+  // Serialised form for caching next to the document: the magic "MPKMIDX1",
+  // then the offset width, the map's byte length and the pair count, then
+  // the sorted pairs, every field little endian.
+  void save(std::vector<unsigned char> &out) const;
+
+  // Restores a saved index for the map at bytes.start. The header, bounds
+  // and order of the entries are checked, so a lookup never reads outside
+  // the map, but an index saved for a different map of the same length and
+  // pair count is not detected and gives wrong answers. Returns false,
+  // leaving the index empty, if the check fails.
+  bool load(byte_range bytes, byte_range saved);
+
+private:
+  struct entry {
+    uint64_t hash;
+    Offset key;
+    Offset value;
+    Offset end;
+  };
+
+  bool candidates(byte_range key, uint64_t &hash, size_t &from,
+                  size_t &to) const;
+  bool key_matches(size_t i, byte_range key) const;
+  byte_range value(size_t i) const {
+    return {base + entries[i].value, base + entries[i].end};
+  }
+
+  const unsigned char *base = nullptr;
+  uint64_t length = 0;
+  std::vector<entry> entries;
+};
+
+} // namespace msgpack
+
+#endif
@@ -0,0 +1,126 @@
+#include "catch.hpp"
+#include "msgpack.h"
+#include "msgpack_compare.h"
+#include "msgpack_map_index.h"
+#include "msgpack_test_util.h"
+#include "msgpack_traits.h"
+
+#include <string>
+#include <vector>
+
+using namespace msgpack;
+
+namespace {
+// map16 of N pairs "k<i>" -> i, every third key written as str16 and the
+// keys "k0" to "k9" appearing twice
+std::vector<unsigned char> wide_map(uint64_t N) {
+  std::vector<unsigned char> res = {0xde, (unsigned char)((N + 10) >> 8),
+                                    (unsigned char)(N + 10)};
+  auto key = [&](uint64_t i) {
+    std::string k = "k" + std::to_string(i);
+    if (i % 3 == 0) {
+      res.push_back(0xda);
+      res.push_back(0);
+      res.push_back((unsigned char)k.size());
+      res.insert(res.end(), k.begin(), k.end());
+    } else {
+      std::vector<unsigned char> e = encode(k);
+      res.insert(res.end(), e.begin(), e.end());
+    }
+  };
+  for (uint64_t i = 0; i < N; i++) {
+    key(i);
+    std::vector<unsigned char> v = encode(i);
+    res.insert(res.end(), v.begin(), v.end());
+  }
+  for (uint64_t i = 0; i < 10; i++) {
+    key(i);
+    std::vector<unsigned char> v = encode(N + i);
+    res.insert(res.end(), v.begin(), v.end());
+  }
+  return res;
+}
+
+byte_range linear_find(byte_range map, byte_range key) {
+  byte_range found = {nullptr, nullptr};
+  foreach_map(map, [&](byte_range k, byte_range v) {
+    if (!found.start && equal(k, key)) {
+      found = v;
+    }
+  });
+  return found;
+}
+
+template <typename Offset> void check_wide_map() {
+  const uint64_t N = 3000;
+  std::vector<unsigned char> doc = wide_map(N);
+  map_index<Offset> index;
+  REQUIRE(index.build(range(doc)));
+  CHECK(index.size() == N + 10);
+
+  for (uint64_t i = 0; i < N + 5; i++) {
+    std::vector<unsigned char> key = encode("k" + std::to_string(i));
+    byte_range expect = linear_find(range(doc), range(key));
+    byte_range got = index.find(range(key));
+    CHECK(got.start == expect.start);
+    CHECK(got.end == expect.end);
+  }
+
+  std::vector<uint64_t> values;
+  std::vector<unsigned char> k4 = encode(std::string("k4"));
+  CHECK(index.find_all(range(k4), [&](byte_range v) {
+    uint64_t x = 0;
+    foronly_unsigned(v, [&](uint64_t u) { x = u; });
+    values.push_back(x);
+  }) == 2);
+  CHECK(values == std::vector<uint64_t>{4, N + 4});
+
+  std::vector<unsigned char> saved;
+  index.save(saved);
+  map_index<Offset> restored;
+  REQUIRE(restored.load(range(doc), range(saved)));
+  CHECK(restored.find("k2999").start == index.find("k2999").start);
+  CHECK(restored.find("absent").start == nullptr);
+
+  // Truncated, reordered or out of bounds saves are rejected
+  std::vector<unsigned char> bad(saved.begin(), saved.end() - 1);
+  CHECK(!restored.load(range(doc), range(bad)));
+  CHECK(restored.size() == 0);
+  bad = saved;
+  std::swap_ranges(bad.begin() + 32, bad.begin() + 40, bad.end() - 8 -
+                                                           3 * sizeof(Offset));
+  CHECK(!restored.load(range(doc), range(bad)));
+  CHECK(!restored.load({doc.data(), doc.data() + doc.size() / 2},
+                       range(saved)));
+}
+} // namespace
+
+TEST_CASE("map_index wide map") {
+  check_wide_map<uint32_t>();
+  check_wide_map<uint64_t>();
+}
+
+TEST_CASE("map_index kernel map") {
+  byte_range doc = sample();
+  map_index<uint32_t> top;
+  REQUIRE(top.build(doc));
+  byte_range kernels = top.find("amdhsa.kernels");
+  REQUIRE(kernels.start != nullptr);
+
+  foreach_array(kernels, [&](byte_range kernel) {
+    map_index<uint32_t> index;
+    REQUIRE(index.build(kernel));
+    foreach_map(kernel, [&](byte_range key, byte_range value) {
+      CHECK(index.find(key).start == linear_find(kernel, key).start);
+      CHECK(equal(index.find(key), value));
+    });
+  });
+
+  std::vector<unsigned char> array = {0x91, 0x01};
+  map_index<uint64_t> index;
+  CHECK(!index.build(range(array)));
+  std::vector<unsigned char> empty = {0x80};
+  REQUIRE(index.build(range(empty)));
+  CHECK(index.size() == 0);
+  CHECK(index.find("x").start == nullptr);
+}
@@ -0,0 +1,599 @@
+#include "msgpack_parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace {
+// Messages handed to a pool task at a time. Amortises the task overhead
+// without starving the workers at the start of the scan.
+const size_t batch_size = 256;
+
+const unsigned char *skip(const unsigned char *start,
+                          const unsigned char *end) {
+  return msgpack::fallback::skip_number_contiguous_messages(1, start, end);
+}
+
+// Number of elements (keys and values for a map) and the start of the payload
+bool container_header(msgpack::byte_range bytes, uint64_t *elements,
+                      const unsigned char **payload) {
+  using namespace msgpack;
+  if (bytes.start == bytes.end) {
+    return false;
+  }
+  const msgpack::type ty = parse_type(*bytes.start);
+  const coarse_type cty = categorize(ty);
+  if (cty != msgpack::array && cty != msgpack::map) {
+    return false;
+  }
+  const uint64_t header = bytes_used_fixed(ty);
+  if ((uint64_t)(bytes.end - bytes.start) < header) {
+    return false;
+  }
+  const uint64_t N = payload_info(ty)(bytes.start);
+  *elements = (cty == msgpack::map) ? 2 * N : N;
+  *payload = bytes.start + header;
+  return true;
+}
+
+// Offsets of a chain of messages from the first candidate position in
+// [from, chunk_end) that parses all the way to chunk_end. Messages may not
+// extend past limit, which bounds the cost of a candidate that reads as the
+// header of some enormous container. Empty if no candidate succeeds.
+const unsigned max_candidates = 64;
+template <typename Offset>
+void speculate(const unsigned char *base, const unsigned char *from,
+               const unsigned char *chunk_end, const unsigned char *limit,
+               std::vector<Offset> &chain) {
+  for (unsigned attempt = 0; attempt < max_candidates; attempt++) {
+    const unsigned char *p = from + attempt;
+    if (p >= chunk_end) {
+      break;
+    }
+    chain.clear();
+    chain.push_back(p - base);
+    while (p && p < chunk_end) {
+      p = skip(p, limit);
+      if (p) {
+        chain.push_back(p - base);
+      }
+    }
+    if (p) {
+      return;
+    }
+  }
+  chain.clear();
+}
+
+// A unit of work for the shared pool, calling run(job, lo, hi). What lo and
+// hi mean is up to run, which may push further tasks.
+struct pool_task {
+  void (*run)(void *, uint64_t, uint64_t);
+  void *job;
+  uint64_t lo;
+  uint64_t hi;
+};
+
+// The owner pushes and pops at the back, thieves take from the front where
+// the oldest and so largest ranges are
+class work_deque {
+public:
+  void push(const pool_task &t) {
+    std::lock_guard<std::mutex> lock(mutex);
+    tasks.push_back(t);
+  }
+
+  bool pop(pool_task &t) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (tasks.empty()) {
+      return false;
+    }
+    t = tasks.back();
+    tasks.pop_back();
+    return true;
+  }
+
+  bool steal(pool_task &t) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (tasks.empty()) {
+      return false;
+    }
+    t = tasks.front();
+    tasks.pop_front();
+    return true;
+  }
+
+private:
+  std::mutex mutex;
+  std::deque<pool_task> tasks;
+};
+
+// Deque of the calling thread. Slot 0 is shared by every thread outside the
+// pool.
+thread_local unsigned pool_slot = 0;
+
+// Work stealing pool shared by every parallel call in the process, started on
+// first use with one thread fewer than the hardware concurrency. A thread
+// waiting on a job runs queued tasks until the job is done, so the caller
+// takes part and a nested call from inside a task adds its tasks to the same
+// pool rather than starting threads of its own.
+class task_pool {
+public:
+  static task_pool &instance() {
+    static task_pool pool(msgpack::detail::default_thread_count() - 1);
+    return pool;
+  }
+
+  ~task_pool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &t : workers) {
+      t.join();
+    }
+  }
+
+  void push(const pool_task &t) {
+    deques[pool_slot]->push(t);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      queued++;
+    }
+    wake.notify_one();
+  }
+
+  // Runs queued tasks, those of the calling thread first, until remaining is
+  // zero. Sleeps while there is nothing to run.
+  void help_until(const std::atomic<uint64_t> &remaining) {
+    pool_task t;
+    while (remaining.load() != 0) {
+      if (take(t)) {
+        t.run(t.job, t.lo, t.hi);
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(mutex);
+      wake.wait(lock,
+                [&] { return queued.load() > 0 || remaining.load() == 0; });
+    }
+  }
+
+  // Called by a task after it releases a counter someone may be waiting on.
+  // The task's job may already be gone, so this only touches the pool.
+  void finished() {
+    { std::lock_guard<std::mutex> lock(mutex); }
+    wake.notify_all();
+  }
+
+private:
+  explicit task_pool(unsigned threads) {
+    for (unsigned w = 0; w <= threads; w++) {
+      deques.emplace_back(new work_deque);
+    }
+    for (unsigned w = 1; w <= threads; w++) {
+      workers.emplace_back(&task_pool::worker, this, w);
+    }
+  }
+
+  bool take(pool_task &t) {
+    const size_t n = deques.size();
+    bool found = deques[pool_slot]->pop(t);
+    for (size_t k = 1; k < n && !found; k++) {
+      found = deques[(pool_slot + k) % n]->steal(t);
+    }
+    if (found) {
+      queued--;
+    }
+    return found;
+  }
+
+  void worker(unsigned slot) {
+    pool_slot = slot;
+    pool_task t;
+    for (;;) {
+      if (take(t)) {
+        t.run(t.job, t.lo, t.hi);
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(mutex);
+      wake.wait(lock, [&] { return queued.load() > 0 || stopping; });
+      if (stopping) {
+        return;
+      }
+    }
+  }
+
+  std::vector<std::unique_ptr<work_deque>> deques;
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wake;
+  // Signed as a task can be taken before the push that queued it is counted
+  std::atomic<int64_t> queued{0};
+  bool stopping = false;
+};
+
+// Ranges spanning fewer bytes than this are run instead of split further
+const uint64_t grain_bytes = UINT64_C(16) << 10;
+
+// Narrow offsets can only index the first max() bytes. Clipping the range
+// makes a container that extends past that fail to parse.
+template <typename Offset>
+msgpack::byte_range clip(msgpack::byte_range bytes) {
+  static_assert(std::is_same<Offset, uint32_t>::value ||
+                    std::is_same<Offset, uint64_t>::value,
+                "Offsets are uint32_t or uint64_t");
+  const uint64_t limit = std::numeric_limits<Offset>::max();
+  if ((uint64_t)(bytes.end - bytes.start) > limit) {
+    bytes.end = bytes.start + limit;
+  }
+  return bytes;
+}
+
+// Batches of messages for parallel_messages. Task lo is the slot of the
+// batch, which is busy until the task has visited it.
+struct messages_job {
+  messages_job(size_t slots, msgpack::detail::parallel_visit_t visit,
+               void *context)
+      : batches(slots), busy(slots), visit(visit), context(context),
+        outstanding(0) {}
+
+  static void run(void *self, uint64_t slot, uint64_t) {
+    messages_job &job = *static_cast<messages_job *>(self);
+    for (msgpack::byte_range message : job.batches[slot]) {
+      job.visit(job.context, message);
+    }
+    job.busy[slot] = 0;
+    job.outstanding--;
+    task_pool::instance().finished();
+  }
+
+  std::vector<std::vector<msgpack::byte_range>> batches;
+  std::vector<std::atomic<uint64_t>> busy;
+  msgpack::detail::parallel_visit_t visit;
+  void *context;
+  std::atomic<uint64_t> outstanding;
+};
+
+// Speculative parse of chunk lo for index_elements_parallel
+template <typename Offset> struct speculate_job {
+  speculate_job(const unsigned char *base, const unsigned char *end,
+                const std::vector<const unsigned char *> &bounds,
+                uint64_t chunk, std::vector<std::vector<Offset>> &chains)
+      : base(base), end(end), bounds(bounds), chunk(chunk), chains(chains),
+        remaining(bounds.size() - 2) {}
+
+  static void run(void *self, uint64_t t, uint64_t) {
+    speculate_job &job = *static_cast<speculate_job *>(self);
+    const unsigned char *next = job.bounds[t + 1];
+    const unsigned char *limit =
+        ((uint64_t)(job.end - next) > job.chunk) ? next + job.chunk : job.end;
+    speculate<Offset>(job.base, job.bounds[t], next, limit, job.chains[t]);
+    if (--job.remaining == 0) {
+      task_pool::instance().finished();
+    }
+  }
+
+  const unsigned char *base;
+  const unsigned char *end;
+  const std::vector<const unsigned char *> &bounds;
+  uint64_t chunk;
+  std::vector<std::vector<Offset>> &chains;
+  std::atomic<uint64_t> remaining;
+};
+
+// Range of units [lo, hi) for parallel_for_units, unit u spanning bytes
+// offsets[u * stride] to offsets[(u + 1) * stride]. Ranges are pushed to the
+// pool for at most threads - 1 helpers at once.
+template <typename Offset> struct units_job {
+  units_job(const Offset *offsets, uint64_t N, uint64_t stride,
+            unsigned threads, msgpack::detail::parallel_body_t body,
+            void *context)
+      : offsets(offsets), stride(stride), body(body), context(context),
+        max_helpers(threads - 1), helpers(0), remaining(N) {}
+
+  uint64_t byte_offset(uint64_t unit) const { return offsets[unit * stride]; }
+
+  // First unit starting at or after the given byte offset, within (lo, hi)
+  uint64_t unit_at(uint64_t lo, uint64_t hi, uint64_t target) const {
+    while (lo + 1 < hi) {
+      uint64_t mid = lo + (hi - lo) / 2;
+      if (byte_offset(mid) < target) {
+        lo = mid;
+      } else {
+        hi = mid;
+      }
+    }
+    return hi;
+  }
+
+  // Reserves a helper for a range about to be pushed
+  bool claim_helper() {
+    unsigned n = helpers.load();
+    while (n < max_helpers) {
+      if (helpers.compare_exchange_weak(n, n + 1)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Runs the units of [lo, hi) that are not pushed for a helper, returning
+  // how many that was
+  uint64_t run_range(uint64_t lo, uint64_t hi) {
+    task_pool &pool = task_pool::instance();
+    uint64_t u = lo;
+    while (u < hi) {
+      // Split at the byte midpoint while a helper is free, leaving the upper
+      // half to be stolen
+      while (hi - u > 1 && byte_offset(hi) - byte_offset(u) > grain_bytes &&
+             claim_helper()) {
+        uint64_t mid = (byte_offset(u) + byte_offset(hi)) / 2;
+        uint64_t m = unit_at(u, hi, mid);
+        // A large final unit is split off on its own
+        m = (m == hi) ? hi - 1 : m;
+        pool.push({run, this, m, hi});
+        hi = m;
+      }
+      body(context, u++);
+    }
+    return hi - lo;
+  }
+
+  static void run(void *self, uint64_t lo, uint64_t hi) {
+    units_job &job = *static_cast<units_job *>(self);
+    const uint64_t ran = job.run_range(lo, hi);
+    job.helpers--;
+    job.finish(ran);
+  }
+
+  void finish(uint64_t ran) {
+    if (remaining.fetch_sub(ran) == ran) {
+      task_pool::instance().finished();
+    }
+  }
+
+  const Offset *offsets;
+  uint64_t stride;
+  msgpack::detail::parallel_body_t body;
+  void *context;
+  const unsigned max_helpers;
+  std::atomic<unsigned> helpers;
+  std::atomic<uint64_t> remaining;
+};
+} // namespace
+
+namespace msgpack {
+namespace detail {
+
+unsigned default_thread_count() {
+  unsigned n = std::thread::hardware_concurrency();
+  return n == 0 ? 1 : n;
+}
+
+const unsigned char *parallel_messages(byte_range bytes, unsigned threads,
+                                       parallel_visit_t visit, void *context) {
+  if (threads == 0) {
+    threads = default_thread_count();
+  }
+
+  const unsigned char *start = bytes.start;
+  if (threads == 1) {
+    while (start != bytes.end) {
+      const unsigned char *next =
+          fallback::skip_number_contiguous_messages(1, start, bytes.end);
+      if (!next) {
+        break;
+      }
+      visit(context, {start, next});
+      start = next;
+    }
+    return start;
+  }
+
+  // At most threads - 1 batches are in flight, one per helper, so with a slot
+  // for the batch being filled there is always a free one
+  task_pool &pool = task_pool::instance();
+  const size_t slots = threads;
+  messages_job job(slots, visit, context);
+  size_t slot = 0;
+
+  auto claim = [&]() -> std::vector<byte_range> & {
+    while (job.busy[slot] != 0) {
+      slot = (slot + 1) % slots;
+    }
+    job.batches[slot].clear();
+    job.batches[slot].reserve(batch_size);
+    return job.batches[slot];
+  };
+  // With every helper busy the scan visits the batch itself
+  auto submit = [&]() {
+    if (job.outstanding.load() >= threads - 1) {
+      for (byte_range message : job.batches[slot]) {
+        visit(context, message);
+      }
+      return;
+    }
+    job.busy[slot] = 1;
+    job.outstanding++;
+    pool.push({messages_job::run, &job, slot, 0});
+    slot = (slot + 1) % slots;
+  };
+
+  std::vector<byte_range> *batch = &claim();
+  while (start != bytes.end) {
+    const unsigned char *next =
+        fallback::skip_number_contiguous_messages(1, start, bytes.end);
+    if (!next) {
+      break;
+    }
+    batch->push_back({start, next});
+    start = next;
+
+    if (batch->size() == batch_size) {
+      submit();
+      batch = &claim();
+    }
+  }
+
+  if (!batch->empty()) {
+    submit();
+  }
+  pool.help_until(job.outstanding);
+  return start;
+}
+
+template <typename Offset>
+bool index_elements_parallel(byte_range bytes, std::vector<Offset> &offsets,
+                             unsigned threads, uint64_t min_chunk) {
+  bytes = clip<Offset>(bytes);
+  uint64_t elements;
+  const unsigned char *payload;
+  if (!container_header(bytes, &elements, &payload)) {
+    return false;
+  }
+
+  if (threads == 0) {
+    threads = default_thread_count();
+  }
+  const uint64_t payload_bytes = bytes.end - payload;
+  if (threads == 1 || payload_bytes / threads < min_chunk) {
+    return index_elements(bytes, offsets);
+  }
+
+  const uint64_t chunk = payload_bytes / threads;
+  std::vector<const unsigned char *> bounds(threads + 1);
+  for (unsigned t = 0; t < threads; t++) {
+    bounds[t] = payload + t * chunk;
+  }
+  bounds[threads] = bytes.end;
+
+  std::vector<std::vector<Offset>> chains(threads);
+  speculate_job<Offset> job(bytes.start, bytes.end, bounds, chunk, chains);
+  task_pool &pool = task_pool::instance();
+  for (unsigned t = 1; t < threads; t++) {
+    pool.push({speculate_job<Offset>::run, &job, t, 0});
+  }
+
+  // The first chunk is parsed from the true start while the others speculate,
+  // so at most threads threads work on the call
+  const uint64_t target = elements + 1;
+  offsets.clear();
+  offsets.push_back(payload - bytes.start);
+  const unsigned char *q = payload;
+  while (q < bounds[1] && offsets.size() < target) {
+    q = skip(q, bytes.end);
+    if (!q) {
+      break;
+    }
+    offsets.push_back(q - bytes.start);
+  }
+
+  pool.help_until(job.remaining);
+  if (!q) {
+    return false;
+  }
+
+  // Stitch each chunk onto the true chain. Parsing is deterministic, so once
+  // the true chain lands on a boundary of a speculative chain the rest of
+  // that chain is also true. Until then, step the true chain serially.
+  for (unsigned t = 1; t < threads && offsets.size() < target; t++) {
+    const std::vector<Offset> &spec = chains[t];
+    size_t j = 0;
+    while (offsets.size() < target && q < bounds[t + 1]) {
+      const uint64_t at = q - bytes.start;
+      while (j < spec.size() && spec[j] < at) {
+        j++;
+      }
+      if (j < spec.size() && spec[j] == at) {
+        uint64_t take = std::min<uint64_t>(spec.size() - (j + 1),
+                                           target - offsets.size());
+        offsets.insert(offsets.end(), spec.begin() + j + 1,
+                       spec.begin() + j + 1 + take);
+        q = bytes.start + offsets.back();
+        break;
+      }
+
+      q = skip(q, bytes.end);
+      if (!q) {
+        return false;
+      }
+      offsets.push_back(q - bytes.start);
+    }
+  }
+
+  return offsets.size() == target;
+}
+
+template <typename Offset>
+void parallel_for_units(const Offset *offsets, uint64_t N, uint64_t stride,
+                        unsigned threads, parallel_body_t body, void *context) {
+  if (N == 0) {
+    return;
+  }
+  if (threads == 0) {
+    threads = default_thread_count();
+  }
+
+  // Work too small to split is not worth waking the pool for
+  units_job<Offset> job(offsets, N, stride, threads, body, context);
+  if (threads == 1 || N == 1 ||
+      job.byte_offset(N) - job.byte_offset(0) <= grain_bytes) {
+    for (uint64_t u = 0; u < N; u++) {
+      body(context, u);
+    }
+    return;
+  }
+
+  job.finish(job.run_range(0, N));
+  task_pool::instance().help_until(job.remaining);
+}
+
+template bool index_elements_parallel(byte_range, std::vector<uint32_t> &,
+                                      unsigned, uint64_t);
+template bool index_elements_parallel(byte_range, std::vector<uint64_t> &,
+                                      unsigned, uint64_t);
+template void parallel_for_units(const uint32_t *, uint64_t, uint64_t,
+                                 unsigned, parallel_body_t, void *);
+template void parallel_for_units(const uint64_t *, uint64_t, uint64_t,
+                                 unsigned, parallel_body_t, void *);
+
+} // namespace detail
+
+template <typename Offset>
+bool index_elements(byte_range bytes, std::vector<Offset> &offsets) {
+  bytes = clip<Offset>(bytes);
+  uint64_t elements;
+  const unsigned char *payload;
+  if (!container_header(bytes, &elements, &payload)) {
+    return false;
+  }
+
+  // Every element is at least one byte, so a corrupt count can't force a
+  // huge allocation
+  offsets.clear();
+  offsets.reserve(std::min<uint64_t>(elements, bytes.end - payload) + 1);
+  offsets.push_back(payload - bytes.start);
+
+  const unsigned char *q = payload;
+  for (uint64_t i = 0; i < elements; i++) {
+    q = skip(q, bytes.end);
+    if (!q) {
+      return false;
+    }
+    offsets.push_back(q - bytes.start);
+  }
+  return true;
+}
+
+template bool index_elements(byte_range, std::vector<uint32_t> &);
+template bool index_elements(byte_range, std::vector<uint64_t> &);
+
+} // namespace msgpack
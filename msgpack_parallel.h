@@ -0,0 +1,180 @@
+#ifndef MSGPACK_PARALLEL_H
+#define MSGPACK_PARALLEL_H
+
+#include "msgpack.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace msgpack {
+
+namespace detail {
+// Type erased driver. The calling thread finds message boundaries with a skip
+// only pass and hands batches of them to the shared pool, which calls
+// visit(context, message) while the scan continues. At most threads - 1
+// batches are in flight, past that the scan visits batches itself, so no more
+// than threads threads visit at once. threads == 0 picks the hardware
+// concurrency, threads == 1 visits each message on the calling thread.
+// Returns one past the last message found, bytes.end if the whole range was
+// well formed.
+typedef void (*parallel_visit_t)(void *, byte_range);
+const unsigned char *parallel_messages(byte_range bytes, unsigned threads,
+                                       parallel_visit_t visit, void *context);
+
+unsigned default_thread_count();
+
+template <typename Offset>
+bool index_elements_parallel(byte_range bytes, std::vector<Offset> &offsets,
+                             unsigned threads, uint64_t min_chunk);
+
+// Work stealing loop over N units, unit u spanning bytes offsets[u * stride]
+// to offsets[(u + 1) * stride], run on the shared pool with the calling
+// thread helping. Ranges of units are split at their byte midpoint until
+// below a grain size, so a few large children end up in tasks of their own
+// instead of serialising the tail of the loop. At most threads - 1 split off
+// ranges are outstanding at once, past that ranges are run where they are.
+// threads == 1, or units too small to split, run on the calling thread.
+typedef void (*parallel_body_t)(void *, uint64_t);
+template <typename Offset>
+void parallel_for_units(const Offset *offsets, uint64_t N, uint64_t stride,
+                        unsigned threads, parallel_body_t body, void *context);
+
+inline bool fits_compact_offsets(byte_range bytes) {
+  return (uint64_t)(bytes.end - bytes.start) <= UINT32_MAX;
+}
+} // namespace detail
+
+// Parallel equivalent of calling handle_msgpack(message, f) on each of the
+// back to back top level messages in bytes. As with handle_msgpack, f is
+// passed by value to each call. Messages are visited concurrently and in no
+// particular order, so state shared through references in f must be thread
+// safe. At most threads threads, the caller included, visit messages at once.
+// threads == 0 picks the hardware concurrency.
+// Returns one past the last message visited, which is bytes.end unless the
+// range ends in a malformed or truncated message.
+template <typename F>
+const unsigned char *parallel_handle_msgpack(byte_range bytes, F f,
+                                             unsigned threads = 0) {
+  struct context {
+    static void visit(void *self, byte_range message) {
+      handle_msgpack_void(message, static_cast<context *>(self)->f);
+    }
+    F f;
+  };
+
+  context ctx = {f};
+  return detail::parallel_messages(bytes, threads, context::visit, &ctx);
+}
+
+// Element boundaries of the array or map message at bytes.start. On success
+// offsets holds the offset from bytes.start of each element, followed by one
+// past the end of the last element, so element i is [offsets[i],
+// offsets[i+1]). For a map the elements alternate key, value. Returns false
+// if bytes does not start with a well formed array or map.
+//
+// Offset is uint64_t or uint32_t. The compact uint32_t form halves the size
+// of the index, which for containers of millions of small elements is the
+// difference between it fitting in cache or not. It only reaches the first
+// 4GiB of bytes, so fails for containers extending past that.
+template <typename Offset>
+bool index_elements(byte_range bytes, std::vector<Offset> &offsets);
+
+// As index_elements, splitting the payload across threads. Each thread parses
+// its chunk speculatively from the first offset in it that yields a chain of
+// messages reaching the next chunk. The chains are then stitched onto the
+// true chain from the container header; a chunk whose speculation does not
+// meet the true chain is reparsed serially from the true boundary, so the
+// result always equals that of index_elements.
+template <typename Offset>
+bool index_elements_parallel(byte_range bytes, std::vector<Offset> &offsets,
+                             unsigned threads = 0) {
+  return detail::index_elements_parallel(bytes, offsets, threads,
+                                         UINT64_C(1) << 20);
+}
+
+namespace detail {
+template <typename Offset, typename C>
+void parallel_foreach_array(byte_range bytes, C &callback, unsigned threads) {
+  std::vector<Offset> offsets;
+  if (!is_array(bytes) ||
+      !msgpack::index_elements_parallel(bytes, offsets, threads)) {
+    foreach_array(bytes, callback);
+    return;
+  }
+
+  struct context {
+    static void body(void *self, uint64_t i) {
+      context &ctx = *static_cast<context *>(self);
+      ctx.callback(byte_range{ctx.bytes.start + ctx.offsets[i], ctx.bytes.end});
+    }
+    C &callback;
+    byte_range bytes;
+    const std::vector<Offset> &offsets;
+  };
+
+  context ctx = {callback, bytes, offsets};
+  parallel_for_units(offsets.data(), offsets.size() - 1, 1, threads,
+                     context::body, &ctx);
+}
+
+template <typename Offset, typename C>
+void parallel_foreach_map(byte_range bytes, C &callback, unsigned threads) {
+  std::vector<Offset> offsets;
+  if (!is_map(bytes) ||
+      !msgpack::index_elements_parallel(bytes, offsets, threads)) {
+    foreach_map(bytes, callback);
+    return;
+  }
+
+  struct context {
+    static void body(void *self, uint64_t i) {
+      context &ctx = *static_cast<context *>(self);
+      const unsigned char *base = ctx.bytes.start;
+      const Offset *pair = ctx.offsets.data() + 2 * i;
+      ctx.callback(byte_range{base + pair[0], base + pair[1]},
+                   byte_range{base + pair[1], base + pair[2]});
+    }
+    C &callback;
+    byte_range bytes;
+    const std::vector<Offset> &offsets;
+  };
+
+  context ctx = {callback, bytes, offsets};
+  parallel_for_units(offsets.data(), (offsets.size() - 1) / 2, 2, threads,
+                     context::body, &ctx);
+}
+} // namespace detail
+
+// Parallel equivalents of foreach_array and foreach_map. The callback is
+// invoked concurrently, in no particular order, from a work stealing pool
+// shared by every parallel call and sized by the hardware concurrency. At
+// most threads threads, the caller included, run callbacks of one call at
+// once; threads == 1 runs serially and threads == 0 allows the whole pool.
+// Elements are not split internally. A callback that calls these again on a
+// large child adds the child's elements to the same pool, under the cap
+// passed to that call, without starting any more threads.
+// Element boundaries come from index_elements_parallel, using compact offsets
+// for messages under 4GiB. If the message is not a well formed array (or
+// map), these fall back to the serial version.
+template <typename C>
+void parallel_foreach_array(byte_range bytes, C callback,
+                            unsigned threads = 0) {
+  if (detail::fits_compact_offsets(bytes)) {
+    detail::parallel_foreach_array<uint32_t>(bytes, callback, threads);
+  } else {
+    detail::parallel_foreach_array<uint64_t>(bytes, callback, threads);
+  }
+}
+
+template <typename C>
+void parallel_foreach_map(byte_range bytes, C callback, unsigned threads = 0) {
+  if (detail::fits_compact_offsets(bytes)) {
+    detail::parallel_foreach_map<uint32_t>(bytes, callback, threads);
+  } else {
+    detail::parallel_foreach_map<uint64_t>(bytes, callback, threads);
+  }
+}
+
+} // namespace msgpack
+
+#endif
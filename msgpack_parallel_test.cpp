@@ -0,0 +1,364 @@
+#include "catch.hpp"
+#include "msgpack.h"
+#include "msgpack_encode.h"
+#include "msgpack_parallel.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace msgpack;
+
+namespace {
+// Sums every unsigned integer in a message, including nested ones
+struct functors_sum : functors_defaults<functors_sum> {
+  functors_sum(std::atomic<uint64_t> &sum, std::atomic<uint64_t> &messages)
+      : sum(sum), messages(messages) {}
+  std::atomic<uint64_t> &sum;
+  std::atomic<uint64_t> &messages;
+
+  const unsigned char *handle_array(uint64_t N, byte_range bytes) {
+    messages++;
+    uint64_t local = 0;
+    for (uint64_t i = 0; i < N; i++) {
+      foronly_unsigned(bytes, [&](uint64_t x) { local += x; });
+      bytes.start = fallback::skip_next_message(bytes.start, bytes.end);
+      if (!bytes.start) {
+        return nullptr;
+      }
+    }
+    sum += local;
+    return bytes.start;
+  }
+};
+
+std::vector<unsigned char> concatenated_arrays(uint32_t N) {
+  std::vector<unsigned char> res;
+  for (uint32_t i = 0; i < N; i++) {
+    std::vector<uint32_t> values(i % 19, i);
+    std::vector<unsigned char> tmp(encode_array_bound<uint32_t>(values.size()));
+    unsigned char *r = encode_array(values.data(), values.size(), tmp.data(),
+                                    tmp.data() + tmp.size());
+    res.insert(res.end(), tmp.data(), r);
+  }
+  return res;
+}
+
+// Highest number of threads inside visit() at once
+struct concurrency {
+  std::atomic<unsigned> active{0};
+  std::atomic<unsigned> peak{0};
+
+  void visit() {
+    unsigned n = ++active;
+    unsigned p = peak.load();
+    while (n > p && !peak.compare_exchange_weak(p, n)) {
+    }
+    std::this_thread::yield();
+    active--;
+  }
+
+  static void visit_message(void *self, byte_range) {
+    static_cast<concurrency *>(self)->visit();
+  }
+};
+
+uint64_t expected_sum(uint32_t N) {
+  uint64_t sum = 0;
+  for (uint32_t i = 0; i < N; i++) {
+    sum += (uint64_t)(i % 19) * i;
+  }
+  return sum;
+}
+} // namespace
+
+TEST_CASE("parallel_handle_msgpack") {
+  const uint32_t N = 20000;
+  std::vector<unsigned char> bytes = concatenated_arrays(N);
+  const unsigned char *start = bytes.data();
+  const unsigned char *end = bytes.data() + bytes.size();
+
+  for (unsigned threads : {0u, 1u, 2u, 7u}) {
+    std::atomic<uint64_t> sum(0);
+    std::atomic<uint64_t> messages(0);
+    const unsigned char *r = parallel_handle_msgpack(
+        {start, end}, functors_sum(sum, messages), threads);
+    CHECK(r == end);
+    CHECK(messages == N);
+    CHECK(sum == expected_sum(N));
+  }
+
+  SECTION("truncated tail") {
+    bytes.push_back(0x93);
+    bytes.push_back(0x01);
+    std::atomic<uint64_t> sum(0);
+    std::atomic<uint64_t> messages(0);
+    const unsigned char *r = parallel_handle_msgpack(
+        {bytes.data(), bytes.data() + bytes.size()},
+        functors_sum(sum, messages), 3);
+    CHECK(r == bytes.data() + bytes.size() - 2);
+    CHECK(messages == N);
+  }
+
+  SECTION("threads caps concurrency") {
+    concurrency c;
+    CHECK(detail::parallel_messages({start, end}, 2, concurrency::visit_message,
+                                    &c) == end);
+    CHECK(c.peak <= 2);
+  }
+
+  SECTION("empty") {
+    std::atomic<uint64_t> sum(0);
+    std::atomic<uint64_t> messages(0);
+    CHECK(parallel_handle_msgpack({start, start}, functors_sum(sum, messages),
+                                  4) == start);
+    CHECK(messages == 0);
+  }
+}
+
+namespace {
+// Elements chosen to contain bytes that read as plausible headers when
+// parsed from the wrong offset
+void append_awkward_element(std::vector<unsigned char> &out, uint32_t i) {
+  switch (i % 6) {
+  case 0:
+    out.push_back((unsigned char)(i % 128));
+    break;
+  case 1: {
+    // str8 whose payload looks like array32 / map32 headers
+    out.push_back(0xd9);
+    out.push_back(10);
+    const unsigned char payload[] = {0xdd, 0xff, 0xff, 0xff, 0xff,
+                                     0xdf, 0x00, 0x10, 0x00, 0x00};
+    out.insert(out.end(), payload, payload + sizeof(payload));
+    break;
+  }
+  case 2: {
+    // nested fixarray of uint16
+    out.push_back(0x93);
+    for (unsigned j = 0; j < 3; j++) {
+      out.push_back(0xcd);
+      out.push_back(0xdc);
+      out.push_back((unsigned char)j);
+    }
+    break;
+  }
+  case 3: {
+    // fixmap {"k": -1}
+    const unsigned char m[] = {0x81, 0xa1, 'k', 0xff};
+    out.insert(out.end(), m, m + sizeof(m));
+    break;
+  }
+  case 4:
+    out.push_back(0xc0);
+    break;
+  case 5: {
+    // bin8 of random looking bytes
+    out.push_back(0xc4);
+    out.push_back(5);
+    for (unsigned j = 0; j < 5; j++) {
+      out.push_back((unsigned char)(i * 37 + j * 101));
+    }
+    break;
+  }
+  }
+}
+
+std::vector<unsigned char> awkward_container(unsigned char tag, uint32_t N) {
+  std::vector<unsigned char> res = {tag, (unsigned char)(N >> 24),
+                                    (unsigned char)(N >> 16),
+                                    (unsigned char)(N >> 8), (unsigned char)N};
+  uint32_t elements = (tag == 0xdf) ? 2 * N : N;
+  for (uint32_t i = 0; i < elements; i++) {
+    append_awkward_element(res, i);
+  }
+  return res;
+}
+} // namespace
+
+TEST_CASE("index_elements_parallel") {
+  for (unsigned char tag : {0xdd, 0xdf}) {
+    std::vector<unsigned char> bytes = awkward_container(tag, 30000);
+    // Trailing messages after the container are not part of it
+    bytes.push_back(0x01);
+    bytes.push_back(0x02);
+    byte_range range = {bytes.data(), bytes.data() + bytes.size()};
+
+    std::vector<uint64_t> expect;
+    REQUIRE(index_elements(range, expect));
+    CHECK(expect.size() == ((tag == 0xdf) ? 60001 : 30001));
+    CHECK(expect.back() == bytes.size() - 2);
+
+    for (unsigned threads : {1u, 2u, 3u, 8u, 61u}) {
+      for (uint64_t min_chunk : {UINT64_C(1), UINT64_C(1000)}) {
+        std::vector<uint64_t> got;
+        CHECK(detail::index_elements_parallel(range, got, threads, min_chunk));
+        CHECK(got == expect);
+      }
+    }
+
+    std::vector<uint64_t> defaulted;
+    CHECK(index_elements_parallel(range, defaulted));
+    CHECK(defaulted == expect);
+
+    // Compact offsets hold the same values in half the space
+    const std::vector<uint32_t> expect32(expect.begin(), expect.end());
+    std::vector<uint32_t> compact;
+    CHECK(index_elements(range, compact));
+    CHECK(compact == expect32);
+    for (unsigned threads : {2u, 8u}) {
+      CHECK(detail::index_elements_parallel(range, compact, threads, 1));
+      CHECK(compact == expect32);
+    }
+
+    SECTION("truncated") {
+      byte_range truncated = {bytes.data(), bytes.data() + bytes.size() - 10};
+      std::vector<uint64_t> got;
+      CHECK(!index_elements(truncated, got));
+      CHECK(!detail::index_elements_parallel(truncated, got, 4, 1));
+      std::vector<uint32_t> compact;
+      CHECK(!index_elements(truncated, compact));
+      CHECK(!detail::index_elements_parallel(truncated, compact, 4, 1));
+    }
+  }
+
+  SECTION("not a container") {
+    const unsigned char scalar[] = {0x01};
+    std::vector<uint64_t> got;
+    CHECK(!index_elements({scalar, scalar + 1}, got));
+    CHECK(!index_elements_parallel({scalar, scalar + 1}, got));
+  }
+}
+
+TEST_CASE("parallel_foreach") {
+  SECTION("array") {
+    // A few large children among many small ones
+    std::vector<unsigned char> bytes = {0xdc, 0x27, 0x10};
+    std::vector<uint64_t> expect(10000);
+    for (uint32_t i = 0; i < 10000; i++) {
+      std::vector<uint32_t> values((i % 1000 == 0) ? 50000 : i % 5, i);
+      std::vector<unsigned char> tmp(
+          encode_array_bound<uint32_t>(values.size()));
+      unsigned char *r = encode_array(values.data(), values.size(), tmp.data(),
+                                      tmp.data() + tmp.size());
+      bytes.insert(bytes.end(), tmp.data(), r);
+      expect[i] = (uint64_t)values.size() * i;
+    }
+    byte_range range = {bytes.data(), bytes.data() + bytes.size()};
+
+    for (unsigned threads : {0u, 1u, 3u, 16u}) {
+      std::vector<std::atomic<uint64_t>> got(expect.size());
+      std::atomic<uint64_t> calls(0);
+      parallel_foreach_array(
+          range,
+          [&](byte_range element) {
+            uint64_t sum = 0, index = 0;
+            foreach_array(element, [&](byte_range value) {
+              foronly_unsigned(value, [&](uint64_t x) {
+                sum += x;
+                index = x;
+              });
+            });
+            got[index] += sum;
+            calls++;
+          },
+          threads);
+      CHECK(calls == expect.size());
+      bool ok = true;
+      for (size_t i = 0; i < expect.size(); i++) {
+        ok &= (got[i] == expect[i]);
+      }
+      CHECK(ok);
+    }
+  }
+
+  SECTION("map") {
+    std::vector<unsigned char> bytes = {0xde, 0x03, 0xe8};
+    for (uint32_t i = 0; i < 1000; i++) {
+      bytes.push_back(0xcd);
+      bytes.push_back((unsigned char)(i >> 8));
+      bytes.push_back((unsigned char)i);
+      bytes.push_back(0xa1);
+      bytes.push_back('a' + i % 26);
+    }
+    byte_range range = {bytes.data(), bytes.data() + bytes.size()};
+
+    std::atomic<uint64_t> keys(0), chars(0), calls(0);
+    parallel_foreach_map(
+        range,
+        [&](byte_range key, byte_range value) {
+          foronly_unsigned(key, [&](uint64_t x) { keys += x; });
+          foronly_string(value, [&](size_t N, const unsigned char *str) {
+            chars += N ? str[0] : 0;
+          });
+          calls++;
+        },
+        4);
+    CHECK(calls == 1000);
+    CHECK(keys == 999 * 1000 / 2);
+    uint64_t expect_chars = 0;
+    for (uint32_t i = 0; i < 1000; i++) {
+      expect_chars += 'a' + i % 26;
+    }
+    CHECK(chars == expect_chars);
+  }
+
+  SECTION("nested") {
+    // Large children are only split by calling in again from the callback
+    std::vector<unsigned char> bytes = {0x94};
+    uint64_t expect = 0;
+    for (uint32_t i = 0; i < 4; i++) {
+      std::vector<uint32_t> values(50000 + i, i + 1);
+      std::vector<unsigned char> tmp(
+          encode_array_bound<uint32_t>(values.size()));
+      unsigned char *r = encode_array(values.data(), values.size(), tmp.data(),
+                                      tmp.data() + tmp.size());
+      bytes.insert(bytes.end(), tmp.data(), r);
+      expect += (uint64_t)values.size() * (i + 1);
+    }
+    byte_range range = {bytes.data(), bytes.data() + bytes.size()};
+
+    std::atomic<uint64_t> sum(0), calls(0);
+    parallel_foreach_array(
+        range,
+        [&](byte_range child) {
+          parallel_foreach_array(
+              child,
+              [&](byte_range value) {
+                foronly_unsigned(value, [&](uint64_t x) { sum += x; });
+                calls++;
+              },
+              4);
+        },
+        4);
+    CHECK(calls == 4 * 50000 + 6);
+    CHECK(sum == expect);
+  }
+
+  SECTION("threads caps concurrency") {
+    std::vector<uint32_t> values(100000, 1);
+    std::vector<unsigned char> bytes(
+        encode_array_bound<uint32_t>(values.size()));
+    bytes.resize(encode_array(values.data(), values.size(), bytes.data(),
+                              bytes.data() + bytes.size()) -
+                 bytes.data());
+
+    for (unsigned threads : {1u, 2u, 3u}) {
+      concurrency c;
+      parallel_foreach_array({bytes.data(), bytes.data() + bytes.size()},
+                             [&](byte_range) { c.visit(); }, threads);
+      CHECK(c.peak <= threads);
+    }
+  }
+
+  SECTION("falls back on malformed input") {
+    const unsigned char truncated[] = {0x93, 0x01, 0x02};
+    std::atomic<uint64_t> calls(0);
+    parallel_foreach_array({truncated, truncated + sizeof(truncated)},
+                           [&](byte_range) { calls++; });
+    uint64_t serial = 0;
+    foreach_array({truncated, truncated + sizeof(truncated)},
+                  [&](byte_range) { serial++; });
+    CHECK(calls == serial);
+  }
+}
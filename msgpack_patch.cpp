@@ -0,0 +1,176 @@
+#include "msgpack_patch.h"
+#include "msgpack_decode.h"
+
+#include <cstring>
+
+namespace {
+using msgpack::byte_range;
+using msgpack::token;
+using msgpack::detail::write_tagged;
+
+// Integer encodings of a given total width. Both return nullptr if x needs
+// more bytes.
+unsigned char *write_unsigned_width(uint64_t x, size_t width,
+                                    unsigned char *out) {
+  switch (width) {
+  case 1:
+    if (x > 127) {
+      return nullptr;
+    }
+    *out = static_cast<unsigned char>(x);
+    return out + 1;
+  case 2:
+    return (x <= UINT8_MAX) ? write_tagged(0xcc, (uint8_t)x, out) : nullptr;
+  case 3:
+    return (x <= UINT16_MAX) ? write_tagged(0xcd, (uint16_t)x, out) : nullptr;
+  case 5:
+    return (x <= UINT32_MAX) ? write_tagged(0xce, (uint32_t)x, out) : nullptr;
+  case 9:
+    return write_tagged(0xcf, x, out);
+  default:
+    return nullptr;
+  }
+}
+
+unsigned char *write_signed_width(int64_t x, size_t width,
+                                  unsigned char *out) {
+  if (x >= 0) {
+    return write_unsigned_width(x, width, out);
+  }
+  switch (width) {
+  case 1:
+    if (x < -32) {
+      return nullptr;
+    }
+    *out = static_cast<unsigned char>(x);
+    return out + 1;
+  case 2:
+    return (x >= INT8_MIN) ? write_tagged(0xd0, (uint8_t)x, out) : nullptr;
+  case 3:
+    return (x >= INT16_MIN) ? write_tagged(0xd1, (uint16_t)x, out) : nullptr;
+  case 5:
+    return (x >= INT32_MIN) ? write_tagged(0xd2, (uint32_t)x, out) : nullptr;
+  case 9:
+    return write_tagged(0xd3, (uint64_t)x, out);
+  default:
+    return nullptr;
+  }
+}
+
+unsigned char *write_double_width(double x, size_t width, unsigned char *out) {
+  if (width == 9) {
+    uint64_t bits;
+    memcpy(&bits, &x, 8);
+    return write_tagged(0xcb, bits, out);
+  }
+
+  // Narrowing is only taken when it round trips, NaN never does
+  float f = static_cast<float>(x);
+  if (width != 5 || static_cast<double>(f) != x) {
+    return nullptr;
+  }
+  uint32_t bits;
+  memcpy(&bits, &f, 4);
+  return write_tagged(0xca, bits, out);
+}
+
+// The target of p within [start, end) and its kind, or nullptr
+unsigned char *locate(unsigned char *start, unsigned char *end,
+                      const msgpack::path &p, token::kind_t &kind,
+                      size_t &width) {
+  byte_range target = msgpack::find({start, end}, p);
+  token t;
+  if (!target.start || !msgpack::read_token(target, t)) {
+    return nullptr;
+  }
+  kind = t.kind;
+  width = target.end - target.start;
+  return start + (target.start - start);
+}
+
+// Builds the replacement in a scratch buffer first so that nothing is
+// written unless it fits
+template <typename W>
+bool overwrite(unsigned char *start, unsigned char *end,
+               const msgpack::path &p, bool integer, W write) {
+  token::kind_t kind;
+  size_t width;
+  unsigned char *at = locate(start, end, p, kind, width);
+  if (!at) {
+    return false;
+  }
+  const bool is_integer =
+      kind == token::unsigned_integer || kind == token::negative_integer;
+  const bool is_float = kind == token::floating;
+  if (integer ? !is_integer : !is_float) {
+    return false;
+  }
+
+  unsigned char scratch[9];
+  unsigned char *written = write(width, scratch);
+  if (!written || (size_t)(written - scratch) != width) {
+    return false;
+  }
+  memcpy(at, scratch, width);
+  return true;
+}
+} // namespace
+
+namespace msgpack {
+
+bool patch_in_place(unsigned char *start, unsigned char *end, const path &p,
+                    uint64_t value) {
+  return overwrite(start, end, p, true,
+                   [=](size_t width, unsigned char *out) {
+                     return write_unsigned_width(value, width, out);
+                   });
+}
+
+bool patch_in_place(unsigned char *start, unsigned char *end, const path &p,
+                    int64_t value) {
+  return overwrite(start, end, p, true,
+                   [=](size_t width, unsigned char *out) {
+                     return write_signed_width(value, width, out);
+                   });
+}
+
+bool patch_in_place(unsigned char *start, unsigned char *end, const path &p,
+                    double value) {
+  return overwrite(start, end, p, false,
+                   [=](size_t width, unsigned char *out) {
+                     return write_double_width(value, width, out);
+                   });
+}
+
+bool patch_in_place(unsigned char *start, unsigned char *end, const path &p,
+                    bool value) {
+  token::kind_t kind;
+  size_t width;
+  unsigned char *at = locate(start, end, p, kind, width);
+  if (!at || kind != token::boolean) {
+    return false;
+  }
+  *at = value ? 0xc3 : 0xc2;
+  return true;
+}
+
+bool patch_copy(byte_range bytes, const path &p, byte_range replacement,
+                std::vector<unsigned char> &out) {
+  byte_range target = find(bytes, p);
+  const unsigned char *replacement_end =
+      fallback::skip_next_message(replacement.start, replacement.end);
+  if (!target.start || !replacement_end) {
+    return false;
+  }
+
+  const size_t prefix = target.start - bytes.start;
+  const size_t middle = replacement_end - replacement.start;
+  const size_t suffix = bytes.end - target.end;
+  out.resize(prefix + middle + suffix);
+  memcpy(out.data(), bytes.start, prefix);
+  memcpy(out.data() + prefix, replacement.start, middle);
+  memcpy(out.data() + prefix + middle, target.end, suffix);
+  return true;
+}
+
+} // namespace msgpack
@@ -0,0 +1,94 @@
+#ifndef MSGPACK_PATCH_H
+#define MSGPACK_PATCH_H
+
+#include "msgpack.h"
+#include "msgpack_path.h"
+#include "msgpack_traits.h"
+
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace msgpack {
+
+// Overwrites the scalar reached by p from the message at start, keeping the
+// number of bytes it occupies. Integers may switch between signed and
+// unsigned encodings of the same width, so a uint8 slot takes -128 to 255.
+// Doubles only go in float slots, and into a float32 only if exact. Returns
+// false, leaving the bytes untouched, if p is missing, the target is of
+// another kind, or value does not fit its width.
+bool patch_in_place(unsigned char *start, unsigned char *end, const path &p,
+                    uint64_t value);
+bool patch_in_place(unsigned char *start, unsigned char *end, const path &p,
+                    int64_t value);
+bool patch_in_place(unsigned char *start, unsigned char *end, const path &p,
+                    double value);
+bool patch_in_place(unsigned char *start, unsigned char *end, const path &p,
+                    bool value);
+
+// Writes to out a copy of bytes with the message reached by p replaced by
+// the message at replacement.start. Arrays and maps record element counts,
+// not byte lengths, so no enclosing header changes: the copy is the prefix,
+// the replacement and the suffix. Returns false if p is missing or either
+// message is malformed.
+bool patch_copy(byte_range bytes, const path &p, byte_range replacement,
+                std::vector<unsigned char> &out);
+
+namespace detail {
+inline bool patch_scalar(unsigned char *start, unsigned char *end,
+                         const path &p, bool value) {
+  return patch_in_place(start, end, p, value);
+}
+
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value,
+                        bool>::type
+patch_scalar(unsigned char *start, unsigned char *end, const path &p, T value) {
+  return patch_in_place(start, end, p, static_cast<int64_t>(value));
+}
+
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value &&
+                            std::is_unsigned<T>::value,
+                        bool>::type
+patch_scalar(unsigned char *start, unsigned char *end, const path &p, T value) {
+  return patch_in_place(start, end, p, static_cast<uint64_t>(value));
+}
+
+template <typename T>
+typename std::enable_if<std::is_floating_point<T>::value, bool>::type
+patch_scalar(unsigned char *start, unsigned char *end, const path &p, T value) {
+  return patch_in_place(start, end, p, static_cast<double>(value));
+}
+
+template <typename T>
+typename std::enable_if<!std::is_arithmetic<T>::value, bool>::type
+patch_scalar(unsigned char *, unsigned char *, const path &, const T &) {
+  return false;
+}
+} // namespace detail
+
+// Sets the value reached by p to value, anything msgpack_traits can encode.
+// Scalars are overwritten in place when they fit, otherwise doc is replaced
+// by a spliced copy. Returns false, leaving doc unchanged, if p is missing.
+template <typename T>
+bool patch(std::vector<unsigned char> &doc, const path &p, const T &value) {
+  unsigned char *start = doc.data();
+  unsigned char *end = doc.data() + doc.size();
+  if (detail::patch_scalar(start, end, p, value)) {
+    return true;
+  }
+
+  std::vector<unsigned char> encoded = encode(value);
+  std::vector<unsigned char> out;
+  if (!patch_copy({start, end}, p,
+                  {encoded.data(), encoded.data() + encoded.size()}, out)) {
+    return false;
+  }
+  doc.swap(out);
+  return true;
+}
+
+} // namespace msgpack
+
+#endif
@@ -0,0 +1,119 @@
+#include "catch.hpp"
+#include "msgpack.h"
+#include "msgpack_compare.h"
+#include "msgpack_decode.h"
+#include "msgpack_patch.h"
+#include "msgpack_test_util.h"
+
+#include <string>
+#include <vector>
+
+using namespace msgpack;
+
+namespace {
+path group_segment(uint64_t kernel) {
+  return {path_element::key("amdhsa.kernels"), path_element::index(kernel),
+          path_element::key(".group_segment_fixed_size")};
+}
+
+uint64_t read_unsigned(const std::vector<unsigned char> &doc, const path &p) {
+  uint64_t x = UINT64_MAX;
+  byte_range at = find(range(doc), p);
+  REQUIRE(at.start != nullptr);
+  REQUIRE(decode(at, x));
+  return x;
+}
+} // namespace
+
+TEST_CASE("patch_in_place widths") {
+  typedef std::vector<unsigned char> bytes;
+  const path first = {path_element::index(0)};
+
+  // [uint8 7]
+  bytes doc = {0x91, 0xcc, 0x07};
+  CHECK(patch_in_place(doc.data(), doc.data() + doc.size(), first,
+                       (uint64_t)200));
+  CHECK(doc == bytes{0x91, 0xcc, 200});
+  CHECK(patch_in_place(doc.data(), doc.data() + doc.size(), first,
+                       (int64_t)-100));
+  CHECK(doc == bytes{0x91, 0xd0, 0x9c});
+  CHECK(!patch_in_place(doc.data(), doc.data() + doc.size(), first,
+                        (uint64_t)256));
+  CHECK(!patch_in_place(doc.data(), doc.data() + doc.size(), first, 1.0));
+  CHECK(!patch_in_place(doc.data(), doc.data() + doc.size(), first, true));
+  CHECK(doc == bytes{0x91, 0xd0, 0x9c});
+
+  // [fixint, float32, bool]
+  doc = {0x93, 0x01, 0xca, 0, 0, 0, 0, 0xc2};
+  CHECK(patch_in_place(doc.data(), doc.data() + doc.size(), first,
+                       (int64_t)-32));
+  CHECK(!patch_in_place(doc.data(), doc.data() + doc.size(), first,
+                        (int64_t)-33));
+  CHECK(patch_in_place(doc.data(), doc.data() + doc.size(),
+                       {path_element::index(1)}, 1.5));
+  CHECK(!patch_in_place(doc.data(), doc.data() + doc.size(),
+                        {path_element::index(1)}, 0.1));
+  CHECK(patch_in_place(doc.data(), doc.data() + doc.size(),
+                       {path_element::index(2)}, true));
+  CHECK(doc == bytes{0x93, 0xe0, 0xca, 0x3f, 0xc0, 0, 0, 0xc3});
+
+  CHECK(!patch_in_place(doc.data(), doc.data() + doc.size(),
+                        {path_element::index(3)}, (uint64_t)0));
+}
+
+TEST_CASE("patch manykernels") {
+  const std::vector<unsigned char> original(sample().start, sample().end);
+  std::vector<unsigned char> doc = original;
+  const path p = group_segment(3);
+  const uint64_t before = read_unsigned(doc, p);
+  const byte_range slot = find(range(doc), p);
+  const size_t width = slot.end - slot.start;
+
+  SECTION("fits in place") {
+    const unsigned char *data = doc.data();
+    CHECK(patch(doc, p, before + 1));
+    CHECK(doc.data() == data);
+    CHECK(doc.size() == original.size());
+    CHECK(read_unsigned(doc, p) == before + 1);
+  }
+
+  SECTION("spliced when wider") {
+    const uint64_t wide = UINT64_C(1) << 40;
+    CHECK(patch(doc, p, wide));
+    CHECK(doc.size() == original.size() + 9 - width);
+    CHECK(read_unsigned(doc, p) == wide);
+  }
+
+  SECTION("spliced with another type") {
+    CHECK(patch(doc, p, std::string("large")));
+    std::string s;
+    REQUIRE(decode(find(range(doc), p), s));
+    CHECK(s == "large");
+  }
+
+  // Only the patched value differs, every other kernel is intact
+  std::vector<difference> out;
+  REQUIRE(diff(range(original), range(doc), out));
+  if (doc != original) {
+    REQUIRE(out.size() == 1);
+    CHECK(to_string(out[0].where) == to_string(p));
+  }
+
+  CHECK(!patch(doc, group_segment(100000), 1));
+  CHECK(!patch(doc, {path_element::key("missing")}, std::string("x")));
+}
+
+TEST_CASE("patch_copy") {
+  typedef std::vector<unsigned char> bytes;
+  // {"a": [1, 2], "b": 3} with [1, 2] replaced by "xyz"
+  bytes doc = {0x82, 0xa1, 'a', 0x92, 0x01, 0x02, 0xa1, 'b', 0x03};
+  bytes replacement = {0xa3, 'x', 'y', 'z'};
+  bytes out;
+  CHECK(patch_copy(range(doc), {path_element::key("a")}, range(replacement),
+                   out));
+  CHECK(out == bytes{0x82, 0xa1, 'a', 0xa3, 'x', 'y', 'z', 0xa1, 'b', 0x03});
+
+  bytes truncated = {0xa3, 'x'};
+  CHECK(!patch_copy(range(doc), {path_element::key("a")}, range(truncated),
+                    out));
+}
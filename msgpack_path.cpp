@@ -0,0 +1,124 @@
+#include "msgpack_path.h"
+#include "msgpack_compare.h"
+#include "msgpack_decode.h"
+#include "msgpack_traits.h"
+
+#include <cinttypes>
+#include <cstdio>
+
+namespace msgpack {
+
+path_element path_element::index(uint64_t i) {
+  path_element res;
+  res.position = i;
+  return res;
+}
+
+path_element path_element::key(const std::string &name) {
+  path_element res;
+  res.encoded_key = encode(name);
+  return res;
+}
+
+path_element path_element::key_message(byte_range key) {
+  const unsigned char *end = fallback::skip_next_message(key.start, key.end);
+  path_element res;
+  res.encoded_key.assign(key.start, end ? end : key.end);
+  return res;
+}
+
+std::string to_string(const path &p) {
+  std::string res;
+  for (const path_element &e : p) {
+    char tmp[32];
+    if (e.is_index()) {
+      snprintf(tmp, sizeof(tmp), "[%" PRIu64 "]", e.position);
+      res += tmp;
+      continue;
+    }
+
+    token t;
+    const byte_range key = {e.encoded_key.data(),
+                            e.encoded_key.data() + e.encoded_key.size()};
+    const unsigned char *next = read_token(key, t);
+    if (next && t.kind == token::string) {
+      res += "[\"";
+      for (const unsigned char *c = t.payload.start; c != t.payload.end; c++) {
+        if (*c == '"' || *c == '\\') {
+          res.push_back('\\');
+        }
+        res.push_back(*c);
+      }
+      res += "\"]";
+    } else if (next && t.kind == token::unsigned_integer) {
+      snprintf(tmp, sizeof(tmp), "[%" PRIu64 "]", t.value);
+      res += tmp;
+    } else if (next && t.kind == token::negative_integer) {
+      snprintf(tmp, sizeof(tmp), "[%" PRId64 "]", (int64_t)t.value);
+      res += tmp;
+    } else {
+      res += "[#";
+      for (unsigned char c : e.encoded_key) {
+        snprintf(tmp, sizeof(tmp), "%02x", c);
+        res += tmp;
+      }
+      res += "]";
+    }
+  }
+  return res;
+}
+
+byte_range find(byte_range bytes, const path &p) {
+  const byte_range missing = {nullptr, nullptr};
+  byte_range at = bytes;
+
+  for (const path_element &e : p) {
+    token t;
+    const unsigned char *q = read_token(at, t);
+    if (!q) {
+      return missing;
+    }
+
+    if (e.is_index()) {
+      if (t.kind != token::array || e.position >= t.value) {
+        return missing;
+      }
+      q = fallback::skip_number_contiguous_messages(e.position, q, at.end);
+      if (!q) {
+        return missing;
+      }
+      at.start = q;
+      continue;
+    }
+
+    if (t.kind != token::map) {
+      return missing;
+    }
+    const byte_range key = {e.encoded_key.data(),
+                            e.encoded_key.data() + e.encoded_key.size()};
+    bool found = false;
+    for (uint64_t i = 0; i < t.value && !found; i++) {
+      const unsigned char *key_end = fallback::skip_next_message(q, at.end);
+      if (!key_end) {
+        return missing;
+      }
+      if (equal({q, key_end}, key)) {
+        at.start = key_end;
+        found = true;
+      } else {
+        q = fallback::skip_next_message(key_end, at.end);
+        if (!q) {
+          return missing;
+        }
+      }
+    }
+    if (!found) {
+      return missing;
+    }
+  }
+
+  const unsigned char *end = fallback::skip_next_message(at.start, at.end);
+  return end ? byte_range{at.start, end} : missing;
+}
+
+} // namespace msgpack
@@ -0,0 +1,39 @@
+#ifndef MSGPACK_PATH_H
+#define MSGPACK_PATH_H
+
+#include "msgpack.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace msgpack {
+
+// One step into a container: an array index or a map key. Keys are held as
+// an encoded message and matched by value, so key("name") finds the key
+// whether it was written as fixstr or str16, and integer keys work too.
+struct path_element {
+  static path_element index(uint64_t i);
+  static path_element key(const std::string &name);
+  static path_element key_message(byte_range key);
+
+  bool is_index() const { return encoded_key.empty(); }
+
+  uint64_t position = 0;
+  std::vector<unsigned char> encoded_key;
+};
+
+typedef std::vector<path_element> path;
+
+// Renders as ["amdhsa.kernels"][3][".name"]. Integer keys are written as
+// numbers, other non-string keys as the hex of their encoding.
+std::string to_string(const path &p);
+
+// The message reached by following p from the message at bytes.start, e.g.
+// the value of the first matching key. Returns {nullptr, nullptr} if a step
+// is missing or the bytes are malformed.
+byte_range find(byte_range bytes, const path &p);
+
+} // namespace msgpack
+
+#endif
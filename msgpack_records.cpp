@@ -0,0 +1,186 @@
+#include "msgpack_records.h"
+
+#include <cstring>
+
+namespace {
+const unsigned char index_magic[msgpack::record_index_header_bytes] = {
+    'M', 'P', 'K', 'R', 'I', 'D', 'X', '1'};
+
+uint32_t read_frame(const unsigned char *from) {
+  return (uint32_t)from[0] << 24 | (uint32_t)from[1] << 16 |
+         (uint32_t)from[2] << 8 | (uint32_t)from[3];
+}
+
+void write_frame(uint32_t N, unsigned char *to) {
+  for (unsigned i = 0; i < 4; i++) {
+    to[i] = (unsigned char)(N >> (24 - 8 * i));
+  }
+}
+
+uint64_t read_index_entry(const unsigned char *from) {
+  uint64_t res = 0;
+  for (unsigned i = 0; i < 8; i++) {
+    res |= (uint64_t)from[i] << (8 * i);
+  }
+  return res;
+}
+
+void write_index_entry(uint64_t offset, unsigned char *to) {
+  for (unsigned i = 0; i < 8; i++) {
+    to[i] = (unsigned char)(offset >> (8 * i));
+  }
+}
+
+bool write_all(FILE *f, const void *data, size_t N) {
+  return fwrite(data, 1, N, f) == N;
+}
+} // namespace
+
+namespace msgpack {
+
+record_writer::record_writer(FILE *records, FILE *index, uint64_t offset)
+    : records(records), index(index), offset(offset),
+      index_header_written(offset != 0) {}
+
+bool record_writer::append(byte_range message) {
+  const uint64_t N = message.end - message.start;
+  if (N > UINT32_MAX ||
+      fallback::skip_next_message(message.start, message.end) != message.end) {
+    return false;
+  }
+
+  // The record goes first, so that a failed write never leaves an index
+  // entry for a record that is not there
+  unsigned char frame[record_frame_bytes];
+  write_frame((uint32_t)N, frame);
+  if (!write_all(records, &frame, sizeof(frame)) ||
+      !write_all(records, message.start, N)) {
+    return false;
+  }
+  const uint64_t at = offset;
+  offset += record_frame_bytes + N;
+  records_written++;
+
+  if (index && !index_failed) {
+    if (!index_header_written) {
+      if (!write_all(index, index_magic, sizeof(index_magic))) {
+        index_failed = true;
+        return false;
+      }
+      index_header_written = true;
+    }
+    unsigned char entry[8];
+    write_index_entry(at, entry);
+    if (!write_all(index, entry, sizeof(entry))) {
+      index_failed = true;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool write_record_index(byte_range records, FILE *index) {
+  if (!write_all(index, index_magic, sizeof(index_magic))) {
+    return false;
+  }
+
+  record_cursor cursor(records);
+  byte_range message;
+  while (cursor.next(&message)) {
+    unsigned char entry[8];
+    write_index_entry((message.start - record_frame_bytes) - records.start,
+                      entry);
+    if (!write_all(index, entry, sizeof(entry))) {
+      return false;
+    }
+  }
+  return cursor.at_end();
+}
+
+bool record_cursor::next(byte_range *message) {
+  const uint64_t available = end - position;
+  if (available < record_frame_bytes) {
+    return false;
+  }
+  const uint64_t N = read_frame(position);
+  if (available - record_frame_bytes < N) {
+    return false;
+  }
+  *message = {position + record_frame_bytes, position + record_frame_bytes + N};
+  position = message->end;
+  return true;
+}
+
+record_reader::record_reader(byte_range records, byte_range index)
+    : records(records) {
+  const uint64_t available = index.end - index.start;
+  if (available < record_index_header_bytes ||
+      memcmp(index.start, index_magic, sizeof(index_magic)) != 0 ||
+      (available - record_index_header_bytes) % 8 != 0) {
+    return;
+  }
+
+  index_entries = index.start + record_index_header_bytes;
+  index_count = (available - record_index_header_bytes) / 8;
+
+  // A stale index, e.g. for a longer stream or left short by a failed
+  // append, is worse than none. Each entry must be where the previous
+  // record's frame ends and the last record must end the stream.
+  const unsigned char *expect = records.start;
+  bool stale = false;
+  for (uint64_t i = 0; i < index_count; i++) {
+    byte_range message;
+    if (read_index_entry(index_entries + 8 * i) !=
+            (uint64_t)(expect - records.start) ||
+        !record_cursor({expect, records.end}).next(&message)) {
+      stale = true;
+      break;
+    }
+    expect = message.end;
+  }
+  if (stale || expect != records.end) {
+    index_entries = nullptr;
+    index_count = 0;
+  }
+}
+
+uint64_t record_reader::size() const {
+  if (has_index()) {
+    return index_count;
+  }
+  uint64_t count = 0;
+  record_cursor cursor(records);
+  byte_range message;
+  while (cursor.next(&message)) {
+    count++;
+  }
+  return count;
+}
+
+bool record_reader::frame_at(uint64_t offset, byte_range *message) const {
+  const uint64_t available = records.end - records.start;
+  if (offset > available) {
+    return false;
+  }
+  record_cursor cursor({records.start + offset, records.end});
+  return cursor.next(message);
+}
+
+bool record_reader::get(uint64_t N, byte_range *message) const {
+  if (has_index()) {
+    if (N >= index_count) {
+      return false;
+    }
+    return frame_at(read_index_entry(index_entries + 8 * N), message);
+  }
+
+  record_cursor cursor(records);
+  for (uint64_t i = 0; i <= N; i++) {
+    if (!cursor.next(message)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace msgpack
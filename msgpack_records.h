@@ -0,0 +1,96 @@
+#ifndef MSGPACK_RECORDS_H
+#define MSGPACK_RECORDS_H
+
+#include "msgpack.h"
+
+#include <cstdint>
+#include <cstdio>
+
+namespace msgpack {
+// Container format for archives of top level messages.
+//
+// Record stream: each record is [length][message] where length is the size of
+// the message in bytes as a big endian uint32. Streams can be concatenated.
+//
+// Sidecar index: the eight byte magic "MPKRIDX1" followed by one little
+// endian uint64 per record, the offset of that record's length field in the
+// stream. Designed to be used in place from a mapped_file.
+
+const uint64_t record_frame_bytes = 4;
+const uint64_t record_index_header_bytes = 8;
+
+class record_writer {
+public:
+  // index may be null if no sidecar is wanted. To append to an existing
+  // stream, offset is its size in bytes and index, if any, appends to its
+  // existing sidecar.
+  record_writer(FILE *records, FILE *index = nullptr, uint64_t offset = 0);
+
+  // Appends a record holding exactly one message. Returns false if the range
+  // is not a single well formed message or on a write error. The record is
+  // written before its index entry, so a failed index write leaves the
+  // record appended and counted. No further index entries are written after
+  // one fails, the sidecar is left short and record_reader ignores it.
+  bool append(byte_range message);
+
+  uint64_t count() const { return records_written; }
+
+  // False once an index write has failed
+  bool index_valid() const { return !index_failed; }
+
+private:
+  FILE *records;
+  FILE *index;
+  uint64_t offset;
+  uint64_t records_written = 0;
+  bool index_header_written;
+  bool index_failed = false;
+};
+
+// Writes a sidecar index for an existing record stream. Returns false if the
+// stream is malformed or on a write error.
+bool write_record_index(byte_range records, FILE *index);
+
+// Sequential walk over the records, reading only the length frames
+class record_cursor {
+public:
+  record_cursor(byte_range records) : position(records.start), end(records.end) {}
+
+  // Sets *message to the next record and returns true, or returns false at
+  // the end of the stream or on a truncated frame
+  bool next(byte_range *message);
+  bool at_end() const { return position == end; }
+
+private:
+  const unsigned char *position;
+  const unsigned char *end;
+};
+
+class record_reader {
+public:
+  // The index is optional. One that is malformed or does not fit the stream is
+  // ignored, lookups then walk the length frames. Checking the fit reads
+  // every length frame once.
+  record_reader(byte_range records, byte_range index = {nullptr, nullptr});
+
+  bool has_index() const { return index_entries != nullptr; }
+
+  // Number of records. O(1) with an index.
+  uint64_t size() const;
+
+  // Sets *message to record N. O(1) with an index.
+  bool get(uint64_t N, byte_range *message) const;
+
+  record_cursor begin() const { return record_cursor(records); }
+
+private:
+  bool frame_at(uint64_t offset, byte_range *message) const;
+
+  byte_range records;
+  const unsigned char *index_entries = nullptr;
+  uint64_t index_count = 0;
+};
+
+} // namespace msgpack
+
+#endif
@@ -0,0 +1,228 @@
+#include "catch.hpp"
+#include "msgpack.h"
+#include "msgpack_encode.h"
+#include "msgpack_records.h"
+#include "msgpack_test_util.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+using namespace msgpack;
+
+namespace {
+std::vector<unsigned char> contents(FILE *f) {
+  std::vector<unsigned char> res;
+  rewind(f);
+  unsigned char buf[4096];
+  size_t r;
+  while ((r = fread(buf, 1, sizeof(buf), f)) != 0) {
+    res.insert(res.end(), buf, buf + r);
+  }
+  return res;
+}
+
+std::vector<std::vector<unsigned char>> example_messages(uint32_t N) {
+  std::vector<std::vector<unsigned char>> res;
+  for (uint32_t i = 0; i < N; i++) {
+    std::vector<uint32_t> values(i % 37, i * 1000);
+    std::vector<unsigned char> tmp(encode_array_bound<uint32_t>(values.size()));
+    unsigned char *r = encode_array(values.data(), values.size(), tmp.data(),
+                                    tmp.data() + tmp.size());
+    tmp.resize(r - tmp.data());
+    res.push_back(tmp);
+  }
+  return res;
+}
+
+bool same(byte_range x, const std::vector<unsigned char> &y) {
+  return (uint64_t)(x.end - x.start) == y.size() &&
+         std::equal(y.begin(), y.end(), x.start);
+}
+} // namespace
+
+TEST_CASE("record stream") {
+  std::vector<std::vector<unsigned char>> messages = example_messages(500);
+
+  FILE *records = tmpfile();
+  FILE *index = tmpfile();
+  REQUIRE(records);
+  REQUIRE(index);
+
+  record_writer writer(records, index);
+  for (auto &m : messages) {
+    CHECK(writer.append(range(m)));
+  }
+  CHECK(writer.count() == messages.size());
+
+  SECTION("rejects anything but one message") {
+    const unsigned char two[] = {0x01, 0x02};
+    const unsigned char truncated[] = {0x92, 0x01};
+    CHECK(!writer.append({two, two + 2}));
+    CHECK(!writer.append({truncated, truncated + 2}));
+    CHECK(!writer.append({two, two}));
+    CHECK(writer.count() == messages.size());
+  }
+
+  std::vector<unsigned char> stream = contents(records);
+  std::vector<unsigned char> sidecar = contents(index);
+  fclose(records);
+  fclose(index);
+
+  CHECK(sidecar.size() == record_index_header_bytes + 8 * messages.size());
+
+  SECTION("byte order") {
+    // Big endian frame, little endian index entries
+    const uint64_t second = record_frame_bytes + messages[0].size();
+    CHECK(std::vector<unsigned char>(stream.begin(), stream.begin() + 4) ==
+          std::vector<unsigned char>({0, 0, 0, (unsigned char)(second - 4)}));
+    const unsigned char *entry = sidecar.data() + record_index_header_bytes + 8;
+    CHECK(std::vector<unsigned char>(entry, entry + 8) ==
+          std::vector<unsigned char>({(unsigned char)second, 0, 0, 0, 0, 0, 0,
+                                      0}));
+  }
+
+  SECTION("rebuilt index matches") {
+    FILE *rebuilt = tmpfile();
+    CHECK(write_record_index(range(stream), rebuilt));
+    CHECK(contents(rebuilt) == sidecar);
+    fclose(rebuilt);
+  }
+
+  SECTION("sequential") {
+    record_cursor cursor(range(stream));
+    byte_range message;
+    uint64_t count = 0;
+    bool ok = true;
+    while (cursor.next(&message)) {
+      ok &= same(message, messages[count]);
+      count++;
+    }
+    CHECK(ok);
+    CHECK(count == messages.size());
+    CHECK(cursor.at_end());
+  }
+
+  SECTION("random access") {
+    record_reader with(range(stream), range(sidecar));
+    record_reader without(range(stream));
+    CHECK(with.has_index());
+    CHECK(!without.has_index());
+
+    for (const record_reader *reader : {&with, &without}) {
+      CHECK(reader->size() == messages.size());
+      bool ok = true;
+      for (uint64_t i = 0; i < messages.size(); i += 7) {
+        byte_range message;
+        ok &= reader->get(i, &message);
+        ok &= same(message, messages[i]);
+      }
+      CHECK(ok);
+      byte_range message;
+      CHECK(!reader->get(messages.size(), &message));
+    }
+  }
+
+  SECTION("stale index is ignored") {
+    std::vector<unsigned char> shorter(stream.begin(), stream.end() - 1);
+    record_reader reader(range(shorter), range(sidecar));
+    CHECK(!reader.has_index());
+    CHECK(reader.size() == messages.size() - 1);
+
+    // As left by an append whose index write failed
+    std::vector<unsigned char> short_index(sidecar.begin(), sidecar.end() - 8);
+    CHECK(!record_reader(range(stream), range(short_index)).has_index());
+    short_index.resize(record_index_header_bytes);
+    CHECK(!record_reader(range(stream), range(short_index)).has_index());
+    CHECK(record_reader({nullptr, nullptr}, range(short_index)).has_index());
+
+    std::vector<unsigned char> bad = sidecar;
+    bad[0] = 'X';
+    CHECK(!record_reader(range(stream), range(bad)).has_index());
+  }
+}
+
+TEST_CASE("shifted record index") {
+  // Records at 0, 5 and 10 with the entry for 5 missing
+  const unsigned char stream[] = {0, 0, 0, 1, 0x01, 0, 0, 0, 1,
+                                  0x02, 0, 0, 0, 1, 0x03};
+  std::vector<unsigned char> index = {'M', 'P', 'K', 'R', 'I', 'D', 'X', '1'};
+  for (unsigned char at : {0, 10}) {
+    index.insert(index.end(), {at, 0, 0, 0, 0, 0, 0, 0});
+  }
+
+  record_reader reader({stream, stream + sizeof(stream)}, range(index));
+  CHECK(!reader.has_index());
+  CHECK(reader.size() == 3);
+  byte_range message;
+  REQUIRE(reader.get(1, &message));
+  CHECK(*message.start == 0x02);
+
+  index.insert(index.begin() + record_index_header_bytes + 8,
+               {5, 0, 0, 0, 0, 0, 0, 0});
+  CHECK(record_reader({stream, stream + sizeof(stream)}, range(index))
+            .has_index());
+}
+
+TEST_CASE("record stream append") {
+  std::vector<std::vector<unsigned char>> messages = example_messages(20);
+  FILE *records = tmpfile();
+  FILE *index = tmpfile();
+  REQUIRE(records);
+  REQUIRE(index);
+
+  record_writer first(records, index);
+  for (size_t i = 0; i < 10; i++) {
+    CHECK(first.append(range(messages[i])));
+  }
+  fseek(records, 0, SEEK_END);
+  fseek(index, 0, SEEK_END);
+  record_writer second(records, index, ftell(records));
+  for (size_t i = 10; i < messages.size(); i++) {
+    CHECK(second.append(range(messages[i])));
+  }
+
+  std::vector<unsigned char> stream = contents(records);
+  std::vector<unsigned char> sidecar = contents(index);
+  fclose(records);
+  fclose(index);
+
+  record_reader reader(range(stream), range(sidecar));
+  CHECK(reader.has_index());
+  REQUIRE(reader.size() == messages.size());
+  bool ok = true;
+  for (uint64_t i = 0; i < messages.size(); i++) {
+    byte_range message;
+    ok &= reader.get(i, &message) && same(message, messages[i]);
+  }
+  CHECK(ok);
+}
+
+TEST_CASE("record index write failure") {
+  std::vector<std::vector<unsigned char>> messages = example_messages(2);
+  FILE *records = tmpfile();
+  FILE *index = fopen("/dev/null", "r");
+  REQUIRE(records);
+  REQUIRE(index);
+
+  // The record lands even though its index entry can't be written, later
+  // appends write records only
+  record_writer writer(records, index);
+  CHECK(!writer.append(range(messages[1])));
+  CHECK(writer.count() == 1);
+  CHECK(!writer.index_valid());
+  CHECK(writer.append(range(messages[0])));
+  CHECK(writer.count() == 2);
+
+  std::vector<unsigned char> stream = contents(records);
+  fclose(records);
+  fclose(index);
+
+  record_reader reader(range(stream));
+  CHECK(reader.size() == 2);
+  byte_range message;
+  REQUIRE(reader.get(0, &message));
+  CHECK(same(message, messages[1]));
+  REQUIRE(reader.get(1, &message));
+  CHECK(same(message, messages[0]));
+}
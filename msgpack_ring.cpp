@@ -0,0 +1,278 @@
+#include "msgpack_ring.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+#include <poll.h>
+#include <unistd.h>
+
+namespace {
+size_t round_up_pow2(size_t x) {
+  size_t r = 1;
+  while (r < x) {
+    r <<= 1;
+  }
+  return r;
+}
+
+// How long the reader waits for input before checking whether the ring has
+// been closed
+const int poll_ms = 50;
+
+// Rounds of yielding before a side with nothing to do goes to sleep
+const unsigned spin_limit = 64;
+
+struct reader {
+  int fd;
+  msgpack::byte_ring &ring;
+  bool failed;
+
+  void operator()() {
+    while (!ring.closed()) {
+      unsigned char *p;
+      const size_t space = ring.writable(&p);
+      if (space == 0) {
+        ring.wait_writable();
+        continue;
+      }
+
+      struct pollfd pfd = {fd, POLLIN, 0};
+      const int ready = poll(&pfd, 1, poll_ms);
+      if (ready == 0 || (ready < 0 && errno == EINTR)) {
+        continue;
+      }
+
+      const ssize_t n = (ready < 0) ? -1 : read(fd, p, space);
+      if (n > 0) {
+        ring.commit(n);
+        continue;
+      }
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      failed = n < 0;
+      break;
+    }
+    ring.close();
+  }
+};
+
+// Skips one message that may arrive in pieces. The offset reached and the
+// number of messages still to skip, counting container elements, are kept
+// between calls, so no byte is looked at twice however often it resumes.
+struct partial_skip {
+  uint64_t offset = 0;
+  uint64_t remaining = 1;
+
+  bool started() const { return offset != 0 || remaining != 1; }
+
+  // Continues through bytes [start, start + available). Returns true once the
+  // message is complete, offset then being its length. Otherwise sets *need
+  // to the number of bytes from start it needs to get any further.
+  bool resume(const unsigned char *start, uint64_t available, uint64_t *need) {
+    using namespace msgpack;
+    while (remaining != 0) {
+      if (offset == available) {
+        *need = offset + 1;
+        return false;
+      }
+      const msgpack::type ty = parse_type(start[offset]);
+      const uint64_t header = bytes_used_fixed(ty);
+      if (available - offset < header) {
+        *need = offset + header;
+        return false;
+      }
+      const uint64_t N = payload_info(ty)(start + offset);
+      const coarse_type cty = categorize(ty);
+      // Only strings, bin and ext carry a payload, other reads give zero
+      const uint64_t size =
+          header + ((cty == msgpack::string || cty == msgpack::other) ? N : 0);
+      if (available - offset < size) {
+        *need = offset + size;
+        return false;
+      }
+      offset += size;
+      remaining--;
+      if (cty == msgpack::array) {
+        remaining += N;
+      } else if (cty == msgpack::map) {
+        remaining += 2 * N;
+      }
+    }
+    return true;
+  }
+};
+} // namespace
+
+namespace msgpack {
+
+byte_ring::byte_ring(size_t capacity)
+    : data(round_up_pow2(capacity < 2 ? 2 : capacity)),
+      mask(data.size() - 1) {}
+
+size_t byte_ring::writable(unsigned char **out) {
+  const uint64_t h = head.load(std::memory_order_relaxed);
+  const uint64_t t = tail.load(std::memory_order_acquire);
+  const size_t at = h & mask;
+  const size_t free = capacity() - (h - t);
+  const size_t to_end = capacity() - at;
+  *out = data.data() + at;
+  return free < to_end ? free : to_end;
+}
+
+void byte_ring::commit(size_t N) {
+  head.store(head.load(std::memory_order_relaxed) + N,
+             std::memory_order_release);
+  wake();
+}
+
+void byte_ring::close() {
+  is_closed.store(true, std::memory_order_release);
+  wake();
+}
+
+// The fences order each side's store before its load of the other's, so
+// either the sleeper sees the moved position or the mover sees the sleeper
+template <typename P> void byte_ring::wait(P ready) const {
+  for (unsigned i = 0; i < spin_limit; i++) {
+    if (ready()) {
+      return;
+    }
+    std::this_thread::yield();
+  }
+
+  sleepers.fetch_add(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  {
+    std::unique_lock<std::mutex> lock(sleep_mutex);
+    moved.wait(lock, ready);
+  }
+  sleepers.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void byte_ring::wait_writable() const {
+  wait([this] {
+    return head.load(std::memory_order_relaxed) -
+                   tail.load(std::memory_order_acquire) <
+               capacity() ||
+           closed();
+  });
+}
+
+void byte_ring::wait_readable(size_t N) const {
+  wait([this, N] { return available() >= N || closed(); });
+}
+
+void byte_ring::wake() const {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (sleepers.load(std::memory_order_relaxed) != 0) {
+    { std::lock_guard<std::mutex> lock(sleep_mutex); }
+    moved.notify_all();
+  }
+}
+
+size_t byte_ring::available() const {
+  return head.load(std::memory_order_acquire) -
+         tail.load(std::memory_order_relaxed);
+}
+
+size_t byte_ring::readable(const unsigned char **out) const {
+  const uint64_t t = tail.load(std::memory_order_relaxed);
+  const size_t avail = head.load(std::memory_order_acquire) - t;
+  const size_t at = t & mask;
+  const size_t to_end = capacity() - at;
+  *out = data.data() + at;
+  return avail < to_end ? avail : to_end;
+}
+
+void byte_ring::peek(unsigned char *out, size_t from, size_t N) const {
+  const size_t at = (tail.load(std::memory_order_relaxed) + from) & mask;
+  const size_t first = (capacity() - at) < N ? (capacity() - at) : N;
+  memcpy(out, data.data() + at, first);
+  memcpy(out + first, data.data(), N - first);
+}
+
+void byte_ring::release(size_t N) {
+  tail.store(tail.load(std::memory_order_relaxed) + N,
+             std::memory_order_release);
+  wake();
+}
+
+namespace detail {
+
+bool ingest(int fd, size_t ring_bytes, ring_visit_t visit, void *context) {
+  byte_ring ring(ring_bytes);
+  reader r = {fd, ring, false};
+  std::thread io(std::ref(r));
+
+  // Copy of a message straddling the wrap, holding its first bytes
+  std::vector<unsigned char> scratch;
+  // Progress through a message found incomplete
+  partial_skip scan;
+  // Bytes needed at the read position before there is more to look at
+  uint64_t need = 1;
+  bool ok = true;
+
+  while (true) {
+    // Checked before available, so that no bytes can be committed after the
+    // last look at them
+    const bool closed = ring.closed();
+    const size_t avail = ring.available();
+    if (avail < need) {
+      if (closed) {
+        ok = (avail == 0) && !r.failed;
+        break;
+      }
+      if (need > ring.capacity()) {
+        ok = false;
+        break;
+      }
+      ring.wait_readable(need);
+      continue;
+    }
+
+    const unsigned char *p;
+    const size_t contiguous = ring.readable(&p);
+    if (!scan.started()) {
+      const unsigned char *end =
+          fallback::skip_next_message(p, p + contiguous);
+      if (end) {
+        visit(context, {p, end});
+        ring.release(end - p);
+        continue;
+      }
+    }
+
+    // Incomplete, or straddling the wrap. The scan resumes in place until it
+    // needs bytes past the wrap, then in scratch, which at least doubles each
+    // time it grows so that the copies add up to a few times the message.
+    const unsigned char *base = p;
+    uint64_t have = contiguous;
+    if (!scratch.empty() || need > contiguous) {
+      const size_t copied = scratch.size();
+      uint64_t want = std::max<uint64_t>(need, 2 * copied);
+      want = std::min<uint64_t>(std::max<uint64_t>(want, 4096), avail);
+      scratch.resize(want);
+      ring.peek(scratch.data() + copied, copied, want - copied);
+      base = scratch.data();
+      have = want;
+    }
+
+    if (scan.resume(base, have, &need)) {
+      visit(context, {base, base + scan.offset});
+      ring.release(scan.offset);
+      scan = partial_skip();
+      scratch.clear();
+      need = 1;
+    }
+  }
+
+  ring.close();
+  io.join();
+  return ok;
+}
+
+} // namespace detail
+} // namespace msgpack
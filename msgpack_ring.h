@@ -0,0 +1,114 @@
+#ifndef MSGPACK_RING_H
+#define MSGPACK_RING_H
+
+#include "msgpack.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace msgpack {
+
+// Lock free single producer, single consumer ring of bytes. The producer
+// writes into the contiguous free span at the write position and commits
+// it, the consumer reads the contiguous span at the read position and
+// releases what it has used. Positions are running byte counts, each written
+// by one side only, published with release stores and read with acquire
+// loads.
+//
+// A side with nothing to do can wait for the other. It spins briefly, then
+// sleeps until the other side moves its position or the ring is closed.
+class byte_ring {
+public:
+  // Rounded up to a power of two
+  explicit byte_ring(size_t capacity);
+
+  size_t capacity() const { return mask + 1; }
+
+  // Producer side. Sets *out to the free bytes at the write position, up to
+  // the end of the buffer, and returns how many there are.
+  size_t writable(unsigned char **out);
+  void commit(size_t N);
+
+  // Waits until some bytes are free or the ring is closed
+  void wait_writable() const;
+
+  // No more bytes will be committed. Either side may close the ring, the
+  // consumer to stop a producer that is waiting for space.
+  void close();
+
+  // Consumer side. Sets *out to the bytes at the read position, up to the
+  // end of the buffer, and returns how many there are.
+  size_t readable(const unsigned char **out) const;
+
+  // All committed bytes not yet released, including those past the wrap
+  size_t available() const;
+
+  // Waits until at least N bytes are available or the ring is closed
+  void wait_readable(size_t N) const;
+
+  // Copies N available bytes, starting from the from'th, to out, joining the
+  // two sides of the wrap
+  void peek(unsigned char *out, size_t from, size_t N) const;
+  void release(size_t N);
+
+  // True once close has been called. Bytes committed before it are
+  // available to a consumer that has seen it.
+  bool closed() const { return is_closed.load(std::memory_order_acquire); }
+
+private:
+  template <typename P> void wait(P ready) const;
+  void wake() const;
+
+  std::vector<unsigned char> data;
+  size_t mask;
+
+  // Apart, so the two sides don't share a cache line
+  alignas(64) std::atomic<uint64_t> head{0};
+  alignas(64) std::atomic<uint64_t> tail{0};
+  alignas(64) std::atomic<bool> is_closed{false};
+
+  // Threads asleep in wait, only woken when there are any
+  mutable std::atomic<unsigned> sleepers{0};
+  mutable std::mutex sleep_mutex;
+  mutable std::condition_variable moved;
+};
+
+namespace detail {
+typedef void (*ring_visit_t)(void *, byte_range);
+bool ingest(int fd, size_t ring_bytes, ring_visit_t visit, void *context);
+} // namespace detail
+
+// Reads the stream of back to back top level messages from fd on a thread of
+// its own, through a byte_ring of ring_bytes, and calls on_message(message)
+// on the calling thread for each complete one, in order. Blocking reads stay
+// off the calling thread. The ranges are only valid during the call.
+//
+// Messages are handed out in place from the ring. One that straddles the
+// wrap is copied to a scratch buffer, the only copy made, which grows only
+// as far as the message needs. The scan of a message that is not yet
+// complete resumes where it stopped, and the calling thread sleeps until
+// enough bytes have arrived for it to get further.
+//
+// Returns true at end of stream. Returns false on a read error, if the
+// stream ends part way through a message, or for a message larger than the
+// ring, stopping the reader thread in each case.
+template <typename F>
+bool ingest(int fd, F on_message, size_t ring_bytes = size_t(1) << 20) {
+  struct context {
+    static void visit(void *self, byte_range message) {
+      static_cast<context *>(self)->f(message);
+    }
+    F &f;
+  };
+
+  context ctx = {on_message};
+  return detail::ingest(fd, ring_bytes, context::visit, &ctx);
+}
+
+} // namespace msgpack
+
+#endif
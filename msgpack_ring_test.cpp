@@ -0,0 +1,197 @@
+#include "catch.hpp"
+#include "msgpack.h"
+#include "msgpack_ring.h"
+#include "msgpack_traits.h"
+
+extern "C" {
+#include "manykernels_msgpack.h"
+}
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace msgpack;
+
+namespace {
+// Writes bytes to a pipe from a thread of its own, in uneven pieces
+struct pipe_writer {
+  pipe_writer(const std::vector<unsigned char> &bytes) : bytes(bytes) {
+    int fds[2];
+    REQUIRE(pipe(fds) == 0);
+    read_fd = fds[0];
+    write_fd = fds[1];
+    thread = std::thread([this]() {
+      size_t at = 0;
+      size_t piece = 1;
+      while (at < this->bytes.size()) {
+        size_t n = std::min(piece, this->bytes.size() - at);
+        ssize_t w = write(write_fd, this->bytes.data() + at, n);
+        if (w <= 0) {
+          break;
+        }
+        at += w;
+        piece = (piece * 7) % 5003 + 1;
+      }
+      close(write_fd);
+    });
+  }
+  // Drains whatever ingest left unread so the writer can finish
+  ~pipe_writer() {
+    unsigned char sink[4096];
+    while (read(read_fd, sink, sizeof(sink)) > 0) {
+    }
+    thread.join();
+    close(read_fd);
+  }
+
+  std::vector<unsigned char> bytes;
+  int read_fd;
+  int write_fd;
+  std::thread thread;
+};
+
+// The first message of manykernels_msgpack, followed by small messages
+std::vector<unsigned char> sample_stream(unsigned repeats,
+                                         std::vector<size_t> &lengths) {
+  const unsigned char *start = manykernels_msgpack;
+  const unsigned char *end = fallback::skip_next_message(
+      start, start + manykernels_msgpack_len);
+  std::vector<unsigned char> res;
+  for (unsigned r = 0; r < repeats; r++) {
+    res.insert(res.end(), start, end);
+    lengths.push_back(end - start);
+    std::vector<unsigned char> small = encode(std::vector<unsigned>(r, r));
+    res.insert(res.end(), small.begin(), small.end());
+    lengths.push_back(small.size());
+  }
+  return res;
+}
+} // namespace
+
+TEST_CASE("byte_ring") {
+  byte_ring ring(100);
+  CHECK(ring.capacity() == 128);
+
+  // Producer and consumer on two threads, the bytes arriving in order
+  const uint64_t total = 200000;
+  std::thread producer([&]() {
+    uint64_t next = 0;
+    while (next < total) {
+      unsigned char *p;
+      size_t n = ring.writable(&p);
+      if (n == 0) {
+        ring.wait_writable();
+        continue;
+      }
+      n = std::min<uint64_t>(n, total - next);
+      for (size_t i = 0; i < n; i++) {
+        p[i] = (unsigned char)(next++ % 251);
+      }
+      ring.commit(n);
+    }
+    ring.close();
+  });
+
+  uint64_t seen = 0;
+  bool in_order = true;
+  while (true) {
+    const bool closed = ring.closed();
+    const unsigned char *p;
+    size_t n = ring.readable(&p);
+    if (n == 0) {
+      if (closed) {
+        break;
+      }
+      ring.wait_readable(1);
+      continue;
+    }
+    for (size_t i = 0; i < n; i++) {
+      in_order &= p[i] == (unsigned char)(seen++ % 251);
+    }
+    ring.release(n);
+  }
+  producer.join();
+  CHECK(in_order);
+  CHECK(seen == total);
+
+  // peek joins the wrap
+  byte_ring small(8);
+  unsigned char *w;
+  REQUIRE(small.writable(&w) == 8);
+  memcpy(w, "abcdefgh", 8);
+  small.commit(8);
+  small.release(6);
+  REQUIRE(small.writable(&w) == 6);
+  memcpy(w, "ij", 2);
+  small.commit(2);
+  const unsigned char *r;
+  CHECK(small.readable(&r) == 2);
+  CHECK(small.available() == 4);
+  unsigned char joined[4];
+  small.peek(joined, 0, 4);
+  CHECK(memcmp(joined, "ghij", 4) == 0);
+  small.peek(joined, 1, 2);
+  CHECK(memcmp(joined, "hi", 2) == 0);
+}
+
+TEST_CASE("ingest") {
+  std::vector<size_t> lengths;
+  std::vector<unsigned char> stream = sample_stream(40, lengths);
+
+  SECTION("messages arrive whole and in order") {
+    pipe_writer source(stream);
+    size_t i = 0;
+    size_t offset = 0;
+    bool same = true;
+    CHECK(ingest(source.read_fd,
+                 [&](byte_range m) {
+                   const size_t N = m.end - m.start;
+                   same &= i < lengths.size() && N == lengths[i] &&
+                           memcmp(m.start, stream.data() + offset, N) == 0;
+                   offset += N;
+                   i++;
+                 },
+                 32768));
+    CHECK(same);
+    CHECK(i == lengths.size());
+  }
+
+  SECTION("ring barely larger than the largest message") {
+    // Most messages straddle the wrap and arrive in several pieces
+    size_t ring_bytes = *std::max_element(lengths.begin(), lengths.end());
+    pipe_writer source(stream);
+    size_t i = 0;
+    size_t offset = 0;
+    bool same = true;
+    CHECK(ingest(source.read_fd,
+                 [&](byte_range m) {
+                   const size_t N = m.end - m.start;
+                   same &= i < lengths.size() && N == lengths[i] &&
+                           memcmp(m.start, stream.data() + offset, N) == 0;
+                   offset += N;
+                   i++;
+                 },
+                 ring_bytes));
+    CHECK(same);
+    CHECK(i == lengths.size());
+  }
+
+  SECTION("message larger than the ring") {
+    pipe_writer source(stream);
+    size_t i = 0;
+    CHECK(!ingest(source.read_fd, [&](byte_range) { i++; }, 4096));
+    CHECK(i == 0);
+  }
+
+  SECTION("stream ends part way through a message") {
+    stream.resize(stream.size() - 1);
+    pipe_writer source(stream);
+    size_t i = 0;
+    CHECK(!ingest(source.read_fd, [&](byte_range) { i++; }, 32768));
+    CHECK(i == lengths.size() - 1);
+  }
+}
@@ -0,0 +1,333 @@
+#include "msgpack_schema.h"
+#include "msgpack_decode.h"
+
+#include <cctype>
+#include <cstdio>
+#include <set>
+
+namespace {
+using msgpack::byte_range;
+using msgpack::schema;
+
+const unsigned char *infer(byte_range bytes, schema &out) {
+  using namespace msgpack;
+  if (bytes.start == bytes.end) {
+    return nullptr;
+  }
+
+  switch (categorize(parse_type(*bytes.start))) {
+  case msgpack::boolean:
+    out.kind = schema::boolean;
+    break;
+  case msgpack::unsigned_integer:
+    out.kind = schema::unsigned_integer;
+    break;
+  case msgpack::signed_integer:
+    out.kind = schema::signed_integer;
+    break;
+  case msgpack::string:
+    out.kind = schema::string;
+    break;
+  case msgpack::other:
+    out.kind = schema::other;
+    break;
+
+  case msgpack::array: {
+    out.kind = schema::array;
+    out.element.assign(1, schema());
+    return decode_array(
+        bytes, [&](byte_range element) -> const unsigned char * {
+          schema s;
+          const unsigned char *r = infer(element, s);
+          if (r) {
+            merge_schema(out.element[0], s);
+          }
+          return r;
+        });
+  }
+
+  case msgpack::map: {
+    schema res;
+    res.kind = schema::map;
+    bool string_keys = true;
+    const unsigned char *r =
+        decode_map(bytes,
+                   [&](byte_range key,
+                       byte_range value) -> const unsigned char * {
+                     schema::field f;
+                     string_keys &= (decode(key, f.key) != nullptr);
+                     f.encoded_key.assign(key.start, key.end);
+                     const unsigned char *r = infer(value, f.value);
+                     if (r) {
+                       schema wrapper;
+                       wrapper.kind = schema::map;
+                       wrapper.fields.push_back(f);
+                       merge_schema(res, wrapper);
+                     }
+                     return r;
+                   });
+
+    if (r && !string_keys) {
+      res = schema();
+      res.kind = schema::other;
+    }
+    out = res;
+    return r;
+  }
+  }
+
+  return fallback::skip_next_message(bytes.start, bytes.end);
+}
+
+// Emission of the decoder header
+
+std::string identifier(const std::string &key) {
+  static const std::set<std::string> reserved = {
+      "alignas",  "alignof",  "and",      "asm",       "auto",     "bool",
+      "break",    "case",     "catch",    "char",      "class",    "const",
+      "continue", "default",  "delete",   "do",        "double",   "else",
+      "enum",     "explicit", "export",   "extern",    "false",    "float",
+      "for",      "friend",   "goto",     "if",        "inline",   "int",
+      "long",     "mutable",  "namespace", "new",      "not",      "operator",
+      "or",       "private",  "protected", "public",   "register", "return",
+      "short",    "signed",   "sizeof",   "static",    "struct",   "switch",
+      "template", "this",     "throw",    "true",      "try",      "typedef",
+      "typename", "union",    "unsigned", "using",     "virtual",  "void",
+      "volatile", "while",    "decode",   "decode_generic"};
+
+  std::string res;
+  for (char c : key) {
+    res.push_back(isalnum((unsigned char)c) ? c : '_');
+  }
+  size_t first = res.find_first_not_of('_');
+  size_t last = res.find_last_not_of('_');
+  res = (first == std::string::npos) ? "field"
+                                     : res.substr(first, last - first + 1);
+  if (isdigit((unsigned char)res[0])) {
+    res = "f_" + res;
+  }
+  if (reserved.count(res)) {
+    res += "_";
+  }
+  return res;
+}
+
+// Key as a C string literal. Octal escapes are fixed width so can't run into
+// a following character.
+std::string string_literal(const std::string &key) {
+  std::string res = "\"";
+  for (char c : key) {
+    unsigned char u = c;
+    if (u >= 0x20 && u < 0x7f && c != '"' && c != '\\' && c != '?') {
+      res.push_back(c);
+    } else {
+      char tmp[8];
+      snprintf(tmp, sizeof(tmp), "\\%03o", u);
+      res += tmp;
+    }
+  }
+  return res + "\"";
+}
+
+std::string byte_array(const std::string &name,
+                       const std::vector<unsigned char> &bytes) {
+  std::string res = "  static const unsigned char " + name + "[] = {";
+  for (size_t i = 0; i < bytes.size(); i++) {
+    char tmp[8];
+    snprintf(tmp, sizeof(tmp), "%s0x%02x", i == 0 ? "" : ", ", bytes[i]);
+    res += tmp;
+  }
+  return res + "};\n";
+}
+
+std::vector<unsigned char> map_header(uint64_t N) {
+  if (N <= 15) {
+    return {(unsigned char)(0x80 | N)};
+  }
+  if (N <= UINT16_MAX) {
+    return {0xde, (unsigned char)(N >> 8), (unsigned char)N};
+  }
+  return {0xdf, (unsigned char)(N >> 24), (unsigned char)(N >> 16),
+          (unsigned char)(N >> 8), (unsigned char)N};
+}
+
+struct emitter {
+  std::string structs;
+  std::string prototypes;
+  std::string definitions;
+
+  std::string type_of(const schema &s, const std::string &name) {
+    switch (s.kind) {
+    case schema::boolean:
+      return "bool";
+    case schema::unsigned_integer:
+      return "uint64_t";
+    case schema::signed_integer:
+      return "int64_t";
+    case schema::string:
+      return "std::string";
+    case schema::array:
+      return "std::vector<" + type_of(s.element[0], name) + ">";
+    case schema::map:
+      emit_struct(s, name);
+      return name;
+    case schema::none:
+    case schema::other:
+      return "msgpack::byte_range";
+    }
+    return "msgpack::byte_range";
+  }
+
+  void emit_struct(const schema &s, const std::string &name) {
+    std::vector<std::string> ids;
+    std::set<std::string> used;
+    std::string members;
+    for (size_t i = 0; i < s.fields.size(); i++) {
+      std::string id = identifier(s.fields[i].key);
+      if (used.count(id)) {
+        id += "_" + std::to_string(i);
+      }
+      used.insert(id);
+      ids.push_back(id);
+      // Nested structs are emitted ahead of this one
+      std::string type = type_of(s.fields[i].value, name + "_" + id);
+      members += "  " + type + " " + id + "{};\n";
+    }
+
+    structs += "struct " + name + " {\n" + members + "};\n\n";
+
+    prototypes += "inline const unsigned char *decode(msgpack::byte_range "
+                  "bytes, " +
+                  name + " &out);\n";
+    prototypes += "inline const unsigned char *decode_generic("
+                  "msgpack::byte_range bytes, " +
+                  name + " &out);\n";
+
+    // Fast path, keys in sample order and encoding
+    std::string fast;
+    fast += "inline const unsigned char *decode(msgpack::byte_range bytes, " +
+            name + " &out) {\n";
+    fast += byte_array("header", map_header(s.fields.size()));
+    for (size_t i = 0; i < s.fields.size(); i++) {
+      fast += byte_array("key_" + std::to_string(i), s.fields[i].encoded_key);
+    }
+    fast += "  const unsigned char *end = bytes.end;\n";
+    fast += "  const unsigned char *p = msgpack::detail::expect_bytes(\n"
+            "      bytes.start, end, header, sizeof(header));\n";
+    for (size_t i = 0; i < s.fields.size(); i++) {
+      std::string key = "key_" + std::to_string(i);
+      fast += "  p = p ? msgpack::detail::expect_bytes(p, end, " + key +
+              ", sizeof(" + key + ")) : nullptr;\n";
+      fast += "  p = p ? decode(msgpack::byte_range{p, end}, out." + ids[i] +
+              ") : nullptr;\n";
+    }
+    fast += "  if (p) {\n    return p;\n  }\n";
+    fast += "  out = " + name + "();\n";
+    fast += "  return decode_generic(bytes, out);\n}\n\n";
+
+    // Generic path, any order, unknown keys skipped
+    std::string generic;
+    generic += "inline const unsigned char *decode_generic("
+               "msgpack::byte_range bytes, " +
+               name + " &out) {\n";
+    generic += "  static const msgpack::key_set keys({";
+    for (size_t i = 0; i < s.fields.size(); i++) {
+      generic += (i ? ", " : "") + string_literal(s.fields[i].key);
+    }
+    generic += "});\n";
+    generic += "  return msgpack::decode_map(\n"
+               "      bytes,\n"
+               "      [&](msgpack::byte_range key, msgpack::byte_range value) "
+               "-> const unsigned char * {\n"
+               "        switch (keys.classify(key)) {\n";
+    for (size_t i = 0; i < s.fields.size(); i++) {
+      generic += "        case " + std::to_string(i) + ":\n";
+      generic += "          return decode(value, out." + ids[i] + ");\n";
+    }
+    generic += "        default:\n"
+               "          return msgpack::fallback::skip_next_message(\n"
+               "              value.start, value.end);\n"
+               "        }\n      });\n}\n\n";
+
+    definitions += fast + generic;
+  }
+};
+} // namespace
+
+namespace msgpack {
+
+bool infer_schema(byte_range bytes, schema &out) {
+  out = schema();
+  return infer(bytes, out) != nullptr;
+}
+
+void merge_schema(schema &into, const schema &from) {
+  if (from.kind == schema::none) {
+    return;
+  }
+  if (into.kind == schema::none) {
+    into = from;
+    return;
+  }
+
+  if (into.kind != from.kind) {
+    const bool integers = (into.kind == schema::unsigned_integer ||
+                           into.kind == schema::signed_integer) &&
+                          (from.kind == schema::unsigned_integer ||
+                           from.kind == schema::signed_integer);
+    into = schema();
+    into.kind = integers ? schema::signed_integer : schema::other;
+    return;
+  }
+
+  if (into.kind == schema::array) {
+    merge_schema(into.element[0], from.element[0]);
+  }
+
+  if (into.kind == schema::map) {
+    for (const schema::field &f : from.fields) {
+      bool found = false;
+      for (schema::field &g : into.fields) {
+        if (g.key == f.key) {
+          merge_schema(g.value, f.value);
+          found = true;
+          break;
+        }
+      }
+      if (!found) {
+        into.fields.push_back(f);
+      }
+    }
+  }
+}
+
+std::string emit_decoder(const schema &root, const std::string &ns,
+                         const std::string &root_name) {
+  if (root.kind != schema::map) {
+    return "";
+  }
+
+  emitter e;
+  e.type_of(root, root_name);
+
+  std::string guard;
+  for (char c : ns) {
+    guard.push_back(toupper((unsigned char)c));
+  }
+  guard += "_DECODER_H";
+
+  std::string res;
+  res += "// Generated by msgpack_schemagen. Do not edit.\n";
+  res += "#ifndef " + guard + "\n#define " + guard + "\n\n";
+  res += "#include \"msgpack.h\"\n#include \"msgpack_decode.h\"\n#include \"msgpack_lookup.h\"\n\n";
+  res += "#include <cstdint>\n#include <string>\n#include <vector>\n\n";
+  res += "namespace " + ns + " {\n";
+  res += "using msgpack::decode;\n\n";
+  res += e.structs;
+  res += e.prototypes + "\n";
+  res += e.definitions;
+  res += "} // namespace " + ns + "\n\n#endif\n";
+  return res;
+}
+
+} // namespace msgpack
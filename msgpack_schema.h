@@ -0,0 +1,60 @@
+#ifndef MSGPACK_SCHEMA_H
+#define MSGPACK_SCHEMA_H
+
+#include "msgpack.h"
+
+#include <string>
+#include <vector>
+
+namespace msgpack {
+
+// Shape of a document, inferred from samples. Drives msgpack_schemagen, which
+// emits C++ decoders specialised to the shape.
+struct schema {
+  enum kind_t {
+    none, // no sample seen, e.g. the elements of an empty array
+    boolean,
+    unsigned_integer,
+    signed_integer,
+    string,
+    array,
+    map,
+    other, // anything else, or samples that disagree
+  };
+
+  struct field;
+
+  kind_t kind = none;
+
+  // For arrays, one child describing every element. For maps, the fields
+  // in the order first seen, with the key encoded as in the first sample.
+  std::vector<schema> element;
+  std::vector<field> fields;
+};
+
+struct schema::field {
+  std::string key;
+  std::vector<unsigned char> encoded_key;
+  schema value;
+};
+
+// Schema of the message at bytes.start. Maps with keys that are not strings
+// are treated as other. Returns false if the message is malformed.
+bool infer_schema(byte_range bytes, schema &out);
+
+// Widen into to also describe from. Maps take the union of their fields,
+// integers of both signs become signed, other disagreements become other.
+void merge_schema(schema &into, const schema &from);
+
+// C++ header declaring a struct per map in the schema, named after the path
+// to it from root_name, and a decode(byte_range, T &) for each. The decoders
+// expect the keys in the order and encoding of the sample and fall back to
+// dispatching each key through a key_set for documents that differ, so the
+// header also needs msgpack_lookup. The root must be a map. Returns an empty
+// string otherwise.
+std::string emit_decoder(const schema &root, const std::string &ns,
+                         const std::string &root_name);
+
+} // namespace msgpack
+
+#endif
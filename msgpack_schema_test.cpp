@@ -0,0 +1,203 @@
+#include "catch.hpp"
+#include "manykernels_decoder.h"
+#include "msgpack.h"
+#include "msgpack_decode.h"
+#include "msgpack_schema.h"
+#include "msgpack_test_util.h"
+
+extern "C" {
+// manykernels_decoder.h as data, generated by build.sh with xxd -i
+extern unsigned char manykernels_decoder_h[];
+extern unsigned int manykernels_decoder_h_len;
+}
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace msgpack;
+
+namespace {
+
+std::vector<unsigned char> str(const std::string &s) {
+  std::vector<unsigned char> res(1 + s.size(), 0xa0 | s.size());
+  std::copy(s.begin(), s.end(), res.begin() + 1);
+  return res;
+}
+
+std::vector<unsigned char> concat(std::vector<std::vector<unsigned char>> parts) {
+  std::vector<unsigned char> res;
+  for (auto &p : parts) {
+    res.insert(res.end(), p.begin(), p.end());
+  }
+  return res;
+}
+} // namespace
+
+TEST_CASE("decode scalars") {
+  std::vector<unsigned char> bytes = {0xc3, 0xff, 0xcc, 0xc8, 0xa2, 'h', 'i'};
+  const unsigned char *end = bytes.data() + bytes.size();
+
+  bool b = false;
+  const unsigned char *p = decode({bytes.data(), end}, b);
+  REQUIRE(p == bytes.data() + 1);
+  CHECK(b);
+
+  int64_t s = 0;
+  uint64_t u = 0;
+  CHECK(decode({p, end}, u) == nullptr);
+  p = decode({p, end}, s);
+  REQUIRE(p);
+  CHECK(s == -1);
+
+  p = decode({p, end}, u);
+  REQUIRE(p);
+  CHECK(u == 200);
+
+  std::string text;
+  CHECK(decode({p, end}, b) == nullptr);
+  CHECK(decode({p, end}, text) == end);
+  CHECK(text == "hi");
+}
+
+TEST_CASE("decode_array and decode_map callbacks") {
+  // [1, [2, 3], "x"] then {"a": [4], "b": 5}
+  std::vector<unsigned char> array =
+      concat({{0x93, 0x01, 0x92, 0x02, 0x03}, str("x")});
+  std::vector<unsigned char> map =
+      concat({{0x82}, str("a"), {0x91, 0x04}, str("b"), {0x05}});
+
+  SECTION("bool callbacks see each element alone") {
+    std::vector<size_t> sizes;
+    CHECK(decode_array(range(array), [&](byte_range element) -> bool {
+            sizes.push_back(element.end - element.start);
+            return true;
+          }) == array.data() + array.size());
+    CHECK(sizes == std::vector<size_t>({1, 3, 2}));
+    CHECK(decode_array(range(array), [](byte_range) { return false; }) ==
+          nullptr);
+  }
+
+  SECTION("pointer callbacks read through to the end") {
+    uint64_t sum = 0;
+    const unsigned char *r = decode_map(
+        range(map),
+        [&](byte_range key, byte_range value) -> const unsigned char * {
+          CHECK(value.end == map.data() + map.size());
+          if (message_is_string(key, "b")) {
+            uint64_t x;
+            const unsigned char *end = decode(value, x);
+            sum += end ? x : 0;
+            return end;
+          }
+          return fallback::skip_next_message(value.start, value.end);
+        });
+    CHECK(r == map.data() + map.size());
+    CHECK(sum == 5);
+
+    std::vector<std::string> strings;
+    CHECK(decode_array(range(array),
+                       [&](byte_range element) -> const unsigned char * {
+                         strings.emplace_back();
+                         return decode(element, strings.back());
+                       }) == nullptr);
+    CHECK(strings.size() == 1);
+  }
+}
+
+TEST_CASE("infer and merge schema") {
+  // {"a": 1, "b": [true]} then {"b": [], "a": -1, "c": "x"}
+  std::vector<unsigned char> first =
+      concat({{0x82}, str("a"), {0x01}, str("b"), {0x91, 0xc3}});
+  std::vector<unsigned char> second =
+      concat({{0x83}, str("b"), {0x90}, str("a"), {0xff}, str("c"), str("x")});
+
+  schema s, t;
+  REQUIRE(infer_schema(range(first), s));
+  REQUIRE(infer_schema(range(second), t));
+  CHECK(s.kind == schema::map);
+  CHECK(t.fields[0].value.element[0].kind == schema::none);
+
+  merge_schema(s, t);
+  REQUIRE(s.fields.size() == 3);
+  CHECK(s.fields[0].key == "a");
+  CHECK(s.fields[0].value.kind == schema::signed_integer);
+  CHECK(s.fields[1].value.kind == schema::array);
+  CHECK(s.fields[1].value.element[0].kind == schema::boolean);
+  CHECK(s.fields[2].key == "c");
+  CHECK(s.fields[2].encoded_key == str("c"));
+
+  schema n;
+  std::vector<unsigned char> not_a_map = {0x01};
+  REQUIRE(infer_schema(range(not_a_map), n));
+  CHECK(emit_decoder(n, "ns", "root").empty());
+  CHECK(!infer_schema(range(std::vector<unsigned char>{0x92, 0x01}), n));
+}
+
+TEST_CASE("generated decoder") {
+  SECTION("header is current") {
+    const std::string committed(
+        reinterpret_cast<const char *>(manykernels_decoder_h),
+        manykernels_decoder_h_len);
+    schema s;
+    REQUIRE(infer_schema(sample(), s));
+    CHECK(emit_decoder(s, "manykernels", "kernel_metadata") == committed);
+  }
+
+  SECTION("manykernels") {
+    manykernels::kernel_metadata md;
+    const unsigned char *end = decode(sample(), md);
+    CHECK(end == fallback::skip_next_message(sample().start, sample().end));
+    REQUIRE(md.amdhsa_version.size() == 2);
+    CHECK(md.amdhsa_version[0] == 1);
+
+    std::vector<std::string> names;
+    std::vector<uint64_t> sgprs;
+    foreach_map(sample(), [&](byte_range key, byte_range value) {
+      if (!message_is_string(key, "amdhsa.kernels")) {
+        return;
+      }
+      foreach_array(value, [&](byte_range kernel) {
+        foreach_map(kernel, [&](byte_range key, byte_range value) {
+          if (message_is_string(key, ".name")) {
+            foronly_string(value, [&](size_t N, const unsigned char *s) {
+              names.push_back(std::string((const char *)s, N));
+            });
+          }
+          if (message_is_string(key, ".sgpr_count")) {
+            foronly_unsigned(value, [&](uint64_t x) { sgprs.push_back(x); });
+          }
+        });
+      });
+    });
+
+    REQUIRE(md.amdhsa_kernels.size() == names.size());
+    REQUIRE(sgprs.size() == names.size());
+    bool ok = true;
+    for (size_t i = 0; i < names.size(); i++) {
+      ok &= md.amdhsa_kernels[i].name == names[i];
+      ok &= md.amdhsa_kernels[i].sgpr_count == sgprs[i];
+      ok &= !md.amdhsa_kernels[i].args.empty();
+    }
+    CHECK(ok);
+  }
+
+  SECTION("reordered and unknown keys use the generic path") {
+    std::vector<unsigned char> arg =
+        concat({{0x84}, str(".size"), {0x08}, str(".unknown"), {0xc0},
+             str(".name"), str("x"), str(".offset"), {0x10}});
+
+    manykernels::kernel_metadata_amdhsa_kernels_args a;
+    CHECK(decode(range(arg), a) == arg.data() + arg.size());
+    CHECK(a.name == "x");
+    CHECK(a.offset == 16);
+    CHECK(a.size == 8);
+    CHECK(a.value_kind.empty());
+  }
+
+  SECTION("type mismatch fails") {
+    std::vector<unsigned char> arg = concat({{0x81}, str(".offset"), str("x")});
+    manykernels::kernel_metadata_amdhsa_kernels_args a;
+    CHECK(decode(range(arg), a) == nullptr);
+  }
+}
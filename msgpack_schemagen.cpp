@@ -0,0 +1,53 @@
+#include "msgpack.h"
+#include "msgpack_file.h"
+#include "msgpack_schema.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+// Infers a schema from sample documents and writes a header of decoders
+// specialised to it to stdout.
+// Usage: msgpack_schemagen namespace root_name offset sample...
+// Each sample file holds one top level message starting offset bytes in, e.g.
+// 20 to skip the note header of manykernels.msgpack. Trailing bytes, such as
+// note padding, are ignored.
+int main(int argc, char **argv) {
+  using namespace msgpack;
+  if (argc < 5) {
+    fprintf(stderr,
+            "Usage: %s namespace root_name offset sample.msgpack...\n",
+            argv[0]);
+    return 1;
+  }
+
+  const uint64_t offset = strtoull(argv[3], nullptr, 10);
+  schema root;
+  for (int i = 4; i < argc; i++) {
+    mapped_file file;
+    if (!file.open(argv[i])) {
+      fprintf(stderr, "Failed to open %s\n", argv[i]);
+      return 1;
+    }
+    byte_range bytes = file.bytes();
+    if ((uint64_t)(bytes.end - bytes.start) < offset) {
+      fprintf(stderr, "%s is shorter than the offset\n", argv[i]);
+      return 1;
+    }
+    bytes.start += offset;
+
+    schema s;
+    if (!infer_schema(bytes, s)) {
+      fprintf(stderr, "Malformed message in %s\n", argv[i]);
+      return 1;
+    }
+    merge_schema(root, s);
+  }
+
+  std::string header = emit_decoder(root, argv[1], argv[2]);
+  if (header.empty()) {
+    fprintf(stderr, "Top level message is not a map\n");
+    return 1;
+  }
+  fputs(header.c_str(), stdout);
+  return 0;
+}
@@ -0,0 +1,50 @@
+#ifndef MSGPACK_TEST_UTIL_H
+#define MSGPACK_TEST_UTIL_H
+
+#include "msgpack.h"
+#include "msgpack_traits.h"
+
+extern "C" {
+#include "manykernels_msgpack.h"
+}
+
+#include <vector>
+
+// Helpers shared by the *_test.cpp files
+
+// The bytes of a vector as a range
+inline msgpack::byte_range range(const std::vector<unsigned char> &bytes) {
+  return {bytes.data(), bytes.data() + bytes.size()};
+}
+
+// The manykernels sample, a map of code object metadata
+inline msgpack::byte_range sample() {
+  return {manykernels_msgpack, manykernels_msgpack + manykernels_msgpack_len};
+}
+
+// The "amdhsa.kernels" array of the sample
+inline msgpack::byte_range kernel_array() {
+  msgpack::byte_range res = {nullptr, nullptr};
+  msgpack::foreach_map(sample(), [&](msgpack::byte_range key,
+                                          msgpack::byte_range value) {
+    if (msgpack::message_is_string(key, "amdhsa.kernels")) {
+      res = value;
+    }
+  });
+  return res;
+}
+
+// Stands in for a string or container longer than UINT32_MAX, which can't be
+// encoded
+struct oversized {};
+
+namespace msgpack {
+template <> struct msgpack_traits<oversized> {
+  static uint64_t size(const oversized &) { return too_large_to_encode; }
+  static unsigned char *write(const oversized &, unsigned char *out) {
+    return out;
+  }
+};
+} // namespace msgpack
+
+#endif
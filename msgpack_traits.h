@@ -0,0 +1,400 @@
+#ifndef MSGPACK_TRAITS_H
+#define MSGPACK_TRAITS_H
+
+#include "msgpack.h"
+#include "msgpack_endian.h"
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if __cplusplus >= 201703L
+#include <optional>
+#include <variant>
+#endif
+
+namespace msgpack {
+// Customisation point for encoding values of type T. Specialisations provide
+//
+//   static uint64_t size(const T &x);
+//   static unsigned char *write(const T &x, unsigned char *out);
+//
+// where size is the exact number of bytes write stores at out, and write
+// returns out + size(x). Integers use the narrowest encoding of their value.
+// Structs bound with MSGPACK_FIELDS encode as maps (see msgpack_fields.h).
+// A value holding a string or container longer than UINT32_MAX can't be
+// encoded, size returns too_large_to_encode and write must not be called.
+template <typename T, typename Enable = void> struct msgpack_traits;
+
+const uint64_t too_large_to_encode = UINT64_MAX;
+
+namespace detail {
+template <typename...> struct make_void {
+  typedef void type;
+};
+
+// Sum of two sizes, too_large_to_encode if either is
+inline uint64_t add_sizes(uint64_t x, uint64_t y) {
+  return (x > too_large_to_encode - y) ? too_large_to_encode : x + y;
+}
+
+inline uint64_t unsigned_size(uint64_t x) {
+  return (x <= 127)          ? 1
+         : (x <= UINT8_MAX)  ? 2
+         : (x <= UINT16_MAX) ? 3
+         : (x <= UINT32_MAX) ? 5
+                             : 9;
+}
+
+inline unsigned char *write_unsigned(uint64_t x, unsigned char *out) {
+  if (x <= 127) {
+    *out = static_cast<unsigned char>(x);
+    return out + 1;
+  }
+  if (x <= UINT8_MAX) {
+    return write_tagged(0xcc, static_cast<uint8_t>(x), out);
+  }
+  if (x <= UINT16_MAX) {
+    return write_tagged(0xcd, static_cast<uint16_t>(x), out);
+  }
+  if (x <= UINT32_MAX) {
+    return write_tagged(0xce, static_cast<uint32_t>(x), out);
+  }
+  return write_tagged(0xcf, x, out);
+}
+
+inline uint64_t signed_size(int64_t x) {
+  return (x >= 0)           ? unsigned_size(x)
+         : (x >= -32)       ? 1
+         : (x >= INT8_MIN)  ? 2
+         : (x >= INT16_MIN) ? 3
+         : (x >= INT32_MIN) ? 5
+                            : 9;
+}
+
+inline unsigned char *write_signed(int64_t x, unsigned char *out) {
+  if (x >= 0) {
+    return write_unsigned(x, out);
+  }
+  if (x >= -32) {
+    *out = static_cast<unsigned char>(x);
+    return out + 1;
+  }
+  if (x >= INT8_MIN) {
+    return write_tagged(0xd0, static_cast<uint8_t>(x), out);
+  }
+  if (x >= INT16_MIN) {
+    return write_tagged(0xd1, static_cast<uint16_t>(x), out);
+  }
+  if (x >= INT32_MIN) {
+    return write_tagged(0xd2, static_cast<uint32_t>(x), out);
+  }
+  return write_tagged(0xd3, static_cast<uint64_t>(x), out);
+}
+
+// Arrays and maps hold at most UINT32_MAX elements
+inline uint64_t container_header_size(uint64_t N) {
+  return (N <= 15)           ? 1
+         : (N <= UINT16_MAX) ? 3
+         : (N <= UINT32_MAX) ? 5
+                             : too_large_to_encode;
+}
+
+inline unsigned char *write_container_header(unsigned char fix,
+                                             unsigned char tag16, uint64_t N,
+                                             unsigned char *out) {
+  assert(N <= UINT32_MAX);
+  if (N <= 15) {
+    *out = fix | static_cast<unsigned char>(N);
+    return out + 1;
+  }
+  if (N <= UINT16_MAX) {
+    return write_tagged(tag16, static_cast<uint16_t>(N), out);
+  }
+  return write_tagged(tag16 + 1, static_cast<uint32_t>(N), out);
+}
+
+inline unsigned char *write_array_header(uint64_t N, unsigned char *out) {
+  return write_container_header(0x90, 0xdc, N, out);
+}
+
+inline unsigned char *write_map_header(uint64_t N, unsigned char *out) {
+  return write_container_header(0x80, 0xde, N, out);
+}
+
+inline uint64_t string_size(uint64_t N) {
+  if (N > UINT32_MAX) {
+    return too_large_to_encode;
+  }
+  return N + ((N <= 31) ? 1 : (N <= UINT8_MAX) ? 2 : (N <= UINT16_MAX) ? 3 : 5);
+}
+
+inline unsigned char *write_string(const char *str, uint64_t N,
+                                   unsigned char *out) {
+  assert(N <= UINT32_MAX);
+  if (N <= 31) {
+    *out++ = 0xa0 | static_cast<unsigned char>(N);
+  } else if (N <= UINT8_MAX) {
+    *out++ = 0xd9;
+    *out++ = static_cast<unsigned char>(N);
+  } else if (N <= UINT16_MAX) {
+    out = write_tagged(0xda, static_cast<uint16_t>(N), out);
+  } else {
+    out = write_tagged(0xdb, static_cast<uint32_t>(N), out);
+  }
+  memcpy(out, str, N);
+  return out + N;
+}
+
+// Shared by the sequence containers
+template <typename C> struct sequence_traits {
+  typedef typename C::value_type element;
+
+  static uint64_t size(const C &x) {
+    uint64_t res = container_header_size(x.size());
+    for (const auto &e : x) {
+      res = add_sizes(res, msgpack_traits<element>::size(e));
+    }
+    return res;
+  }
+
+  static unsigned char *write(const C &x, unsigned char *out) {
+    out = write_array_header(x.size(), out);
+    for (const auto &e : x) {
+      out = msgpack_traits<element>::write(e, out);
+    }
+    return out;
+  }
+};
+
+template <typename C> struct associative_traits {
+  typedef typename C::key_type key;
+  typedef typename C::mapped_type mapped;
+
+  static uint64_t size(const C &x) {
+    uint64_t res = container_header_size(x.size());
+    for (const auto &kv : x) {
+      res = add_sizes(res, msgpack_traits<key>::size(kv.first));
+      res = add_sizes(res, msgpack_traits<mapped>::size(kv.second));
+    }
+    return res;
+  }
+
+  static unsigned char *write(const C &x, unsigned char *out) {
+    out = write_map_header(x.size(), out);
+    for (const auto &kv : x) {
+      out = msgpack_traits<key>::write(kv.first, out);
+      out = msgpack_traits<mapped>::write(kv.second, out);
+    }
+    return out;
+  }
+};
+
+// The first I elements of a tuple
+template <size_t I, typename Tuple> struct tuple_elements {
+  typedef typename std::tuple_element<I - 1, Tuple>::type last;
+
+  static uint64_t size(const Tuple &x) {
+    return add_sizes(tuple_elements<I - 1, Tuple>::size(x),
+                     msgpack_traits<last>::size(std::get<I - 1>(x)));
+  }
+
+  static unsigned char *write(const Tuple &x, unsigned char *out) {
+    out = tuple_elements<I - 1, Tuple>::write(x, out);
+    return msgpack_traits<last>::write(std::get<I - 1>(x), out);
+  }
+};
+
+template <typename Tuple> struct tuple_elements<0, Tuple> {
+  static uint64_t size(const Tuple &) { return 0; }
+  static unsigned char *write(const Tuple &, unsigned char *out) {
+    return out;
+  }
+};
+} // namespace detail
+
+template <> struct msgpack_traits<bool> {
+  static uint64_t size(bool) { return 1; }
+  static unsigned char *write(bool x, unsigned char *out) {
+    *out = x ? 0xc3 : 0xc2;
+    return out + 1;
+  }
+};
+
+template <typename T>
+struct msgpack_traits<
+    T, typename std::enable_if<std::is_integral<T>::value &&
+                               std::is_unsigned<T>::value>::type> {
+  static uint64_t size(T x) { return detail::unsigned_size(x); }
+  static unsigned char *write(T x, unsigned char *out) {
+    return detail::write_unsigned(x, out);
+  }
+};
+
+template <typename T>
+struct msgpack_traits<
+    T, typename std::enable_if<std::is_integral<T>::value &&
+                               std::is_signed<T>::value>::type> {
+  static uint64_t size(T x) { return detail::signed_size(x); }
+  static unsigned char *write(T x, unsigned char *out) {
+    return detail::write_signed(x, out);
+  }
+};
+
+template <> struct msgpack_traits<float> {
+  static uint64_t size(float) { return 5; }
+  static unsigned char *write(float x, unsigned char *out) {
+    uint32_t bits;
+    memcpy(&bits, &x, 4);
+    return detail::write_tagged(0xca, bits, out);
+  }
+};
+
+template <> struct msgpack_traits<double> {
+  static uint64_t size(double) { return 9; }
+  static unsigned char *write(double x, unsigned char *out) {
+    uint64_t bits;
+    memcpy(&bits, &x, 8);
+    return detail::write_tagged(0xcb, bits, out);
+  }
+};
+
+template <> struct msgpack_traits<std::string> {
+  static uint64_t size(const std::string &x) {
+    return detail::string_size(x.size());
+  }
+  static unsigned char *write(const std::string &x, unsigned char *out) {
+    return detail::write_string(x.data(), x.size(), out);
+  }
+};
+
+template <typename T, typename A>
+struct msgpack_traits<std::vector<T, A>>
+    : detail::sequence_traits<std::vector<T, A>> {};
+
+template <typename T, size_t N>
+struct msgpack_traits<std::array<T, N>>
+    : detail::sequence_traits<std::array<T, N>> {};
+
+template <typename K, typename V, typename C, typename A>
+struct msgpack_traits<std::map<K, V, C, A>>
+    : detail::associative_traits<std::map<K, V, C, A>> {};
+
+template <typename K, typename V, typename H, typename E, typename A>
+struct msgpack_traits<std::unordered_map<K, V, H, E, A>>
+    : detail::associative_traits<std::unordered_map<K, V, H, E, A>> {};
+
+// Pairs and tuples encode as arrays
+template <typename A, typename B> struct msgpack_traits<std::pair<A, B>> {
+  static uint64_t size(const std::pair<A, B> &x) {
+    return detail::add_sizes(
+        detail::add_sizes(1, msgpack_traits<A>::size(x.first)),
+        msgpack_traits<B>::size(x.second));
+  }
+  static unsigned char *write(const std::pair<A, B> &x, unsigned char *out) {
+    out = detail::write_array_header(2, out);
+    out = msgpack_traits<A>::write(x.first, out);
+    return msgpack_traits<B>::write(x.second, out);
+  }
+};
+
+template <typename... Ts> struct msgpack_traits<std::tuple<Ts...>> {
+  typedef detail::tuple_elements<sizeof...(Ts), std::tuple<Ts...>> elements;
+  static uint64_t size(const std::tuple<Ts...> &x) {
+    return detail::add_sizes(detail::container_header_size(sizeof...(Ts)),
+                             elements::size(x));
+  }
+  static unsigned char *write(const std::tuple<Ts...> &x, unsigned char *out) {
+    out = detail::write_array_header(sizeof...(Ts), out);
+    return elements::write(x, out);
+  }
+};
+
+#if __cplusplus >= 201703L
+// Empty optionals and monostate encode as nil. Variants encode as their
+// active alternative with nothing recording which one it was, so decoding
+// picks the first alternative that accepts the message. That round trips
+// only when no earlier alternative accepts the encoding of a later one, e.g.
+// std::variant<uint32_t, uint64_t> holding 5 decodes as the uint32_t.
+template <> struct msgpack_traits<std::monostate> {
+  static uint64_t size(const std::monostate &) { return 1; }
+  static unsigned char *write(const std::monostate &, unsigned char *out) {
+    *out = 0xc0;
+    return out + 1;
+  }
+};
+
+template <typename T> struct msgpack_traits<std::optional<T>> {
+  static uint64_t size(const std::optional<T> &x) {
+    return x ? msgpack_traits<T>::size(*x) : 1;
+  }
+  static unsigned char *write(const std::optional<T> &x, unsigned char *out) {
+    if (!x) {
+      *out = 0xc0;
+      return out + 1;
+    }
+    return msgpack_traits<T>::write(*x, out);
+  }
+};
+
+template <typename... Ts> struct msgpack_traits<std::variant<Ts...>> {
+  static uint64_t size(const std::variant<Ts...> &x) {
+    return std::visit(
+        [](const auto &v) {
+          return msgpack_traits<std::decay_t<decltype(v)>>::size(v);
+        },
+        x);
+  }
+  static unsigned char *write(const std::variant<Ts...> &x,
+                              unsigned char *out) {
+    return std::visit(
+        [out](const auto &v) {
+          return msgpack_traits<std::decay_t<decltype(v)>>::write(v, out);
+        },
+        x);
+  }
+};
+#endif
+
+// Exact number of bytes encode writes for x, too_large_to_encode if it can't
+// be encoded
+template <typename T> uint64_t encoded_size(const T &x) {
+  return msgpack_traits<T>::size(x);
+}
+
+// Writes x to [start, end). Returns one past the last byte written, or
+// nullptr if it does not fit or can't be encoded.
+template <typename T>
+unsigned char *encode(const T &x, unsigned char *start, unsigned char *end) {
+  const uint64_t N = msgpack_traits<T>::size(x);
+  if (N == too_large_to_encode || (uint64_t)(end - start) < N) {
+    return nullptr;
+  }
+  return msgpack_traits<T>::write(x, start);
+}
+
+// x encoded into a single allocation of exactly the right size. Empty if x
+// can't be encoded.
+template <typename T> std::vector<unsigned char> encode(const T &x) {
+  const uint64_t N = msgpack_traits<T>::size(x);
+  if (N == too_large_to_encode) {
+    return {};
+  }
+  std::vector<unsigned char> res(N);
+  unsigned char *end = msgpack_traits<T>::write(x, res.data());
+  (void)end;
+  assert(end == res.data() + res.size());
+  return res;
+}
+
+} // namespace msgpack
+
+#endif
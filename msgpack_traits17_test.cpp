@@ -0,0 +1,89 @@
+#include "catch.hpp"
+#include "msgpack.h"
+#include "msgpack_decode.h"
+#include "msgpack_fields.h"
+#include "msgpack_test_util.h"
+#include "msgpack_traits.h"
+
+#if __cplusplus < 201703L
+#error "Covers the C++17 parts of msgpack_traits.h, build with -std=c++17"
+#endif
+
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace traits17_example {
+struct arg_info {
+  std::string name;
+  std::optional<uint32_t> offset;
+  std::variant<std::string, uint64_t> kind;
+};
+MSGPACK_FIELDS(arg_info, name, offset, kind)
+} // namespace traits17_example
+
+using namespace msgpack;
+
+TEST_CASE("msgpack_traits optional and variant") {
+  SECTION("nil") {
+    std::vector<unsigned char> bytes = encode(std::monostate());
+    CHECK(bytes == std::vector<unsigned char>({0xc0}));
+    std::monostate m;
+    CHECK(decode(range(bytes), m) == bytes.data() + 1);
+
+    std::vector<unsigned char> one = {0x01};
+    CHECK(decode(range(one), m) == nullptr);
+  }
+
+  SECTION("optional round trip") {
+    std::optional<std::string> empty;
+    std::vector<unsigned char> bytes = encode(empty);
+    CHECK(bytes == std::vector<unsigned char>({0xc0}));
+    CHECK(encoded_size(empty) == 1);
+
+    std::optional<std::string> got = std::string("stale");
+    CHECK(decode(range(bytes), got) == bytes.data() + bytes.size());
+    CHECK(!got);
+
+    std::optional<std::string> full = std::string("hi");
+    bytes = encode(full);
+    CHECK(bytes == std::vector<unsigned char>({0xa2, 'h', 'i'}));
+    CHECK(decode(range(bytes), got) == bytes.data() + bytes.size());
+    CHECK(got == full);
+
+    std::vector<std::optional<uint32_t>> values = {1, std::nullopt, 300};
+    bytes = encode(values);
+    CHECK(bytes == std::vector<unsigned char>({0x93, 0x01, 0xc0, 0xcd, 0x01,
+                                               0x2c}));
+    std::vector<std::optional<uint32_t>> back;
+    CHECK(decode(range(bytes), back) == bytes.data() + bytes.size());
+    CHECK(back == values);
+  }
+
+  SECTION("variant round trip") {
+    typedef std::variant<std::monostate, int64_t, std::string> value;
+    for (const value &v : {value(), value(int64_t(-3)), value("x")}) {
+      std::vector<unsigned char> bytes = encode(v);
+      CHECK(bytes.size() == encoded_size(v));
+      value got = int64_t(7);
+      CHECK(decode(range(bytes), got) == bytes.data() + bytes.size());
+      CHECK(got == v);
+    }
+
+    // No alternative accepts a bool
+    std::vector<unsigned char> b = {0xc3};
+    value got;
+    CHECK(decode(range(b), got) == nullptr);
+  }
+
+  SECTION("bound struct members") {
+    traits17_example::arg_info in = {"a", std::nullopt, uint64_t(8)};
+    std::vector<unsigned char> bytes = encode(in);
+    traits17_example::arg_info out = {"", 5u, std::string("stale")};
+    CHECK(decode(range(bytes), out) == bytes.data() + bytes.size());
+    CHECK(out.name == "a");
+    CHECK(!out.offset);
+    CHECK(out.kind == in.kind);
+  }
+}
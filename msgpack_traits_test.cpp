@@ -0,0 +1,204 @@
+#include "catch.hpp"
+#include "msgpack.h"
+#include "msgpack_decode.h"
+#include "msgpack_fields.h"
+#include "msgpack_test_util.h"
+#include "msgpack_traits.h"
+
+extern "C" {
+#include "manykernels_msgpack.h"
+}
+
+#include <cstring>
+#include <map>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace traits_example {
+struct arg_info {
+  std::string name;
+  uint32_t offset = 0;
+  uint32_t size = 0;
+  bool operator==(const arg_info &o) const {
+    return name == o.name && offset == o.offset && size == o.size;
+  }
+};
+MSGPACK_FIELDS_WITH_PREFIX(arg_info, ".", name, offset, size)
+
+struct kernel_info {
+  std::string name;
+  int32_t sgpr_count = 0;
+  std::vector<uint8_t> language_version;
+  std::vector<arg_info> args;
+  bool operator==(const kernel_info &o) const {
+    return name == o.name && sgpr_count == o.sgpr_count &&
+           language_version == o.language_version && args == o.args;
+  }
+};
+MSGPACK_FIELDS_WITH_PREFIX(kernel_info, ".", name, sgpr_count,
+                           language_version, args)
+} // namespace traits_example
+
+using namespace msgpack;
+
+namespace {
+template <typename T> T round_trip(const T &x) {
+  std::vector<unsigned char> bytes = encode(x);
+  CHECK(bytes.size() == encoded_size(x));
+  T res;
+  CHECK(decode(range(bytes), res) == bytes.data() + bytes.size());
+  return res;
+}
+} // namespace
+
+TEST_CASE("msgpack_traits scalars") {
+  SECTION("integers use the narrowest encoding") {
+    CHECK(encode(uint64_t(127)).size() == 1);
+    CHECK(encode(uint64_t(128)).size() == 2);
+    CHECK(encode(uint16_t(UINT16_MAX)).size() == 3);
+    CHECK(encode(UINT32_MAX + UINT64_C(1)).size() == 9);
+    CHECK(encode(int64_t(-32)).size() == 1);
+    CHECK(encode(int8_t(-33)).size() == 2);
+    CHECK(encode(int64_t(INT32_MIN)).size() == 5);
+    CHECK(encode(int64_t(INT32_MIN) - 1).size() == 9);
+  }
+
+  SECTION("integer round trip") {
+    for (uint64_t x : {UINT64_C(0), UINT64_C(127), UINT64_C(128),
+                       UINT64_C(255), UINT64_C(256), UINT64_C(65535),
+                       UINT64_C(65536), UINT64_C(4294967295),
+                       UINT64_C(4294967296), UINT64_MAX}) {
+      CHECK(round_trip(x) == x);
+    }
+    for (int64_t x : {INT64_MIN, int64_t(INT32_MIN) - 1, int64_t(INT32_MIN),
+                      int64_t(INT16_MIN), int64_t(INT8_MIN), int64_t(-33),
+                      int64_t(-32), int64_t(-1), int64_t(0), INT64_MAX}) {
+      CHECK(round_trip(x) == x);
+    }
+  }
+
+  SECTION("bool, float and string") {
+    CHECK(round_trip(true));
+    CHECK(!round_trip(false));
+
+    std::vector<unsigned char> d = encode(1.5);
+    REQUIRE(d.size() == 9);
+    CHECK(d[0] == 0xcb);
+    std::vector<unsigned char> f = encode(1.5f);
+    REQUIRE(f.size() == 5);
+    CHECK(f[0] == 0xca);
+    CHECK(f[1] == 0x3f);
+
+    for (size_t N : {0, 31, 32, 255, 256, 65535, 65536}) {
+      std::string s(N, 'x');
+      CHECK(round_trip(s) == s);
+    }
+  }
+}
+
+TEST_CASE("msgpack_traits containers") {
+  SECTION("vector and array") {
+    std::vector<int32_t> v = {1, -1, 1000, -100000};
+    CHECK(round_trip(v) == v);
+
+    std::vector<uint16_t> big(70000, 300);
+    CHECK(round_trip(big) == big);
+
+    std::array<uint8_t, 3> a = {{1, 2, 3}};
+    std::vector<uint8_t> as_vector(a.begin(), a.end());
+    std::vector<unsigned char> bytes = encode(a);
+    std::vector<uint8_t> got;
+    CHECK(decode(range(bytes), got));
+    CHECK(got == as_vector);
+  }
+
+  SECTION("maps") {
+    std::map<std::string, uint32_t> m = {{"a", 1}, {"b", 200}};
+    std::vector<unsigned char> bytes = encode(m);
+    CHECK(bytes.size() == encoded_size(m));
+    CHECK(bytes == std::vector<unsigned char>(
+                       {0x82, 0xa1, 'a', 0x01, 0xa1, 'b', 0xcc, 200}));
+
+    std::unordered_map<int, std::string> u = {{1, "x"}, {-1, "y"}};
+    std::map<int64_t, std::string> got;
+    bytes = encode(u);
+    CHECK(decode_map(range(bytes), [&](byte_range k, byte_range v) -> bool {
+      int64_t key;
+      return decode(k, key) && decode(v, got[key]);
+    }));
+    CHECK(got.size() == 2);
+    CHECK(got[-1] == "y");
+  }
+
+  SECTION("pair and tuple") {
+    std::vector<unsigned char> bytes = encode(std::make_pair(1, true));
+    CHECK(bytes == std::vector<unsigned char>({0x92, 0x01, 0xc3}));
+
+    bytes = encode(std::make_tuple(std::string("a"), -1, 2.0));
+    CHECK(bytes.size() == 1 + 2 + 1 + 9);
+    CHECK(bytes[0] == 0x93);
+    CHECK(encode(std::tuple<>()) == std::vector<unsigned char>({0x90}));
+  }
+
+  SECTION("insufficient buffer") {
+    std::vector<std::string> v = {"abc", "def"};
+    std::vector<unsigned char> out(encoded_size(v));
+    CHECK(encode(v, out.data(), out.data() + out.size() - 1) == nullptr);
+    CHECK(encode(v, out.data(), out.data() + out.size()) ==
+          out.data() + out.size());
+  }
+}
+
+namespace {
+template <typename T> void check_too_large(const T &x) {
+  unsigned char out[64];
+  CHECK(encoded_size(x) == too_large_to_encode);
+  CHECK(encode(x).empty());
+  CHECK(encode(x, out, out + sizeof(out)) == nullptr);
+}
+} // namespace
+
+TEST_CASE("msgpack_traits too large to encode") {
+  const uint64_t over = UINT64_C(1) << 32;
+  CHECK(detail::container_header_size(over) == too_large_to_encode);
+  CHECK(detail::container_header_size(over - 1) == 5);
+  CHECK(detail::string_size(over) == too_large_to_encode);
+  CHECK(detail::string_size(over - 1) == over + 4);
+  CHECK(detail::add_sizes(1, too_large_to_encode) == too_large_to_encode);
+  CHECK(detail::add_sizes(too_large_to_encode, 0) == too_large_to_encode);
+
+  check_too_large(std::vector<oversized>(2));
+  check_too_large(std::map<int, oversized>({{1, oversized()}}));
+  check_too_large(std::make_pair(oversized(), 1));
+  check_too_large(std::make_pair(1, oversized()));
+  check_too_large(std::make_tuple(1, oversized(), 2));
+}
+
+TEST_CASE("msgpack_traits bound structs") {
+  SECTION("round trip") {
+    traits_example::kernel_info k;
+    k.name = "kernel";
+    k.sgpr_count = -3;
+    k.language_version = {2, 0};
+    k.args.resize(2);
+    k.args[0].name = "x";
+    k.args[1].offset = 8;
+    k.args[1].size = 100000;
+    CHECK(round_trip(k) == k);
+  }
+
+  SECTION("manykernels") {
+    std::vector<traits_example::kernel_info> kernels;
+    const unsigned char *start = manykernels_msgpack;
+    const unsigned char *end = start + manykernels_msgpack_len;
+    foreach_map({start, end}, [&](byte_range key, byte_range value) {
+      if (message_is_string(key, "amdhsa.kernels")) {
+        CHECK(decode(value, kernels));
+      }
+    });
+    REQUIRE(!kernels.empty());
+    CHECK(round_trip(kernels) == kernels);
+  }
+}
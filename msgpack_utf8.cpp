@@ -0,0 +1,138 @@
+#include "msgpack_utf8.h"
+
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+// Validates one multibyte sequence starting at a non-ascii lead byte.
+// Returns the number of bytes consumed, or 0 if the sequence is invalid.
+// Byte ranges from table 3-7 of the Unicode standard.
+size_t multibyte_sequence(const unsigned char *str, size_t available) {
+  const unsigned char lead = str[0];
+
+  auto continuation = [](unsigned char x) { return (x & 0xc0) == 0x80; };
+
+  if (lead >= 0xc2 && lead <= 0xdf) {
+    return (available >= 2 && continuation(str[1])) ? 2 : 0;
+  }
+
+  if (lead >= 0xe0 && lead <= 0xef) {
+    if (available < 3) {
+      return 0;
+    }
+    unsigned char lo = (lead == 0xe0) ? 0xa0 : 0x80;
+    unsigned char hi = (lead == 0xed) ? 0x9f : 0xbf;
+    bool ok = (str[1] >= lo && str[1] <= hi) && continuation(str[2]);
+    return ok ? 3 : 0;
+  }
+
+  if (lead >= 0xf0 && lead <= 0xf4) {
+    if (available < 4) {
+      return 0;
+    }
+    unsigned char lo = (lead == 0xf0) ? 0x90 : 0x80;
+    unsigned char hi = (lead == 0xf4) ? 0x8f : 0xbf;
+    bool ok = (str[1] >= lo && str[1] <= hi) && continuation(str[2]) &&
+              continuation(str[3]);
+    return ok ? 4 : 0;
+  }
+
+  // Stray continuation byte, overlong two byte lead (c0, c1) or f5..ff
+  return 0;
+}
+
+// Number of leading ascii bytes, checked a vector at a time
+size_t ascii_prefix(const unsigned char *str, size_t N) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  for (; i + 32 <= N; i += 32) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(str + i));
+    __m128i b =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(str + i + 16));
+    if (_mm_movemask_epi8(_mm_or_si128(a, b)) != 0) {
+      break;
+    }
+  }
+  for (; i + 16 <= N; i += 16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(str + i));
+    unsigned mask = (unsigned)_mm_movemask_epi8(a);
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+#endif
+  while (i < N && str[i] < 0x80) {
+    i++;
+  }
+  return i;
+}
+
+struct functors_validate : public msgpack::functors_utf8<functors_validate> {
+  functors_validate(uint64_t &n, const unsigned char *&invalid)
+      : number_remaining(n), invalid(invalid) {}
+
+  uint64_t &number_remaining;
+  const unsigned char *&invalid;
+
+  void handle_invalid_string(size_t, const unsigned char *str) {
+    invalid = str;
+  }
+
+  // Visit the elements iteratively, as skip_number_contiguous_messages does
+  const unsigned char *handle_array(uint64_t N, msgpack::byte_range bytes) {
+    number_remaining += N;
+    return bytes.start;
+  }
+
+  const unsigned char *handle_map(uint64_t N, msgpack::byte_range bytes) {
+    number_remaining += 2 * N;
+    return bytes.start;
+  }
+};
+} // namespace
+
+namespace msgpack {
+
+bool utf8_valid(const unsigned char *str, size_t N) {
+  size_t i = 0;
+  while (i < N) {
+    i += ascii_prefix(str + i, N - i);
+    if (i == N) {
+      return true;
+    }
+    size_t used = multibyte_sequence(str + i, N - i);
+    if (used == 0) {
+      return false;
+    }
+    i += used;
+  }
+  return true;
+}
+
+const unsigned char *validate_utf8(byte_range bytes,
+                                   const unsigned char **invalid) {
+  uint64_t number_remaining = 1;
+  const unsigned char *found = nullptr;
+  functors_validate f(number_remaining, found);
+  *invalid = nullptr;
+
+  const unsigned char *start = bytes.start;
+  while (number_remaining != 0) {
+    const unsigned char *r = handle_msgpack({start, bytes.end}, f);
+    number_remaining--;
+    if (found) {
+      *invalid = found;
+      return nullptr;
+    }
+    if (!r) {
+      return nullptr;
+    }
+    start = r;
+  }
+  return start;
+}
+
+} // namespace msgpack
@@ -0,0 +1,45 @@
+#ifndef MSGPACK_UTF8_H
+#define MSGPACK_UTF8_H
+
+#include "msgpack.h"
+
+#include <cstddef>
+
+namespace msgpack {
+
+// True if the N bytes at str are well formed UTF-8. Rejects overlong
+// encodings, surrogates and code points above U+10FFFF.
+bool utf8_valid(const unsigned char *str, size_t N);
+
+// Opt-in validation of string payloads as they are parsed. Derive from this
+// instead of functors_defaults and override handle_utf8_string in place of
+// handle_string. Strings that are not UTF-8 go to handle_invalid_string.
+template <typename Derived>
+class functors_utf8 : public functors_defaults<Derived> {
+public:
+  void handle_string(size_t N, const unsigned char *str) {
+    if (utf8_valid(str, N)) {
+      derived().handle_utf8_string(N, str);
+    } else {
+      derived().handle_invalid_string(N, str);
+    }
+  }
+
+  void handle_utf8_string(size_t, const unsigned char *) {}
+  void handle_invalid_string(size_t, const unsigned char *) {}
+
+private:
+  Derived &derived() { return *static_cast<Derived *>(this); }
+};
+
+// Walks the whole message, including map keys and nested containers, checking
+// each string as it is skipped over. Returns one past the end of the message,
+// or nullptr if it is malformed or contains a string that is not UTF-8. In
+// the latter case *invalid is set to the start of the first such payload, so
+// the offset is *invalid - bytes.start. Otherwise *invalid is set to nullptr.
+const unsigned char *validate_utf8(byte_range bytes,
+                                   const unsigned char **invalid);
+
+} // namespace msgpack
+
+#endif
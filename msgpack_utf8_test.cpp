@@ -0,0 +1,126 @@
+#include "catch.hpp"
+#include "msgpack.h"
+#include "msgpack_utf8.h"
+
+extern "C" {
+#include "manykernels_msgpack.h"
+}
+
+#include <string>
+#include <vector>
+
+using namespace msgpack;
+
+namespace {
+bool valid(const std::string &s) {
+  return utf8_valid(reinterpret_cast<const unsigned char *>(s.data()),
+                    s.size());
+}
+} // namespace
+
+TEST_CASE("utf8_valid") {
+  SECTION("well formed") {
+    CHECK(valid(""));
+    CHECK(valid("ascii"));
+    CHECK(valid("\xc2\x80"));
+    CHECK(valid("\xdf\xbf"));
+    CHECK(valid("\xe0\xa0\x80"));
+    CHECK(valid("\xed\x9f\xbf"));
+    CHECK(valid("\xef\xbf\xbf"));
+    CHECK(valid("\xf0\x90\x80\x80"));
+    CHECK(valid("\xf4\x8f\xbf\xbf"));
+  }
+
+  SECTION("ill formed") {
+    CHECK(!valid("\x80"));
+    CHECK(!valid("\xbf"));
+    CHECK(!valid("\xc0\x80"));         // overlong
+    CHECK(!valid("\xc1\xbf"));         // overlong
+    CHECK(!valid("\xe0\x9f\xbf"));     // overlong
+    CHECK(!valid("\xed\xa0\x80"));     // surrogate
+    CHECK(!valid("\xf0\x8f\xbf\xbf")); // overlong
+    CHECK(!valid("\xf4\x90\x80\x80")); // above U+10FFFF
+    CHECK(!valid("\xf5\x80\x80\x80"));
+    CHECK(!valid("\xff"));
+    CHECK(!valid("\xc2"));     // truncated
+    CHECK(!valid("\xe1\x80")); // truncated
+    CHECK(!valid("\xc2\x41"));
+  }
+
+  SECTION("every position in a long string") {
+    // Covers the vector, remainder and scalar paths
+    for (size_t len : {1, 15, 16, 17, 31, 32, 33, 70}) {
+      for (size_t pos = 0; pos < len; pos++) {
+        std::string s(len, 'x');
+        s[pos] = '\xff';
+        CHECK(!valid(s));
+
+        std::string t(len, 'y');
+        t.insert(pos, "\xe2\x82\xac");
+        CHECK(valid(t));
+        CHECK(!valid(t.substr(0, pos + 2)));
+      }
+    }
+  }
+}
+
+TEST_CASE("validate_utf8") {
+  SECTION("manykernels") {
+    const unsigned char *invalid = manykernels_msgpack;
+    const unsigned char *end = manykernels_msgpack + manykernels_msgpack_len;
+    const unsigned char *expect =
+        fallback::skip_next_message(manykernels_msgpack, end);
+    REQUIRE(expect != nullptr);
+    CHECK(validate_utf8({manykernels_msgpack, end}, &invalid) == expect);
+    CHECK(invalid == nullptr);
+  }
+
+  SECTION("nested invalid string") {
+    // {"ok": ["fine", "b\xffd", "\xff"]}
+    const unsigned char doc[] = {0x81, 0xa2, 'o',  'k', 0x93, 0xa4, 'f',
+                                 'i',  'n',  'e',  0xa3, 'b', 0xff, 'd',
+                                 0xa1, 0xff};
+    const unsigned char *invalid = nullptr;
+    CHECK(validate_utf8({doc, doc + sizeof(doc)}, &invalid) == nullptr);
+    CHECK(invalid - doc == 11);
+  }
+
+  SECTION("invalid key") {
+    const unsigned char doc[] = {0x81, 0xa1, 0xc0, 0x01};
+    const unsigned char *invalid = nullptr;
+    CHECK(validate_utf8({doc, doc + sizeof(doc)}, &invalid) == nullptr);
+    CHECK(invalid - doc == 2);
+  }
+
+  SECTION("truncated") {
+    const unsigned char doc[] = {0x92, 0xa1, 'a'};
+    const unsigned char *invalid = doc;
+    CHECK(validate_utf8({doc, doc + sizeof(doc)}, &invalid) == nullptr);
+    CHECK(invalid == nullptr);
+  }
+}
+
+TEST_CASE("functors_utf8") {
+  struct count : functors_utf8<count> {
+    count(std::vector<std::string> &ok, unsigned &bad) : ok(ok), bad(bad) {}
+    std::vector<std::string> &ok;
+    unsigned &bad;
+    void handle_utf8_string(size_t N, const unsigned char *str) {
+      ok.push_back(std::string(str, str + N));
+    }
+    void handle_invalid_string(size_t, const unsigned char *) { bad++; }
+  };
+  static_assert(!count::has_default_string(), "");
+
+  std::vector<std::string> ok;
+  unsigned bad = 0;
+
+  const unsigned char good[] = {0xa2, 0xc3, 0xa9};
+  handle_msgpack_void<count>({good, good + sizeof(good)}, {ok, bad});
+  const unsigned char poor[] = {0xa2, 0xc3, 0x29};
+  handle_msgpack_void<count>({poor, poor + sizeof(poor)}, {ok, bad});
+
+  REQUIRE(ok.size() == 1);
+  CHECK(ok[0] == "\xc3\xa9");
+  CHECK(bad == 1);
+}
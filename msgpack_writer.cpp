@@ -0,0 +1,96 @@
+#include "msgpack_writer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+// array32 and map32 headers
+const size_t slot_bytes = 5;
+} // namespace
+
+namespace msgpack {
+
+void message_writer::counted() {
+  if (!open.empty()) {
+    open.back().elements++;
+  }
+}
+
+void message_writer::begin(bool is_map) {
+  counted();
+  open.push_back({buffer.size(), 0, is_map});
+  buffer.resize(buffer.size() + slot_bytes);
+}
+
+void message_writer::begin_array() { begin(false); }
+void message_writer::begin_map() { begin(true); }
+
+bool message_writer::end(bool is_map) {
+  if (open.empty() || open.back().is_map != is_map) {
+    return false;
+  }
+  const frame f = open.back();
+  if (is_map && (f.elements % 2) != 0) {
+    return false;
+  }
+  const uint64_t N = is_map ? f.elements / 2 : f.elements;
+  if (N > UINT32_MAX) {
+    return false;
+  }
+
+  unsigned char *slot = buffer.data() + f.slot;
+  unsigned char *header_end = is_map ? detail::write_map_header(N, slot)
+                                     : detail::write_array_header(N, slot);
+  const size_t used = header_end - slot;
+  if (used != slot_bytes) {
+    gaps.push_back({f.slot + used, slot_bytes - used});
+  }
+  open.pop_back();
+  return true;
+}
+
+bool message_writer::end_array() { return end(false); }
+bool message_writer::end_map() { return end(true); }
+
+bool message_writer::write_message(byte_range message) {
+  const unsigned char *end =
+      fallback::skip_next_message(message.start, message.end);
+  if (!end) {
+    return false;
+  }
+  counted();
+  const size_t at = buffer.size();
+  buffer.resize(at + (end - message.start));
+  memcpy(buffer.data() + at, message.start, end - message.start);
+  return true;
+}
+
+bool message_writer::finish(std::vector<unsigned char> &out) {
+  if (!open.empty()) {
+    return false;
+  }
+
+  // Gaps are recorded as containers close, inner before outer, so the outer
+  // slots come later in the list despite being earlier in the buffer
+  std::sort(gaps.begin(), gaps.end(),
+            [](const gap &x, const gap &y) { return x.offset < y.offset; });
+
+  // Every byte after the first gap moves at most once
+  unsigned char *data = buffer.data();
+  size_t to = gaps.empty() ? buffer.size() : gaps[0].offset;
+  for (size_t i = 0; i < gaps.size(); i++) {
+    const size_t from = gaps[i].offset + gaps[i].length;
+    const size_t until =
+        (i + 1 < gaps.size()) ? gaps[i + 1].offset : buffer.size();
+    memmove(data + to, data + from, until - from);
+    to += until - from;
+  }
+  buffer.resize(to);
+
+  out.swap(buffer);
+  buffer.clear();
+  gaps.clear();
+  return true;
+}
+
+} // namespace msgpack
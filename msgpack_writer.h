@@ -0,0 +1,80 @@
+#ifndef MSGPACK_WRITER_H
+#define MSGPACK_WRITER_H
+
+#include "msgpack.h"
+#include "msgpack_traits.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace msgpack {
+
+// Appends messages to a buffer, including arrays and maps whose element
+// count is not known when they are started. begin_array / begin_map reserve
+// an array32 / map32 sized header slot, the matching end writes the smallest
+// header for the final count into it. The unused slot bytes are squeezed out
+// in one pass over the buffer by finish, so the cost does not grow with the
+// number of containers closed.
+//
+// Any number of top level messages may be written, they are concatenated.
+class message_writer {
+public:
+  // Each begin, write or write_message is one element of the innermost open
+  // container, a key or a value if that is a map
+  void begin_array();
+  void begin_map();
+
+  // Return false if the innermost open container is not of that kind, a map
+  // holds a key without a value, or the count exceeds UINT32_MAX. The
+  // container stays open on failure.
+  bool end_array();
+  bool end_map();
+
+  // Returns false, writing nothing, if x can't be encoded
+  template <typename T> bool write(const T &x) {
+    const uint64_t N = encoded_size(x);
+    if (N == too_large_to_encode) {
+      return false;
+    }
+    counted();
+    const size_t at = buffer.size();
+    buffer.resize(at + N);
+    msgpack_traits<T>::write(x, buffer.data() + at);
+    return true;
+  }
+
+  // Copies one already encoded message. Returns false if the range does not
+  // start with a well formed message.
+  bool write_message(byte_range message);
+
+  // Number of containers begun and not yet ended
+  size_t depth() const { return open.size(); }
+
+  // Moves the compacted messages to out and resets the writer. Returns false,
+  // changing nothing, while a container is open.
+  bool finish(std::vector<unsigned char> &out);
+
+private:
+  struct frame {
+    size_t slot;
+    uint64_t elements;
+    bool is_map;
+  };
+  struct gap {
+    size_t offset;
+    size_t length;
+  };
+
+  void counted();
+  void begin(bool is_map);
+  bool end(bool is_map);
+
+  std::vector<unsigned char> buffer;
+  std::vector<frame> open;
+  std::vector<gap> gaps;
+};
+
+} // namespace msgpack
+
+#endif
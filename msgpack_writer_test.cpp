@@ -0,0 +1,107 @@
+#include "catch.hpp"
+#include "msgpack.h"
+#include "msgpack_test_util.h"
+#include "msgpack_traits.h"
+#include "msgpack_writer.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace msgpack;
+
+TEST_CASE("message_writer header sizes") {
+  for (uint64_t n : {0, 1, 15, 16, 65535, 65536}) {
+    message_writer w;
+    w.begin_array();
+    for (uint64_t i = 0; i < n; i++) {
+      w.write(i % 128);
+    }
+    REQUIRE(w.end_array());
+    std::vector<unsigned char> out;
+    REQUIRE(w.finish(out));
+    std::vector<uint64_t> expect;
+    for (uint64_t i = 0; i < n; i++) {
+      expect.push_back(i % 128);
+    }
+    CHECK(out == encode(expect));
+  }
+}
+
+TEST_CASE("message_writer nested matches encode") {
+  typedef std::map<std::string, std::vector<uint64_t>> kernel;
+  std::vector<kernel> kernels;
+  for (uint64_t k = 0; k < 40; k++) {
+    kernel m;
+    m["args"] = std::vector<uint64_t>(k % 20, k);
+    m["name"] = std::vector<uint64_t>(1, 1000 * k);
+    kernels.push_back(m);
+  }
+
+  message_writer w;
+  w.write(std::string("first"));
+  w.begin_array();
+  for (const kernel &m : kernels) {
+    w.begin_map();
+    for (const kernel::value_type &pair : m) {
+      w.write(pair.first);
+      w.begin_array();
+      for (uint64_t x : pair.second) {
+        w.write(x);
+      }
+      CHECK(w.depth() == 3);
+      REQUIRE(w.end_array());
+    }
+    REQUIRE(w.end_map());
+  }
+  REQUIRE(w.end_array());
+  std::vector<unsigned char> tail = encode(true);
+  REQUIRE(w.write_message(range(tail)));
+
+  std::vector<unsigned char> out;
+  REQUIRE(w.finish(out));
+
+  std::vector<unsigned char> expect = encode(std::string("first"));
+  std::vector<unsigned char> body = encode(kernels);
+  expect.insert(expect.end(), body.begin(), body.end());
+  expect.push_back(0xc3);
+  CHECK(out == expect);
+
+  // The writer is reusable after finish
+  w.begin_map();
+  REQUIRE(w.end_map());
+  REQUIRE(w.finish(out));
+  CHECK(out == std::vector<unsigned char>{0x80});
+}
+
+TEST_CASE("message_writer misuse") {
+  message_writer w;
+  std::vector<unsigned char> out = {1, 2, 3};
+  CHECK(!w.end_array());
+
+  w.begin_map();
+  CHECK(!w.end_array());
+  w.write(1);
+  CHECK(!w.end_map());
+  CHECK(!w.finish(out));
+  CHECK(out == std::vector<unsigned char>{1, 2, 3});
+
+  std::vector<unsigned char> truncated = {0x92, 0x01};
+  CHECK(!w.write_message(range(truncated)));
+  w.write(2);
+  CHECK(w.end_map());
+  CHECK(w.depth() == 0);
+  REQUIRE(w.finish(out));
+  CHECK(out == std::vector<unsigned char>{0x81, 0x01, 0x02});
+}
+
+TEST_CASE("message_writer value too large to encode") {
+  message_writer w;
+  w.begin_array();
+  CHECK(!w.write(oversized()));
+  CHECK(w.write(1));
+  CHECK(w.end_array());
+  std::vector<unsigned char> out;
+  REQUIRE(w.finish(out));
+  CHECK(out == std::vector<unsigned char>({0x91, 0x01}));
+}